@@ -33,6 +33,31 @@ struct Material_Instance_ID : public UUID {};
 
 ENV_API bool destroy_everything();
 
+/*
+ * Disk Cache
+ *
+ * Expensive results are reused across runs, they are stored in $XDG_CACHE_HOME/tinydronessim
+ * (or ~/.cache/tinydronessim) by default. An empty path or nullptr disables the cache.
+ */
+
+ENV_API bool set_cache_directory(const char* path);
+
+// How the materials of glTF assets are built, only takes effect before the first environment is created.
+enum glTF_Material_Mode : uint32_t {
+    GLTF_MATERIALS_JIT = 0,        // generated per material configuration, material packages are kept in the disk cache
+    GLTF_MATERIALS_UBERSHADER = 1, // precompiled ubershaders, no generation at all, but slower shaders
+};
+ENV_API bool set_gltf_material_mode(glTF_Material_Mode mode);
+
+// Which OpenGL platform the engine runs on, only takes effect before the first environment is created.
+// Headless uses EGL without any display, e.g. on servers and in containers, windows are unavailable then.
+enum Render_Platform : uint32_t {
+    RENDER_PLATFORM_AUTO = 0,     // headless when neither $DISPLAY nor $WAYLAND_DISPLAY is set
+    RENDER_PLATFORM_WINDOWED = 1, // GLX, needs a display
+    RENDER_PLATFORM_HEADLESS = 2, // EGL headless
+};
+ENV_API bool set_render_platform(Render_Platform platform);
+
 /*
  * Environment Handling
  *
@@ -44,9 +69,14 @@ ENV_API bool environment_exists(Environment_ID env_id);
 ENV_API bool destroy_environment(Environment_ID env_id);
 ENV_API bool environment_activate(Environment_ID env_id);
 
+// With culling stats, every render of a camera in this environment counts the renderables inside and
+// outside of its frustum, see 'get_camera_culling_stats'. Costs one bounding box test per renderable and view.
+ENV_API bool environment_set_culling_stats(Environment_ID env_id, bool enabled);
+
 /*
  * Adding an Image Based Lighting skybox to the scene.
  * Most image formats are supported, though you should use HDR images.
+ * The prefiltered cubemaps are kept in the disk cache, later runs with the same image skip the prefiltering.
  */
 ENV_API bool add_ibl_skybox(const char* file_path);
 
@@ -73,43 +103,256 @@ ENV_API bool add_unlit_material(const char* material_name,
                                 float4 emmisive = {0.00f, 0.00f, 0.00f, 0.00f});
     
 // Importing .gltf or .glb files.
-// gltf animations are not played automatically!
+// gltf animations are not played automatically, see 'play_gltf_animation'.
+// KTX2/Basis textures (KHR_texture_basisu) are transcoded to a compressed format the gpu supports,
+// './nob ktx2' converts the assets to them.
+// Loaded files are cached, loading an unchanged file again only creates a new instance of the cached asset.
 ENV_API glTF_Instance_ID add_gltf_asset_and_create_instance(const char* filepath);
 
+// Same as above, but returns right away and decodes the textures in the background. Until they are
+// bound the instance is drawn with the plain material factors, loading advances with every rendered frame.
+ENV_API glTF_Instance_ID add_gltf_asset_and_create_instance_async(const char* filepath);
+// 1 once all textures are bound (always for synchronous loads), -1 for invalid instances.
+ENV_API float gltf_load_progress(glTF_Instance_ID gltf_instance_id);
+
+// Drop files from the cache, their assets are freed as soon as no instance of them is left.
+// evict_gltf_asset reports an error and returns false, if the file was not cached.
+ENV_API bool evict_gltf_asset(const char* filepath);
+ENV_API bool clear_gltf_asset_cache();
+
 ENV_API Filament_Entity_ID get_gltf_instance_filament_entity(glTF_Instance_ID gltf_instance_id);
 
 // Create another instance using the parent gltf asset from this instance.
 ENV_API glTF_Instance_ID create_gltf_instance_sibling(glTF_Instance_ID gltf_instance_id);
 
+/*
+ * glTF animations, played per instance. They are driven by simulation time: 'advance_gltf_animations' moves
+ * all playing animations and spin channels of an environment forward, rendering never does, so offscreen
+ * renders are deterministic. Animations without loop stop at their end and keep the last pose.
+ */
+ENV_API uint32_t get_gltf_animation_count(glTF_Instance_ID gltf_instance_id);
+ENV_API int32_t get_gltf_animation_index(glTF_Instance_ID gltf_instance_id, const char* name); // -1 if there is none
+ENV_API double get_gltf_animation_duration(glTF_Instance_ID gltf_instance_id, uint32_t animation_index);
+ENV_API bool play_gltf_animation(glTF_Instance_ID gltf_instance_id, uint32_t animation_index, bool loop); // restarts a playing animation
+ENV_API bool stop_gltf_animation(glTF_Instance_ID gltf_instance_id, uint32_t animation_index);
+ENV_API bool set_gltf_animation_speed(glTF_Instance_ID gltf_instance_id, uint32_t animation_index, double speed);
+ENV_API bool set_gltf_animation_time(glTF_Instance_ID gltf_instance_id, uint32_t animation_index, double time_s);
+ENV_API bool advance_gltf_animations(Environment_ID env_id, double dt_s);
+
+// Spin channels turn a named node around an axis (in the node's frame) at a rate, which the simulation
+// sets directly, e.g. the propellers from the motor rpm. Returns the index of the channel in its instance.
+ENV_API int32_t add_gltf_spin_channel(glTF_Instance_ID gltf_instance_id, const char* node_name, float3 axis);
+// Sets the first 'n_channels' rates of every instance in one call, 'rates_rad_per_s' is [n_instances][n_channels].
+ENV_API bool set_gltf_spin_rates(const glTF_Instance_ID* gltf_instance_ids, uint32_t n_instances, const float* rates_rad_per_s, uint32_t n_channels);
+// Sets (or with 0, resets) the current angle of a channel, relative to the rest pose of its node.
+ENV_API bool set_gltf_spin_angle(glTF_Instance_ID gltf_instance_id, uint32_t channel_index, double angle_rad);
+
+// Draws 'n_instances' copies of a glTF asset with gpu instancing, far cheaper than one sibling per copy.
+// The returned entity is the root of the swarm, the instance transforms are relative to it.
+// The meshes of the default scene are baked in, only untextured ones are supported, the materials are built
+// from the glTF color factors. Dropped textures and material features are reported as warnings.
+ENV_API Filament_Entity_ID add_swarm(const char* gltf_path, uint32_t n_instances);
+ENV_API bool set_swarm_transforms(Filament_Entity_ID swarm_id, const double3* positions, const Quaternion* orientations, uint32_t first_instance, uint32_t n);
+
 // Importing .filamesh mesh files.
 ENV_API Filament_Entity_ID add_filamesh_from_file(const char* path);
 
 // Adding basic objects.
+
+enum Primitive_Shape : uint32_t {
+    PRIMITIVE_PLANE = 0,    // size.x by size.z, facing +y
+    PRIMITIVE_BOX = 1,      // edge lengths
+    PRIMITIVE_SPHERE = 2,   // diameters (an ellipsoid, if they differ)
+    PRIMITIVE_CYLINDER = 3, // diameters in x and z, height in y
+    PRIMITIVE_CAPSULE = 4,  // diameter size.x, total length size.y along y
+    PRIMITIVE_ARROW = 5     // head diameter size.x, total length size.y, points along +y
+};
+
+// The unit sized geometry of every shape is created once and shared by all primitives, only the entities
+// are new. The size is applied through the transform, 'tessellation' (0 for the default) is the number of
+// segments around the round shapes. The center is the position of the returned entity.
+ENV_API Filament_Entity_ID add_primitive(Primitive_Shape shape, double3 center, double3 size, const char* material_name,
+                                         Quaternion rotation = identity_quaternion(), uint32_t tessellation = 0);
 ENV_API Filament_Entity_ID add_plane(double3 center, double length_x, double length_z, const char* material_name, Quaternion rotation = identity_quaternion());
 ENV_API Filament_Entity_ID add_line(double3 begin, double3 end, const char* material_name);
 
-// Constructs lines in between neighbouring points.
-// /*TODO*/ ENV_API UUID add_path(UUID env_id, double3* points, uint32_t n_points, const char* material);
+// A line strip through all appended points, rendered as one entity (e.g. for trajectories).
+// With 'ring_buffer' only the last 'capacity' points are kept, otherwise the polyline grows as needed.
+// Only the newly appended points are uploaded to the gpu, once before the next render.
+ENV_API Filament_Entity_ID add_polyline(const char* material_name, uint32_t capacity, bool ring_buffer);
+ENV_API bool polyline_append_points(Filament_Entity_ID polyline_id, const double3* points, uint32_t n_points);
+ENV_API bool polyline_clear(Filament_Entity_ID polyline_id);
+
+// Points drawn with the POINTS primitive as one entity (e.g. lidar returns), 'capacity' grows as needed.
+// Every update replaces all points, 'rgba' (RGBA8 per point) may be null to use 'default_color'.
+// Updates alternate between two vertex buffers, so they never overwrite the points being drawn.
+ENV_API Filament_Entity_ID add_pointcloud(uint32_t capacity, float3 default_color = {1.0f, 1.0f, 1.0f});
+ENV_API bool pointcloud_update(Filament_Entity_ID pointcloud_id, const float3* points, const uint32_t* rgba, uint32_t n_points);
+
+// Immediate-mode debug drawing into the active environment, e.g. for thrust vectors or waypoints.
+// The lines only show up in the next render (window_update, render_frame or render_views) and are
+// cleared afterwards, so they have to be drawn again every frame. Colors are RGB in [0, 1].
+// They are never part of depth or segmentation images.
+ENV_API bool debug_line(double3 a, double3 b, float3 color);
+ENV_API bool debug_arrow(double3 origin, double3 vector, float3 color);
+ENV_API bool debug_axes(double3 position, Quaternion orientation, double length); // x red, y green, z blue
+ENV_API bool debug_sphere_wire(double3 center, double radius, float3 color);
+ENV_API bool debug_box_wire(double3 center, double3 half_extents, Quaternion orientation, float3 color);
+// Debug drawing only shows up in windows, frames rendered for sensor images don't see it unless enabled here.
+// Takes effect for the color image only.
+ENV_API bool set_frame_debug_draw(Frame_ID frame_id, bool visible);
+
 // /*TODO*/ ENV_API UUID add_spere(UUID env_id, double3 center, double radius, const char* material);
 // /*TODO*/ ENV_API UUID add_light(UUID env_id, double3 center, const char* material);
 
 ENV_API bool filament_entity_exists(Filament_Entity_ID filament_entity_id);
 ENV_API bool gltf_instance_exists(glTF_Instance_ID gltf_instance_id);
 
+// Removes the object from its scene and releases its buffers, afterwards the id is invalid.
+// Material instances live in the environment (by name) and stay. The glTF asset is released with its last instance.
+ENV_API bool destroy_filament_entity(Filament_Entity_ID filament_entity_id);
+ENV_API bool destroy_gltf_instance(glTF_Instance_ID gltf_instance_id);
+
 /* 
  * Frame Handling
  *
- * The Frame is what the image gets rendered into. It is mainly a wrapper around Filaments SwapChain.
+ * The Frame is what the image gets rendered into. It is mainly a wrapper around Filaments SwapChain or RenderTarget.
  */
 
 ENV_API Frame_ID create_frame(Environment_ID env_id, uint32_t width, uint32_t height);
+
+// Offscreen frames render into a RenderTarget (color and depth textures) instead of a SwapChain.
+// They work without any window and can be resized cheaply, the textures are only rebuilt when growing.
+// The camera rendering into an offscreen frame takes on the size of the frame.
+ENV_API Frame_ID create_offscreen_frame(Environment_ID env_id, uint32_t width, uint32_t height);
+ENV_API bool resize_offscreen_frame(Frame_ID frame_id, uint32_t width, uint32_t height);
 ENV_API bool frame_exists(Frame_ID frame_id);
 ENV_API bool destroy_frame(Frame_ID frame_id);
 
+/*
+ * Pixel Capture
+ *
+ * The pixels are read back asynchronously into a ring of ENV_PIXEL_READBACK_SLOTS buffers,
+ * so the gpu can render the next frame while you are still reading the previous one.
+ * 'acquire_latest_pixel_frame' hands out the newest completed image, which stays valid
+ * until it is released (or until the next acquire on the same frame).
+ */
+
+#define ENV_PIXEL_READBACK_SLOTS 3
+
 ENV_API bool enable_pixel_capture(Frame_ID frame_id, filament::backend::PixelDataFormat pixel_data_format, filament::backend::PixelDataType pixel_data_type);
-ENV_API bool get_pixel_data(Frame_ID frame_id, void** pixel_data, uint32_t* width, uint32_t* height);
+ENV_API bool acquire_latest_pixel_frame(Frame_ID frame_id, void** pixel_data, uint32_t* width, uint32_t* height, uint64_t* frame_index, double* render_time_ms);
+ENV_API bool release_pixel_frame(Frame_ID frame_id);
+ENV_API bool get_pixel_data(Frame_ID frame_id, void** pixel_data, uint32_t* width, uint32_t* height); // same as 'acquire_latest_pixel_frame'
 ENV_API bool disable_pixel_capture(Frame_ID frame_id);
 
+/*
+ * Pixel Conversion
+ *
+ * Turns every acquired RGBA8 pixel frame into network ready inputs, all requested outputs are
+ * produced in a single pass over the image. The CHW output is normalized per channel with
+ * '(value / 255 - mean) / std'. Requires pixel capture with PixelDataFormat::RGBA and PixelDataType::UBYTE.
+ * The converted data is valid as long as the pixel frame it was converted from.
+ */
+
+#define ENV_MAX_DOWNSAMPLE_FACTOR 8
+
+enum Pixel_Conversion_Output : uint32_t {
+    PIXEL_OUTPUT_RGBA8       = 1 << 0,
+    PIXEL_OUTPUT_GRAY8       = 1 << 1,
+    PIXEL_OUTPUT_CHW_FLOAT32 = 1 << 2
+};
+
+struct Pixel_Conversion_Settings {
+    uint32_t outputs;           // Pixel_Conversion_Output flags
+    uint32_t downsample_factor; // box filter, 1 keeps the resolution
+    uint8_t flip_vertical;      // the gpu delivers the rows bottom up, this puts the first row at the top
+    float mean[3];
+    float std[3];
+};
+
+ENV_API bool enable_pixel_conversion(Frame_ID frame_id, const Pixel_Conversion_Settings* settings);
+ENV_API bool get_converted_pixel_data(Frame_ID frame_id, Pixel_Conversion_Output output, void** data, uint32_t* width, uint32_t* height);
+ENV_API bool disable_pixel_conversion(Frame_ID frame_id);
+
+/*
+ * Shared Memory Export
+ *
+ * Publishes the captured pixel frames in a POSIX shared memory object ('/dev/shm/<name>'), so other processes
+ * can map it and read the images without any copy, the gpu reads back straight into the shared memory.
+ * The object starts with a Shm_Ring_Header, at byte 64 follow 'n_slots' slots of 'slot_stride' bytes each.
+ * Every slot starts with a Shm_Slot_Header, its pixel data begins 'data_offset' bytes into the slot.
+ *
+ * Reading a slot (fields marked atomic must be loaded atomically with acquire semantics):
+ *   1. load 'seqlock', an odd value means the slot is being written, try again later
+ *   2. read the slot header and the pixels
+ *   3. load 'seqlock' again, the read is consistent if it didn't change
+ * 'latest_slot' is the index of the most recently published slot.
+ */
+
+#define ENV_SHM_MAGIC   0x46534454 // "TDSF"
+#define ENV_SHM_VERSION 1
+#define ENV_SHM_NO_SLOT UINT64_MAX
+
+struct Shm_Ring_Header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t n_slots;
+    uint32_t data_offset;
+    uint64_t slot_stride;
+    uint64_t slot_capacity; // max. bytes of pixel data per slot
+    uint64_t latest_slot;   // atomic, ENV_SHM_NO_SLOT until the first image is published
+};
+
+struct alignas(64) Shm_Slot_Header {
+    uint64_t seqlock;           // atomic
+    uint64_t frame_index;
+    uint64_t timestamp_ns;      // CLOCK_MONOTONIC at render time, comparable between processes
+    uint64_t size;              // bytes of pixel data
+    uint32_t width;
+    uint32_t height;
+    uint32_t pixel_data_format; // filament::backend::PixelDataFormat
+    uint32_t pixel_data_type;   // filament::backend::PixelDataType
+};
+
+// Requires pixel capture, the slots are sized for images up to 'max_width' x 'max_height' in the current pixel format.
+ENV_API bool enable_shared_memory_export(Frame_ID frame_id, const char* name, uint32_t max_width, uint32_t max_height);
+ENV_API bool disable_shared_memory_export(Frame_ID frame_id);
+
+/*
+ * Depth Capture (offscreen frames only)
+ *
+ * Reads back the depth buffer through the same asynchronous ring as the pixels and converts it
+ * to metric linear depth (distance along the cameras viewing direction).
+ * Pixels without any geometry are +infinity for DEPTH_FLOAT32_METERS and 0 for DEPTH_UINT16_MILLIMETERS.
+ * Needs the desktop OpenGL backend, GLES can't read back depth buffers and 'enable_depth_capture' fails there.
+ */
+
+enum Depth_Format : uint8_t {
+    DEPTH_FLOAT32_METERS     = 1,
+    DEPTH_UINT16_MILLIMETERS = 2
+};
+
+ENV_API bool enable_depth_capture(Frame_ID frame_id, Depth_Format depth_format);
+ENV_API bool acquire_latest_depth_frame(Frame_ID frame_id, void** depth_data, uint32_t* width, uint32_t* height, uint64_t* frame_index, double* render_time_ms);
+ENV_API bool release_depth_frame(Frame_ID frame_id);
+ENV_API bool disable_depth_capture(Frame_ID frame_id);
+
+/*
+ * Segmentation Mask Capture (offscreen frames only)
+ *
+ * Every object added to an environment gets a mask id. The mask image holds one uint32_t id per pixel
+ * (0 is the background), it is rendered in the same submission as the color image.
+ * 'get_segmentation_object' maps an id back to the Filament_Entity_ID or glTF_Instance_ID it was created as,
+ * the other one is set to ENV_INVALID_UUID.
+ */
+
+ENV_API bool enable_segmentation_capture(Frame_ID frame_id);
+ENV_API bool acquire_latest_segmentation_frame(Frame_ID frame_id, void** mask_data, uint32_t* width, uint32_t* height, uint64_t* frame_index, double* render_time_ms);
+ENV_API bool release_segmentation_frame(Frame_ID frame_id);
+ENV_API bool disable_segmentation_capture(Frame_ID frame_id);
+ENV_API bool get_segmentation_object(Environment_ID env_id, uint32_t mask_id, Filament_Entity_ID* filament_entity_id, glTF_Instance_ID* gltf_instance_id);
+
 /* 
  * Camera Handling
  */
@@ -132,8 +375,15 @@ ENV_API double3 get_camera_up_vector(Camera_ID camera_id);
 ENV_API double3 get_camera_forward_vector(Camera_ID camera_id);
 ENV_API bool render_frame(Camera_ID camera_id, Frame_ID frame_id);
 
+// Render the i-th camera into the i-th frame for all n pairs. All views share one renderer and
+// views targeting the same frame are submitted together, in a single beginFrame/endFrame.
+ENV_API bool render_views(const Camera_ID* camera_ids, const Frame_ID* frame_ids, uint32_t n);
+
 ENV_API Filament_Entity_ID get_camera_filament_entity(Camera_ID camera_id);
 
+// Drawn and culled renderables in the last render of the camera, zero unless the environment has culling stats enabled.
+ENV_API bool get_camera_culling_stats(Camera_ID camera_id, uint32_t* n_drawn, uint32_t* n_culled);
+
 /*
  * Window Handling
  */
@@ -210,3 +460,7 @@ ENV_API double3 get_position(Filament_Entity_ID filament_entity_id);
 ENV_API bool set_position(Filament_Entity_ID filament_entity_id, double3 pos);
 ENV_API bool set_orientation(Filament_Entity_ID filament_entity_id, Quaternion orientation);
 ENV_API bool set_position_and_orientation(Filament_Entity_ID filament_entity_id, double3 pos, Quaternion orientation);
+
+// Sets the position and orientation of 'n' entities at once, much cheaper than one call per entity.
+// Invalid ids are skipped (and make it return false), all others are still updated.
+ENV_API bool set_transforms(const Filament_Entity_ID* filament_entity_ids, const double3* positions, const Quaternion* orientations, uint32_t n);
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "../environments.hpp"
+
+#include <utils/Entity.h>
+#include <math/mat4.h>
+#include <math/vec3.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace filament { namespace gltfio { class FilamentInstance; }}
+
+namespace fmath = filament::math;
+namespace fgltfio = filament::gltfio;
+
+struct Environment;
+
+// One glTF animation of an instance, advanced by 'speed' seconds per second.
+struct Animation_Track {
+    uint32_t animation_index = 0;
+    double time_s = 0.0;
+    double speed = 1.0;
+    bool loop = false;
+    bool finished = false; // reached the end without loop, removed once its last pose is applied
+};
+
+// Turns a node around 'axis' (in the node's own frame) at a rate set by the simulation, on top of its rest transform.
+struct Spin_Channel {
+    utils::Entity node;
+    fmath::mat4f rest_transform;
+    fmath::float3 axis;
+    double angle = 0.0;
+    double rate = 0.0; // rad/s
+};
+
+struct Animated_Instance {
+    fgltfio::FilamentInstance* instance = nullptr;
+    std::vector<Animation_Track> tracks;
+    std::vector<Spin_Channel> spin_channels;
+};
+
+/*
+ * The simulation advances the animations ('advance_gltf_animations'), rendering only applies the poses,
+ * and only if anything changed since the last render. So the poses depend on simulation time alone, not
+ * on how often or how fast the environment is rendered. The animations are applied first, the spin
+ * channels after them, so they win over animations of the same node, and the bone matrices last.
+ */
+void animations_apply(Environment* env);
+void animations_forget_instance(Environment* env, fgltfio::FilamentInstance* instance);
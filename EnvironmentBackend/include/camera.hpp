@@ -4,7 +4,6 @@
 namespace filament {
     class View;
     class Camera;
-    class Renderer;
 }
 
 namespace fmt = filament;
@@ -17,11 +16,16 @@ struct Camera {
     fmt::Camera* fcamera = nullptr;
     Filament_Entity_ID camera_fentity;
     fmt::View* view = nullptr;
-    fmt::Renderer* renderer = nullptr;
+    fmt::View* depth_view = nullptr; // created on demand for depth capture, renders without post-processing
+    fmt::View* mask_view = nullptr;  // created on demand for segmentation capture, only sees ENV_SEGMENTATION_LAYER
     
     Environment* env = nullptr;
     double image_time_ms = 0; // when the image was rendered
 
+    // of the last render, only counted if the environment has culling stats enabled
+    uint32_t n_drawn_renderables = 0;
+    uint32_t n_culled_renderables = 0;
+
     // state which is not saved by filament
     double3 up;
     double vertical_fov;
@@ -29,5 +33,8 @@ struct Camera {
 
 double update_image_time(Camera* camera);
 void set_camera_image_size(Camera* camera, int width, int height);
+fmt::View* get_camera_depth_view(Camera* camera);
+fmt::View* get_camera_mask_view(Camera* camera);
 uint32_t get_camera_image_width(Camera* camera);
 uint32_t get_camera_image_height(Camera* camera);
+void update_culling_stats(Camera* camera);
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "../environments.hpp"
+#include <math.hpp>
+
+#include <utils/Entity.h>
+#include <math/vec3.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace filament {
+    class VertexBuffer;
+    class IndexBuffer;
+    class MaterialInstance;
+}
+
+namespace fmt = filament;
+
+struct Environment;
+
+// The debug geometry lives on its own layer, only frames showing debug drawing (windows by default) see it.
+// The sensor images (offscreen pixels, depth, segmentation) stay free of it.
+#define ENV_DEBUG_DRAW_LAYER 0x40
+
+struct Debug_Vertex {
+    fmath::float3 position;
+    uint32_t color; // RGBA8
+};
+
+/*
+ * Immediate-mode debug geometry of one Environment: the debug_* calls only append line segments
+ * to 'vertices', before the next render all of them are uploaded at once and drawn by a single
+ * renderable, afterwards 'vertices' starts out empty again. The gpu buffers only ever grow.
+ */
+struct Debug_Draw {
+    std::vector<Debug_Vertex> vertices; // two per segment
+
+    // created on the first debug_* call
+    utils::Entity entity;
+    fmt::VertexBuffer* vertex_buffer = nullptr;
+    fmt::IndexBuffer* index_buffer = nullptr;
+    fmt::MaterialInstance* material = nullptr;
+    uint32_t capacity = 0;     // vertices the gpu buffers can hold
+    uint32_t n_uploaded = 0;   // vertices drawn by the renderable
+};
+
+void debug_draw_upload(Environment* env);
+void debug_draw_destroy(Environment* env);
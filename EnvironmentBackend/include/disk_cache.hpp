@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+ * Results, which are expensive to compute and can be reused by later runs (prefiltered IBLs, ...).
+ * Every entry is a file <cache directory>/<kind>/<key as hex><extension>, keyed by a hash of
+ * everything it was computed from. An empty cache directory disables the cache.
+ */
+
+uint64_t hash_bytes(const void* data, size_t size, uint64_t seed = 0);
+
+// Returns an empty string if the cache is disabled, creates the directory of 'kind' on the way.
+std::string disk_cache_path(const char* kind, uint64_t key, const char* extension);
+
+// Writes to a temporary file first and renames it, concurrent runs never see half written entries.
+bool disk_cache_write(const std::string& path, const void* data, size_t size);
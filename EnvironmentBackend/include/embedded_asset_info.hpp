@@ -5,3 +5,6 @@ extern const unsigned int __assets_sandboxLit_filamat_len;
 
 extern const unsigned char __assets_sandboxUnlit_filamat[];
 extern const unsigned int __assets_sandboxUnlit_filamat_len;
+
+extern const unsigned char __assets_vertexColorUnlit_filamat[];
+extern const unsigned int __assets_vertexColorUnlit_filamat_len;
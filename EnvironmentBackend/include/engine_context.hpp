@@ -0,0 +1,64 @@
+#pragma once
+
+#include <tsl/robin_map.h>
+
+#include <cstdint>
+
+namespace filament {
+    class Engine;
+    class Material;
+    class Renderer;
+    class SwapChain;
+
+    namespace backend {
+        class Platform;
+    }
+
+    namespace gltfio {
+        class AssetLoader;
+        class MaterialProvider;
+        class TextureProvider;
+    }
+}
+
+namespace utils {
+    class NameComponentManager;
+}
+
+namespace fmt = filament;
+namespace fgltfio = filament::gltfio;
+
+struct Primitive_Geometry;
+
+/*
+ * The Engine_Context owns everything, which is expensive to create and can be shared between
+ * Environments: the filament Engine and its Renderer, the compiled base materials and the gltf loaders.
+ * There is only one per process, it is created together with the first Environment.
+ * Environments themselves are lightweight, they only own their Scene and what has been added to it.
+ */
+struct Engine_Context {
+    ~Engine_Context();
+
+    fmt::Engine* engine = nullptr;
+    fmt::backend::Platform* platform = nullptr; // only set for the EGL headless platform, otherwise the engine owns it
+    bool headless = false; // no display connection, windows can't be created
+    fmt::Renderer* renderer = nullptr; // shared by all cameras, every view is rendered through it
+    fmt::SwapChain* headless_swap_chain = nullptr; // drives beginFrame() for the offscreen frames
+
+    fmt::Material* base_lit_material = nullptr;
+    fmt::Material* base_unlit_material = nullptr;
+    fmt::Material* vertex_color_material = nullptr; // unlit, colored by the vertex colors (debug draw, point clouds)
+    struct {
+        fgltfio::MaterialProvider* material_provider = nullptr;
+        fgltfio::TextureProvider* texture_provider = nullptr;      // png, jpeg
+        fgltfio::TextureProvider* ktx2_texture_provider = nullptr; // KHR_texture_basisu, transcoded to what the gpu supports
+        fgltfio::AssetLoader* asset_loader = nullptr;
+        utils::NameComponentManager* names = nullptr; // node names, for looking up nodes of instances
+    } gltf;
+
+    // unit sized meshes shared by all primitives, keyed by their kind and tessellation
+    tsl::robin_map<uint32_t, Primitive_Geometry*> primitive_geometries;
+};
+
+// Creates the context on the first call, returns nullptr if that failed.
+Engine_Context* get_engine_context();
@@ -1,17 +1,28 @@
 #include <filameshio/MeshReader.h>
+#include <segmentation.hpp>
+#include <mesh.hpp>
+#include <polyline.hpp>
+#include <swarm.hpp>
+#include <point_cloud.hpp>
+#include <primitives.hpp>
+#include <debug_draw.hpp>
+#include <animation.hpp>
 
+#include <tsl/robin_map.h>
+
+#include <cstdint>
+#include <string>
 #include <vector>
 
 namespace filament {
     class Scene;
     class Engine;
-    class Material;
-    
+
     namespace gltfio {
-        class AssetLoader;
-        class MaterialProvider;
-        class TextureProvider;
         class FilamentAsset;
+        class FilamentInstance;
+        class ResourceLoader;
+        class TextureProvider;
     }
 }
 
@@ -19,21 +30,56 @@ namespace fmt = filament;
 namespace fmesh = filamesh;
 namespace fgltfio = filament::gltfio;
 
+struct Engine_Context;
+
+// A glTF asset, whose textures are still decoded in the background, advanced once per rendered frame.
+// Every load gets its own texture provider, a shared one would hand decoded textures to the wrong loader.
+struct glTF_Async_Load {
+    fgltfio::FilamentAsset* asset = nullptr;
+    fgltfio::ResourceLoader* resource_loader = nullptr;
+    fgltfio::TextureProvider* texture_provider = nullptr;
+    fgltfio::TextureProvider* ktx2_texture_provider = nullptr;
+};
+
+// A loaded glTF file, it is only reused while the file on disk is unchanged.
+struct glTF_Cache_Entry {
+    fgltfio::FilamentAsset* asset = nullptr;
+    int64_t mtime_ns = 0;
+    uint64_t size = 0;
+};
+
+// Only holds the per-scene state, the engine and the shared resources live in the Engine_Context.
 struct Environment {
     ~Environment();
-    
+
     fmt::Scene* scene = nullptr;
-    fmt::Engine* engine = nullptr;
+    Engine_Context* ctx = nullptr;
+    fmt::Engine* engine = nullptr; // shortcut for ctx->engine
 
-    fmesh::MeshReader::MaterialRegistry material_registry; // keeps track of materials
-    fmt::Material* base_lit_material = nullptr;
-    fmt::Material* base_unlit_material = nullptr;
+    fmesh::MeshReader::MaterialRegistry material_registry; // keeps track of the material instances of this environment
     struct {
-        fgltfio::MaterialProvider* material_provider = nullptr;
-        fgltfio::TextureProvider* texture_provider = nullptr;
-        fgltfio::AssetLoader* asset_loader = nullptr;
         std::vector<fgltfio::FilamentAsset*> assets;
+        // gltfio only destroys whole assets, so an asset lives until its last reference is gone,
+        // the references are its live instances plus one while the asset is in the cache
+        tsl::robin_map<fgltfio::FilamentAsset*, uint32_t> n_references;
+        tsl::robin_map<std::string, glTF_Cache_Entry> cache; // keyed by the canonical path of the file
+        std::vector<glTF_Async_Load> async_loads;
     } gltf;
+    Segmentation_Registry segmentation;
+    tsl::robin_map<uint32_t, Mesh*> meshes;              // keyed by the id of their utils::Entity
+    tsl::robin_map<uint32_t, Polyline*> polylines;       // keyed by the id of their utils::Entity
+    tsl::robin_map<uint32_t, Swarm*> swarms;             // keyed by the id of their root entity
+    tsl::robin_map<uint32_t, Point_Cloud*> point_clouds; // keyed by the id of their utils::Entity
+    tsl::robin_map<uint32_t, Primitive*> primitives;     // keyed by the id of their root entity
+    tsl::robin_map<fgltfio::FilamentInstance*, Animated_Instance*> animated_instances;
+    bool animations_dirty = false; // the poses changed since they were last applied
+    Debug_Draw debug_draw;
+    bool culling_stats_enabled = false;
 };
 
+void gltf_update_async_loads(Environment* env);
+
+bool environment_destroy_entity(Environment* env, utils::Entity entity, Filament_Entity_ID filament_entity_id);
+void environment_destroy_gltf_instance(Environment* env, fgltfio::FilamentInstance* instance, glTF_Instance_ID gltf_instance_id);
+
 // void __destroy_all_gltf_instances_and_asset(fgltfio::FilamentInstance* instace, Environment* env);
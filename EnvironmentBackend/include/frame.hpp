@@ -1,33 +1,98 @@
+#include "../environments.hpp"
 #include <math.hpp>
+#include <pixel_conversion.hpp>
+#include <shm_export.hpp>
 
 #include <backend/DriverEnums.h>
 
+#include <atomic>
+#include <cstdint>
+
 struct Environment;
 
 namespace filament {
     class SwapChain;
+    class RenderTarget;
+    class Texture;
 }
 
 namespace fmt = filament;
 
 struct Camera;
 
+/*
+ * One readback destination of a Frame. 'completed' is set from the PixelBufferDescriptor callback,
+ * once the gpu has written the pixels, every other field is only touched by the thread driving the engine.
+ */
+struct Pixel_Readback_Slot {
+    void* pixel_data = nullptr;
+    size_t pixel_data_size = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint64_t frame_index = 0;
+    double render_time_ms = 0;
+
+    std::atomic<bool> completed{false};
+    bool in_flight = false; // readPixels was issued, but the callback didn't fire yet
+    bool acquired = false;  // handed out to the user, must not be written into
+
+    // Depth and segmentation readbacks are converted lazily, when they are acquired.
+    // These are the depth related entries of the projection matrix, that was used for rendering.
+    double projection_22 = 0;
+    double projection_32 = 0;
+    double far_plane = 0;
+    bool converted = false;
+
+    // set if 'pixel_data' points into the shared memory export instead of being owned by the slot
+    Shm_Export* shared_export = nullptr;
+    uint32_t shared_slot_idx = 0;
+};
+
+struct Readback_Ring {
+    Pixel_Readback_Slot slots[ENV_PIXEL_READBACK_SLOTS];
+    int acquired_slot_idx = -1;
+    Shm_Export* shared_export = nullptr; // the gpu reads back straight into these slots, if they fit
+};
+
 struct Frame {
     ~Frame();
-    
+
     fmt::SwapChain* swap_chain = nullptr;
     Environment* env;
 
+    // Offscreen frames render into textures instead of a SwapChain, they don't need a window.
+    // The textures are only rebuilt, when the frame grows beyond 'texture_width' x 'texture_height',
+    // a smaller frame just uses the lower left part of them.
+    fmt::RenderTarget* render_target = nullptr;
+    fmt::Texture* color_texture = nullptr;
+    fmt::Texture* depth_texture = nullptr;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t texture_width = 0;
+    uint32_t texture_height = 0;
+
+    bool is_offscreen() { return render_target != nullptr; }
+
     // flag for copying the frame to the cpu memory (this is very slow)
     bool capture_pixels = false;
     filament::backend::PixelDataFormat pixel_data_format;
     filament::backend::PixelDataType pixel_data_type;
-    // width, height and pixel_data_size will be set for you, when a frame is saved in cpu memory
-    uint32_t width = 0;
-    uint32_t height = 0;
-    size_t pixel_data_size = 0;
-    void* pixel_data = nullptr;
+
+    // only available for offscreen frames
+    bool capture_depth = false;
+    Depth_Format depth_format = DEPTH_FLOAT32_METERS;
+    bool capture_segmentation = false;
+
+    bool show_debug_draw = false; // windows turn it on, the sensor images stay clean
+
+    // The readbacks are asynchronous, while the gpu writes into one slot the user can read another one.
+    Readback_Ring pixel_readback;
+    Readback_Ring depth_readback;
+    Readback_Ring segmentation_readback;
+    Pixel_Conversion conversion; // runs on the acquired pixel frames
+    uint64_t frame_counter = 0; // counts the rendered frames
 };
 
 Frame* create_frame(Environment* env, fmt::SwapChain* swap_chain);
 bool render_frame(Camera* camera, Frame* frame);
+bool render_views(Camera* const* cameras, Frame* const* frames, uint32_t n);
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <math/vec3.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace filament {
+    class Texture;
+}
+
+namespace fmt = filament;
+namespace fmath = filament::math;
+
+struct Engine_Context;
+
+// The image based lighting of an environment map, ready for the IndirectLight and the Skybox.
+struct IBL {
+    fmt::Texture* skybox = nullptr;      // cubemap
+    fmt::Texture* reflections = nullptr; // cubemap, its levels are prefiltered for increasing roughness
+    fmath::float3 irradiance_sh[9] = {}; // 3 bands, pre-scaled the way filament evaluates them
+    bool has_irradiance = false;
+};
+
+// Parameters of the specular prefilter (IBLPrefilterContext::SpecularFilter), they are part of the cache key.
+struct IBL_Prefilter_Settings {
+    uint32_t sample_count = 1024;
+    uint32_t reflections_levels = 5;
+    float hdr_linear = 1024.0f;
+    float hdr_max = 16384.0f;
+    float lod_offset = 1.0f;
+};
+
+/*
+ * Prefiltering an environment map is the slowest part of setting up a scene, so the results are kept in
+ * the disk cache, keyed by the hash of the source image, the prefilter settings and the cache format.
+ * A cache hit uploads the cubemaps straight out of the mapped cache file, without decoding the image or
+ * touching the prefilter.
+ */
+uint64_t ibl_cache_key(const void* source, size_t source_size, const IBL_Prefilter_Settings& settings);
+
+bool ibl_cache_load(Engine_Context* ctx, uint64_t key, IBL* ibl);
+
+// Reads the freshly prefiltered cubemaps back, computes the irradiance from them and stores the cache entry.
+bool ibl_read_back_and_store(Engine_Context* ctx, uint64_t key, IBL* ibl);
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <math/vec3.h>
+#include <math/vec4.h>
+
+#include <cstdint>
+
+namespace fmath = filament::math;
+
+/*
+ * Cubemap pixels are laid out like Texture::setImage() expects them: the faces in the order
+ * +X, -X, +Y, -Y, +Z, -Z, each 'size' rows of 'size' pixels, the first row at t = -1.
+ */
+
+// Direction of the texel center (s, t in [-1, 1]) on a cubemap face, in the OpenGL convention filament samples with.
+fmath::double3 cubemap_direction(uint32_t face, double s, double t);
+
+/*
+ * Projects the radiance onto the first three spherical harmonics bands and convolves it with the clamped
+ * cosine, which gives the irradiance. Like cmgen, the coefficients are pre-multiplied with the basis
+ * normalization and 1/pi, filament evaluates them as a plain polynomial of the normal.
+ */
+void compute_irradiance_sh(const fmath::float4* pixels, uint32_t size, fmath::float3 sh[9]);
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * A file mapped read-only into memory, the loaders read the assets straight out of the page cache
+ * instead of a heap copy. Unmap it as soon as the loader is done with the bytes, the pages are
+ * only backed by the file, so keeping a mapping around is cheap but still pins the address space.
+ */
+struct Mapped_File {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+};
+
+bool map_file(const char* path, Mapped_File* file);
+void unmap_file(Mapped_File* file);
+
+// For buffer descriptors, which keep pointing into the mapping until the gpu upload is done:
+// 'user' is a Mapped_File allocated with new.
+void unmap_file_callback(void* buffer, size_t size, void* user);
@@ -0,0 +1,20 @@
+#pragma once
+
+namespace filament {
+    class Engine;
+
+    namespace gltfio {
+        class MaterialProvider;
+    }
+}
+
+namespace fmt = filament;
+namespace fgltfio = filament::gltfio;
+
+/*
+ * A glTF material provider, which generates a material package per material configuration (MaterialKey and
+ * UvMap) like the jit shader provider does, but keeps the packages in the disk cache. Later runs load them
+ * with Material::Builder().package() and skip the shader generation. The rarer extensions (clear coat, sheen,
+ * transmission, volume, ...) are passed on to gltfio's jit shader provider.
+ */
+fgltfio::MaterialProvider* create_cached_material_provider(fmt::Engine* engine);
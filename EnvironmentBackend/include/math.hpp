@@ -2,7 +2,11 @@
 
 #include <math/vec3.h>
 #include <math/mat3.h>
+#include <math/mat4.h>
 #include <math/quat.h>
+#include <math/norm.h>
+
+#include <cmath>
 
 #define PI 3.141592653589793
 
@@ -64,3 +68,27 @@ constexpr Quaternion quaternion_cw_90_z() { return normed_axis_angle_to_quaterni
 Quaternion operator*(Quaternion q, Quaternion r);
 inline Quaternion quaternion_conjugate(Quaternion q) { return Quaternion{-q.x, -q.y, -q.z, q.w}; }
 double3 quaternion_rotate_vector(double3 v, Quaternion r);
+
+// Rigid transform from a position and a unit quaternion, the rotation part equals filaments mat3(quat).
+inline fmath::mat4 pose_to_mat4(double3 pos, Quaternion q)
+{
+    double xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+    double xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+    double wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+
+    fmath::mat4 mat;
+    mat[0] = {1.0 - 2.0 * (yy + zz), 2.0 * (xy + wz), 2.0 * (xz - wy), 0.0};
+    mat[1] = {2.0 * (xy - wz), 1.0 - 2.0 * (xx + zz), 2.0 * (yz + wx), 0.0};
+    mat[2] = {2.0 * (xz + wy), 2.0 * (yz - wx), 1.0 - 2.0 * (xx + yy), 0.0};
+    mat[3] = {pos.x, pos.y, pos.z, 1.0};
+    return mat;
+}
+
+// Packed tangent frame for the TANGENTS attribute, any tangent works for our materials, they have no normal maps.
+inline fmath::short4 tangent_frame_from_normal(fmath::float3 n)
+{
+    fmath::float3 axis = std::abs(n.x) < 0.9f ? fmath::float3{1, 0, 0} : fmath::float3{0, 1, 0};
+    fmath::float3 t = normalize(cross(axis, n));
+    fmath::float3 b = cross(n, t);
+    return fmath::packSnorm16(fmath::mat3f::packTangentFrame(fmath::mat3f{t, b, n}).xyzw);
+}
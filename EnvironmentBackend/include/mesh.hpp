@@ -7,11 +7,15 @@ namespace futils = utils;
 
 struct Environment;
 
+// A renderable, which owns its buffers (filamesh files, lines). Deleting it removes it from the scene
+// and releases the entity together with the buffers.
 struct Mesh {
     Mesh(futils::Entity renderable, filament::VertexBuffer* vertex_buffer, filament::IndexBuffer* index_buffer, Environment* env)
         : m_renderable(renderable), m_vertex_buffer(vertex_buffer), m_index_buffer(index_buffer), env(env) {}
     Mesh(filamesh::MeshReader::Mesh fmesh, Environment* env)
         : m_renderable(fmesh.renderable), m_vertex_buffer(fmesh.vertexBuffer), m_index_buffer(fmesh.indexBuffer), env(env) {}
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
     ~Mesh();
     
     futils::Entity m_renderable;
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "../environments.hpp"
+
+#include <cstdint>
+#include <vector>
+
+/*
+ * Converts a captured RGBA8 image into all requested outputs (see Pixel_Conversion_Settings) in one pass.
+ * Every output row is produced from one (optionally box-downsampled) source row by a vectorized
+ * kernel, AVX2 or SSE2 on x86-64 (picked at runtime) and NEON on arm64, with a scalar fallback.
+ */
+struct Pixel_Conversion {
+    Pixel_Conversion_Settings settings = {};
+    bool enabled = false;
+
+    // outputs of the last converted image
+    bool valid = false;
+    uint64_t frame_index = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint8_t> rgba8;
+    std::vector<uint8_t> gray8;
+    std::vector<float> chw_float32; // planes in the order R, G, B
+    std::vector<uint8_t> downsampled_row; // scratch buffer
+};
+
+bool pixel_conversion_settings_valid(const Pixel_Conversion_Settings& settings);
+void convert_pixels(Pixel_Conversion* conversion, const uint8_t* rgba8, uint32_t width, uint32_t height);
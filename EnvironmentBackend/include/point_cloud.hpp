@@ -0,0 +1,42 @@
+#pragma once
+
+#include "../environments.hpp"
+#include <math.hpp>
+
+#include <utils/Entity.h>
+
+#include <cstdint>
+
+namespace filament {
+    class VertexBuffer;
+    class IndexBuffer;
+    class MaterialInstance;
+}
+
+namespace fmt = filament;
+
+struct Environment;
+
+// One of the two vertex buffers of a point cloud, buffer 0 holds the positions and buffer 1 the colors.
+struct Point_Cloud_Buffer {
+    fmt::VertexBuffer* vertex_buffer = nullptr;
+    uint32_t n_default_colors = 0; // the colors of the first n points are 'default_color'
+};
+
+/*
+ * A set of points drawn with the POINTS primitive as one entity. Every update replaces all points and
+ * goes into the buffer the renderable is not drawing from, afterwards the two buffers swap roles, so
+ * a new upload never has to wait for a draw that still uses the previous points.
+ */
+struct Point_Cloud {
+    utils::Entity entity;
+    Point_Cloud_Buffer buffers[2];
+    uint32_t front = 0; // the buffer the renderable draws from
+    fmt::IndexBuffer* index_buffer = nullptr; // 0, 1, 2, ... shared by both buffers
+    fmt::MaterialInstance* material = nullptr;
+    uint32_t capacity = 0;
+    uint32_t n_points = 0;
+    uint32_t default_color = 0xFFFFFFFF; // RGBA8, for updates without colors
+};
+
+void point_cloud_destroy(Environment* env, Point_Cloud* point_cloud);
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "../environments.hpp"
+#include <math.hpp>
+#include <polyline_ring.hpp>
+
+#include <utils/Entity.h>
+#include <math/vec3.h>
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace filament {
+    class VertexBuffer;
+    class IndexBuffer;
+}
+
+namespace fmt = filament;
+
+struct Environment;
+
+/*
+ * A line strip rendered as one entity. The points live in a ring of 'capacity' vertices (see polyline_ring.hpp),
+ * in ring buffer mode the oldest points get overwritten, otherwise the buffers double in size when full.
+ * Appending only marks the new points dirty, 'polylines_upload' sends the dirty range to the gpu
+ * once before rendering.
+ */
+struct Polyline {
+    utils::Entity entity;
+    fmt::VertexBuffer* vertex_buffer = nullptr;
+    fmt::IndexBuffer* index_buffer = nullptr;
+
+    std::vector<fmath::float3> points; // cpu copy of the vertex buffer
+    Polyline_Ring ring;
+    bool ring_buffer = false;
+    bool range_changed = false;
+
+    // Grows with every appended point, recomputed from the live points once old ones were overwritten.
+    fmath::float3 aabb_min = {INFINITY, INFINITY, INFINITY};
+    fmath::float3 aabb_max = {-INFINITY, -INFINITY, -INFINITY};
+    bool aabb_stale = false;
+};
+
+void polylines_upload(Environment* env);
+void polyline_destroy(Environment* env, Polyline* polyline);
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+ * The slot bookkeeping of a polyline, without any gpu buffers. The points live in a ring of 'capacity'
+ * slots, the oldest at 'head'. The dirty slots are contiguous in ring order, starting at 'dirty_first'.
+ *
+ * The index buffer holds the segments (k, k + 1 mod capacity) for k in [0, 2 * capacity), so the
+ * segments from the oldest to the newest point are always one contiguous index range.
+ */
+
+// The index count (4 per slot) and the byte offsets into the vertex buffer (12 per slot) have to fit into uint32_t.
+#define ENV_POLYLINE_MAX_CAPACITY (UINT32_MAX / 12)
+
+struct Polyline_Ring {
+    uint32_t capacity = 0;
+    uint32_t head = 0; // slot of the oldest point
+    uint32_t n_points = 0;
+    uint32_t dirty_first = 0;
+    uint32_t n_dirty = 0;
+};
+
+// Where the gpu copy has to be updated, the dirty range wraps around the end of the ring in at most two runs.
+struct Polyline_Dirty_Runs {
+    uint32_t first[2];
+    uint32_t count[2];
+    uint32_t n_runs;
+};
+
+inline uint32_t polyline_index_count(uint32_t capacity) { return 4 * capacity; }
+void polyline_fill_indices(uint32_t* indices, uint32_t capacity);
+
+// Slot of the i-th oldest point.
+inline uint32_t polyline_ring_slot(const Polyline_Ring& ring, uint32_t i) { return (ring.head + i) % ring.capacity; }
+
+// Claims the slots of 'n' (at most 'capacity') new points, the oldest ones are overwritten when the ring is full.
+// Returns the slot of the first new point, the others follow in ring order.
+uint32_t polyline_ring_push(Polyline_Ring* ring, uint32_t n, uint32_t* n_overwritten);
+
+// Only for rings which never overwrote (head 0), all points become dirty.
+void polyline_ring_grow(Polyline_Ring* ring, uint32_t new_capacity);
+
+void polyline_ring_clear(Polyline_Ring* ring);
+
+Polyline_Dirty_Runs polyline_ring_dirty_runs(const Polyline_Ring& ring);
+
+// The index range drawing the segments from the oldest to the newest point.
+void polyline_ring_index_range(const Polyline_Ring& ring, uint32_t* first_index, uint32_t* n_indices);
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <math/vec3.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace fmath = filament::math;
+
+// The unit sized meshes the primitives are assembled from, all centered at the origin with y up.
+enum Primitive_Geometry_Kind : uint8_t {
+    PRIMITIVE_GEOMETRY_PLANE,      // 1 x 1 quad in the xz plane, facing +y
+    PRIMITIVE_GEOMETRY_BOX,        // 1 x 1 x 1 cube
+    PRIMITIVE_GEOMETRY_SPHERE,     // diameter 1
+    PRIMITIVE_GEOMETRY_HEMISPHERE, // upper half of the sphere, open at y = 0
+    PRIMITIVE_GEOMETRY_CYLINDER,   // diameter 1, height 1, closed
+    PRIMITIVE_GEOMETRY_CONE,       // base diameter 1 at y = -0.5, tip at y = 0.5, closed
+};
+
+struct Mesh_Data {
+    std::vector<fmath::float3> positions;
+    std::vector<fmath::float3> normals;
+    std::vector<uint32_t> indices; // triangles, counter-clockwise when looking against the normals
+};
+
+// 'segments' is the number of segments around the y axis of the round kinds.
+Mesh_Data build_primitive_mesh(Primitive_Geometry_Kind kind, uint32_t segments);
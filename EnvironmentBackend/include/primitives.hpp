@@ -0,0 +1,47 @@
+#pragma once
+
+#include "../environments.hpp"
+#include <math.hpp>
+#include <primitive_mesh.hpp>
+
+#include <utils/Entity.h>
+#include <math/vec3.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace filament {
+    class VertexBuffer;
+    class IndexBuffer;
+}
+
+namespace fmt = filament;
+
+struct Environment;
+struct Engine_Context;
+
+// Default number of segments around the y axis of the round primitives.
+#define ENV_PRIMITIVE_DEFAULT_TESSELLATION 32
+#define ENV_PRIMITIVE_MAX_TESSELLATION 256
+
+// Created once per engine and shared by all renderables of this kind and tessellation.
+struct Primitive_Geometry {
+    fmt::VertexBuffer* vertex_buffer = nullptr;
+    fmt::IndexBuffer* index_buffer = nullptr;
+    uint32_t n_indices = 0;
+    fmath::float3 aabb_min;
+    fmath::float3 aabb_max;
+};
+
+/*
+ * A primitive added to an Environment: 'root' carries the pose (it is the Filament-Entity handed out),
+ * its children are the renderables, each one a cached unit geometry scaled and offset by its own
+ * local transform. Capsules and arrows are made of several parts, so their caps are never distorted.
+ */
+struct Primitive {
+    utils::Entity root;
+    std::vector<utils::Entity> parts;
+};
+
+void primitive_destroy(Environment* env, Primitive* primitive);
+void primitive_geometries_destroy(Engine_Context* ctx);
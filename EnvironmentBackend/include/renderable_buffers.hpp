@@ -0,0 +1,38 @@
+#pragma once
+
+#include "../environments.hpp"
+
+#include <backend/DriverEnums.h>
+#include <utils/Entity.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace filament {
+    class Engine;
+    class VertexBuffer;
+    class IndexBuffer;
+}
+
+namespace fmt = filament;
+
+/*
+ * Shared by the renderables which own their gpu buffers: debug draw, point clouds, polylines, swarms and primitives.
+ * Buffer data handed to filament is malloc'ed, filament frees it with 'free_buffer_callback' once uploaded.
+ */
+
+void free_buffer_callback(void* buffer, size_t size, void* user);
+
+// RGBA8 with opaque alpha, for UBYTE4 normalized color attributes.
+uint32_t pack_color(float3 color);
+
+// Doubles 'capacity' until it holds 'min_capacity', without overflowing.
+uint32_t grow_capacity(uint32_t capacity, uint32_t min_capacity);
+
+// Fills the index buffer with 0, 1, ..., n - 1.
+void set_sequential_indices(fmt::Engine* engine, fmt::IndexBuffer* index_buffer, uint32_t n);
+
+// Points the renderable at newly grown buffers. The renderable must never reference destroyed buffers,
+// so this has to happen before the old ones are destroyed.
+void set_renderable_geometry(fmt::Engine* engine, utils::Entity entity, fmt::backend::PrimitiveType type,
+                             fmt::VertexBuffer* vertex_buffer, fmt::IndexBuffer* index_buffer);
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "../environments.hpp"
+#include <segmentation_id.hpp>
+
+#include <utils/Entity.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace filament {
+    class MaterialInstance;
+    class Skybox;
+}
+
+namespace fmt = filament;
+
+struct Environment;
+
+// Renderables with a segmentation label are additionally put on this layer, the mask views only see this layer.
+#define ENV_SEGMENTATION_LAYER 0x80
+
+/*
+ * Every object added to an Environment gets a compact mask id, in the mask image each pixel holds the id
+ * of the object it shows (0 is the background). The mask is rendered by temporarily swapping the material
+ * instances of all labeled renderables with flat unlit ones, which encode the id in their color.
+ */
+struct Segmentation_Label {
+    Filament_Entity_ID filament_entity_id = {ENV_INVALID_UUID};
+    glTF_Instance_ID gltf_instance_id = {ENV_INVALID_UUID};
+    std::vector<utils::Entity> renderables;
+    fmt::MaterialInstance* mask_material = nullptr;
+};
+
+struct Segmentation_Registry {
+    std::vector<Segmentation_Label> labels; // mask id = index + 1
+    std::vector<uint32_t> free_labels;      // of destroyed objects, reused together with their mask material
+
+    // The background is drawn by a black skybox, so it ends up as mask id 0.
+    fmt::Skybox* mask_skybox = nullptr;
+
+    // state saved during the mask pass
+    std::vector<fmt::MaterialInstance*> swapped_materials;
+    fmt::Skybox* swapped_skybox = nullptr;
+};
+
+uint32_t segmentation_register(Environment* env, const utils::Entity* entities, size_t n_entities,
+                               Filament_Entity_ID filament_entity_id, glTF_Instance_ID gltf_instance_id);
+void segmentation_unregister(Environment* env, Filament_Entity_ID filament_entity_id, glTF_Instance_ID gltf_instance_id);
+void segmentation_begin_mask_pass(Environment* env);
+void segmentation_end_mask_pass(Environment* env);
+void segmentation_destroy(Environment* env);
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * How a segmentation mask id travels through the RGBA8 mask image: the id is split over the red,
+ * green and blue channel (24 bits), id 0 is the background. Kept free of filament so it can be tested.
+ */
+
+#define ENV_SEGMENTATION_MAX_ID 0xFFFFFF
+
+// The linear color the mask material of an id is drawn with, k / 255 ends up as exactly k in the image.
+inline void segmentation_id_color(uint32_t mask_id, float color[3])
+{
+    color[0] = float((mask_id >>  0) & 0xFF) / 255.0f;
+    color[1] = float((mask_id >>  8) & 0xFF) / 255.0f;
+    color[2] = float((mask_id >> 16) & 0xFF) / 255.0f;
+}
+
+inline uint32_t segmentation_decode_pixel(const uint8_t* rgba)
+{
+    return uint32_t(rgba[0]) | (uint32_t(rgba[1]) << 8) | (uint32_t(rgba[2]) << 16);
+}
+
+// Converts the RGBA8 mask, as read back from the gpu, into one uint32_t mask id per pixel (in place).
+inline void segmentation_decode_mask(void* pixel_data, uint32_t width, uint32_t height)
+{
+    uint8_t* rgba = (uint8_t*)pixel_data;
+    uint32_t* mask_ids = (uint32_t*)pixel_data;
+    size_t n_pixels = size_t(width) * size_t(height);
+
+    // same pixel size, so every pixel can be overwritten right after it was read
+    for (size_t i = 0; i < n_pixels; ++i) {
+        mask_ids[i] = segmentation_decode_pixel(rgba + 4 * i);
+    }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "../environments.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+ * A mapped shared memory ring (see 'Shared Memory Export' in environments.hpp). The slots are
+ * written through their seqlock: 'shm_export_begin_write' makes it odd before the gpu writes
+ * the pixels, 'shm_export_end_write' makes it even again once the readback completed.
+ */
+struct Shm_Export {
+    std::string name;
+    int fd = -1;
+    void* mapping = nullptr;
+    size_t mapping_size = 0;
+    Shm_Ring_Header* header = nullptr;
+};
+
+Shm_Export* shm_export_create(const char* name, uint32_t n_slots, size_t slot_capacity);
+void shm_export_destroy(Shm_Export* shm);
+
+// Returns where the pixels of the slot have to be written to, nullptr if they don't fit into the slot.
+void* shm_export_begin_write(Shm_Export* shm, uint32_t slot_idx, uint64_t frame_index, uint32_t width, uint32_t height,
+                             uint32_t pixel_data_format, uint32_t pixel_data_type, size_t size);
+// Safe to call from any thread.
+void shm_export_end_write(Shm_Export* shm, uint32_t slot_idx);
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ * Handles
+ *
+ * Every id encodes where its object lives: | type tag (8 bit) | generation (24 bit) | slot index (32 bit) |
+ * The type tag is never zero, so no valid handle equals ENV_INVALID_UUID. A slot gets a new generation
+ * whenever its object is destroyed, which turns all old handles to it stale.
+ */
+
+enum Object_Type_Tag : uint8_t {
+    OBJ_TAG_ENVIRONMENT     = 1,
+    OBJ_TAG_FRAME           = 2,
+    OBJ_TAG_CAMERA          = 3,
+    OBJ_TAG_WINDOW          = 4,
+    OBJ_TAG_FILAMENT_ENTITY = 5,
+    OBJ_TAG_GLTF_INSTANCE   = 6
+};
+
+#define ENV_HANDLE_MAX_GENERATION 0xFFFFFF
+
+inline uint64_t make_handle(uint8_t tag, uint32_t generation, uint32_t slot_idx)
+{
+    return (uint64_t(tag) << 56) | (uint64_t(generation) << 32) | uint64_t(slot_idx);
+}
+inline uint8_t  handle_tag(uint64_t handle)        { return uint8_t(handle >> 56); }
+inline uint32_t handle_generation(uint64_t handle) { return uint32_t(handle >> 32) & ENV_HANDLE_MAX_GENERATION; }
+inline uint32_t handle_slot_idx(uint64_t handle)   { return uint32_t(handle); }
+
+/*
+ * Generational slot map: objects are looked up by indexing into 'slots' and comparing the generation.
+ * 'live' densely lists the occupied slots, so walking all objects costs only as much as there are alive.
+ */
+template <typename T, uint8_t TAG>
+struct Slot_Map {
+    struct Slot {
+        T value = {};
+        uint32_t generation = 1;
+        uint32_t live_idx = 0;     // position in 'live'
+        uint64_t created_at = 0;   // creation order over all object types
+        bool alive = false;
+    };
+
+    std::vector<Slot> slots;
+    std::vector<uint32_t> free_slots;
+    std::vector<uint32_t> live;
+
+    uint64_t insert(T value, uint64_t created_at)
+    {
+        uint32_t slot_idx;
+        if (!free_slots.empty()) {
+            slot_idx = free_slots.back();
+            free_slots.pop_back();
+        }
+        else {
+            slot_idx = uint32_t(slots.size());
+            slots.emplace_back();
+        }
+
+        Slot& slot = slots[slot_idx];
+        slot.value = value;
+        slot.live_idx = uint32_t(live.size());
+        slot.created_at = created_at;
+        slot.alive = true;
+        live.push_back(slot_idx);
+        return make_handle(TAG, slot.generation, slot_idx);
+    }
+
+    T* find(uint64_t handle)
+    {
+        uint32_t slot_idx = handle_slot_idx(handle);
+        if (handle_tag(handle) != TAG || slot_idx >= slots.size()) return nullptr;
+        Slot& slot = slots[slot_idx];
+        if (!slot.alive || slot.generation != handle_generation(handle)) return nullptr;
+        return &slot.value;
+    }
+
+    bool erase(uint64_t handle)
+    {
+        if (!find(handle)) return false;
+        erase_slot(handle_slot_idx(handle));
+        return true;
+    }
+
+    void erase_slot(uint32_t slot_idx)
+    {
+        Slot& slot = slots[slot_idx];
+
+        // swap-remove from the live list
+        uint32_t moved_slot_idx = live.back();
+        live[slot.live_idx] = moved_slot_idx;
+        slots[moved_slot_idx].live_idx = slot.live_idx;
+        live.pop_back();
+
+        slot.value = {};
+        slot.alive = false;
+        // A slot whose generation would wrap around is retired, otherwise ancient handles could become valid again.
+        if (++slot.generation <= ENV_HANDLE_MAX_GENERATION) {
+            free_slots.push_back(slot_idx);
+        }
+    }
+
+    // Keeps the generations, so handles from before stay stale.
+    void clear()
+    {
+        while (!live.empty()) {
+            erase_slot(live.back());
+        }
+    }
+
+    uint64_t handle_of(uint32_t slot_idx) const { return make_handle(TAG, slots[slot_idx].generation, slot_idx); }
+    size_t size() const { return live.size(); }
+    bool empty() const { return live.empty(); }
+};
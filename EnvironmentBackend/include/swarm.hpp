@@ -0,0 +1,59 @@
+#pragma once
+
+#include "../environments.hpp"
+#include <math.hpp>
+
+#include <utils/Entity.h>
+#include <math/mat4.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace filament {
+    class VertexBuffer;
+    class IndexBuffer;
+    class InstanceBuffer;
+    class MaterialInstance;
+}
+
+namespace fmt = filament;
+
+struct Environment;
+
+// Instances per renderable, filament limits how many transforms one InstanceBuffer can hold.
+#define ENV_SWARM_CHUNK_SIZE 512
+
+// One triangle primitive of the glTF asset, the node transforms are baked into the vertices.
+struct Swarm_Mesh {
+    fmt::VertexBuffer* vertex_buffer = nullptr;
+    fmt::IndexBuffer* index_buffer = nullptr;
+    fmt::MaterialInstance* material = nullptr;
+    uint32_t n_indices = 0;
+    fmath::float3 aabb_min;
+    fmath::float3 aabb_max;
+};
+
+// Draws one mesh for the instances [first_instance, first_instance + n_instances), its bounding box
+// encloses the mesh at all of these instances.
+struct Swarm_Renderable {
+    utils::Entity entity;
+    fmt::InstanceBuffer* instance_buffer = nullptr;
+    uint32_t mesh_idx = 0;
+    uint32_t first_instance = 0;
+    uint32_t n_instances = 0;
+};
+
+/*
+ * Many copies of one glTF asset drawn with gpu instancing: every mesh is uploaded once and
+ * drawn by one renderable per ENV_SWARM_CHUNK_SIZE instances. All renderables are children
+ * of 'root', so the swarm as a whole can be moved like any other entity.
+ */
+struct Swarm {
+    utils::Entity root;
+    uint32_t n_instances = 0;
+    std::vector<Swarm_Mesh> meshes;
+    std::vector<Swarm_Renderable> renderables;
+    std::vector<fmath::mat4f> instance_transforms; // relative to 'root'
+};
+
+void swarm_destroy(Environment* env, Swarm* swarm);
@@ -0,0 +1,19 @@
+#pragma once
+
+namespace filament {
+    class Engine;
+
+    namespace gltfio {
+        class TextureProvider;
+    }
+}
+
+namespace fmt = filament;
+namespace fgltfio = filament::gltfio;
+
+/*
+ * A png/jpeg texture provider for the glTF ResourceLoader, which decodes every texture in its own job on
+ * the JobSystem of the engine, so a big asset keeps all cores busy. The decoded images are uploaded (and
+ * their mipmaps generated) by the thread, which polls the provider through the ResourceLoader.
+ */
+fgltfio::TextureProvider* create_parallel_texture_provider(fmt::Engine* engine);
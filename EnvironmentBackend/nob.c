@@ -21,6 +21,7 @@
 #define INCLUDE_FOLDER "include/"
 #define ASSET_FOLDER "assets/"
 #define EXTERN_FOLDER "extern/"
+#define KTX2_ASSET_FOLDER "ktx2/"
 
 #define STRLITERAL_TARGET_NAME "strliteral"
 #define STRLITERAL_EXECUTABLE_PATH BUILD_FOLDER BIN_FOLDER STRLITERAL_TARGET_NAME
@@ -34,9 +35,11 @@
 #define FILAMENT_FILABRIDGE_INCLUDE_PATH    "./filament/libs/filabridge/include/"
 #define FILAMENT_IBLPREFILTER_INCLUDE_PATH  "./filament/libs/iblprefilter/include/"
 #define FILAMENT_GLTFIO_INCLUDE_PATH        "./filament/libs/gltfio/include/"
+#define FILAMENT_GLTFIO_RESOURCES_PATH      FILAMENT_LIBS "gltfio/" // generated ubershader archive
 #define FILAMENT_SDL2_INCLUDE_PATH          "./filament/third_party/libsdl2/include/"
 #define FILAMENT_STB_INCLUDE_PATH           "./filament/third_party/stb/"
 #define FILAMENT_ROBIN_MAP_INCLUDE_PATH     "./filament/third_party/robin-map/"
+#define FILAMENT_CGLTF_INCLUDE_PATH         "./filament/third_party/cgltf/"
 
 #define FILAMENT_BUILD_DIR "./filament/out/"
 #define FILAMENT_BUILD_RELEASE_FOLDER "cmake-release/"
@@ -60,6 +63,8 @@
 #define FILAMENT_IBL_PATH               FILAMENT_LIBS "ibl/"
 #define FILAMENT_IBL_PREFILTER_LIB_PATH FILAMENT_LIBS "iblprefilter/"
 #define FILAMENT_FILAMAT_LIB_PATH       FILAMENT_LIBS "filamat/"
+#define FILAMENT_KTXREADER_LIB_PATH     FILAMENT_LIBS "ktxreader/"
+#define FILAMENT_IMAGE_LIB_PATH         FILAMENT_LIBS "image/"
 
 #define FILAMENT_SMOLV_LIB_PATH           FILAMENT_THIRD_PARTY "smol-v/tnt/"
 #define FILAMENT_GLSLANG_LIB_PATH         FILAMENT_THIRD_PARTY "glslang/tnt/glslang/"
@@ -70,6 +75,8 @@
 #define FILAMENT_SPIRV_TOOLS_LIB_PATH     FILAMENT_THIRD_PARTY "spirv-tools/source/"
 #define FILAMENT_SPIRV_TOOLS_OPT_LIB_PATH FILAMENT_THIRD_PARTY "spirv-tools/source/opt/"
 #define FILAMENT_MESH_OPTIMIZER_LIB_PATH  FILAMENT_THIRD_PARTY "meshoptimizer/tnt/"
+#define FILAMENT_BASISU_LIB_PATH          FILAMENT_THIRD_PARTY "basisu/tnt/"
+#define FILAMENT_ZSTD_LIB_PATH            FILAMENT_THIRD_PARTY "zstd/tnt/"
 #define FILAMENT_SDL2_LIB_PATH            FILAMENT_THIRD_PARTY "libsdl2/tnt/"
 
 #define ENVLIB_TARGET_NAME "libenvironment.so"
@@ -158,7 +165,8 @@ bool compile_and_embed_filament_materials(Cmd *cmd)
 {
     const char* materials[] = {
         "./assets/sandboxLit",
-        "./assets/sandboxUnlit"
+        "./assets/sandboxUnlit",
+        "./assets/vertexColorUnlit"
     };
 
     for (int i = 0; i < ARRAY_LEN(materials); ++i)
@@ -194,6 +202,40 @@ bool compile_and_embed_filament_materials(Cmd *cmd)
     return true;
 }
 
+// Converts the textures of every .glb in assets/ to KTX2 (UASTC, supercompressed), the results go to assets/ktx2/.
+// Needs 'gltf-transform' (npm install -g @gltf-transform/cli) and 'toktx' from the KTX-Software in the PATH.
+bool convert_assets_to_ktx2(Cmd *cmd)
+{
+    if (!mkdir_if_not_exists(ASSET_FOLDER KTX2_ASSET_FOLDER)) return false;
+
+    Nob_File_Paths file_paths = {0};
+    if (!nob_read_entire_dir(ASSET_FOLDER, &file_paths)) return false;
+
+    for (int i = 0; i < file_paths.count; ++i) {
+        if (!has_file_ext(file_paths.items[i], "glb")) continue;
+
+        String_Builder input = {0};
+        sb_append_cstr(&input, ASSET_FOLDER);
+        sb_append_cstr(&input, file_paths.items[i]);
+        sb_append_null(&input);
+
+        String_Builder output = {0};
+        sb_append_cstr(&output, ASSET_FOLDER KTX2_ASSET_FOLDER);
+        sb_append_cstr(&output, file_paths.items[i]);
+        sb_append_null(&output);
+
+        cmd_append(cmd, "gltf-transform", "uastc", input.items, output.items, "--zstd", "18");
+        bool converted = cmd_run_sync_and_reset(cmd);
+
+        sb_free(input);
+        sb_free(output);
+        if (!converted) return false;
+    }
+
+    build_success("KTX2 assets");
+    return true;
+}
+
 bool build_google_filament(Cmd *cmd)
 {
     if (!mkdir_if_not_exists(FILAMENT_BUILD_DIR)) return 1;
@@ -206,6 +248,7 @@ bool build_google_filament(Cmd *cmd)
                "-DCMAKE_C_COMPILER=clang",
                "-DCMAKE_BUILD_TYPE=Release",
                "-DCMAKE_INSTALL_PREFIX=../release/filament",
+               "-DFILAMENT_SUPPORTS_EGL_ON_LINUX=ON", // PlatformEGLHeadless, for display-less rendering
                "-DCMAKE_CXX_FLAGS=\"-fPIC\"",
                "-DCMAKE_C_FLAGS=\"-fPIC\"",
                "../..");
@@ -257,26 +300,48 @@ bool build_libenvironment_shared(Cmd *cmd)
                "-I", FILAMENT_FILABRIDGE_INCLUDE_PATH,
                "-I", FILAMENT_IBLPREFILTER_INCLUDE_PATH,
                "-I", FILAMENT_GLTFIO_INCLUDE_PATH,
+               "-I", FILAMENT_GLTFIO_RESOURCES_PATH,
                "-I", FILAMENT_ROBIN_MAP_INCLUDE_PATH,
+               "-I", FILAMENT_CGLTF_INCLUDE_PATH,
                "-I", FILAMENT_SDL2_INCLUDE_PATH,
                "-I", FILAMENT_STB_INCLUDE_PATH);
 
     const char* source_files[] = {
+        SRC_FOLDER "animation.cpp",
         SRC_FOLDER "camera.cpp",
+        SRC_FOLDER "debug_draw.cpp",
+        SRC_FOLDER "disk_cache.cpp",
+        SRC_FOLDER "engine_context.cpp",
         SRC_FOLDER "environment.cpp",
         SRC_FOLDER "filament_entity.cpp",
         SRC_FOLDER "filament_object_wrappers.cpp",
         SRC_FOLDER "frame.cpp",
+        SRC_FOLDER "ibl.cpp",
+        SRC_FOLDER "irradiance_sh.cpp",
         SRC_FOLDER "logging.cpp",
+        SRC_FOLDER "mapped_file.cpp",
+        SRC_FOLDER "material_provider.cpp",
         SRC_FOLDER "math.cpp",
         SRC_FOLDER "mesh.cpp",
         SRC_FOLDER "object_manager.cpp",
+        SRC_FOLDER "pixel_conversion.cpp",
+        SRC_FOLDER "point_cloud.cpp",
+        SRC_FOLDER "polyline.cpp",
+        SRC_FOLDER "polyline_ring.cpp",
+        SRC_FOLDER "primitive_mesh.cpp",
+        SRC_FOLDER "primitives.cpp",
+        SRC_FOLDER "renderable_buffers.cpp",
+        SRC_FOLDER "segmentation.cpp",
+        SRC_FOLDER "shm_export.cpp",
         SRC_FOLDER "stb_image.cpp",
+        SRC_FOLDER "swarm.cpp",
+        SRC_FOLDER "texture_provider.cpp",
         SRC_FOLDER "window.cpp",
         
         // from binaries generated cpp files
         ASSET_FOLDER "sandboxLit.cpp",
         ASSET_FOLDER "sandboxUnlit.cpp",
+        ASSET_FOLDER "vertexColorUnlit.cpp",
     };
 
     cmd_append_static_array(cmd, source_files);
@@ -312,6 +377,10 @@ bool build_libenvironment_shared(Cmd *cmd)
                "-L", FILAMENT_SPIRV_TOOLS_LIB_PATH,
                "-L", FILAMENT_SPIRV_TOOLS_OPT_LIB_PATH,
                "-L", FILAMENT_MESH_OPTIMIZER_LIB_PATH,
+               "-L", FILAMENT_KTXREADER_LIB_PATH,
+               "-L", FILAMENT_IMAGE_LIB_PATH,
+               "-L", FILAMENT_BASISU_LIB_PATH,
+               "-L", FILAMENT_ZSTD_LIB_PATH,
                "-L", FILAMENT_SDL2_LIB_PATH);
 
     const char *filament_libs[] = {
@@ -327,6 +396,11 @@ bool build_libenvironment_shared(Cmd *cmd)
 
         "-lgltfio",
         "-lgltfio_core",
+        "-luberarchive",
+        "-lktxreader",
+        "-limage",
+        "-lbasis_transcoder",
+        "-lzstd",
         "-lglslang",
         "-lshaders",
         "-ldracodec",
@@ -352,8 +426,10 @@ bool build_libenvironment_shared(Cmd *cmd)
 
     const char* external_libs[] = {
         "-lpthread",
+        "-lrt",
         "-lc++",
-        "-ldl"
+        "-ldl",
+        "-lEGL"
     };
     cmd_append_static_array(cmd, external_libs);
 
@@ -388,6 +464,50 @@ bool build_libenvironment_shared_test(Cmd *cmd)
     return true;
 }
 
+// Unit tests for the pure cpu code, they compile the tested sources directly (libenvironment.so hides all
+// internal symbols) and need no gpu, window or filament libraries.
+typedef struct {
+    const char* name;        // tests/<name>.cpp
+    const char* sources[4];  // tested sources, NULL terminated
+} Unit_Test;
+
+static const Unit_Test unit_tests[] = {
+    {"disk_cache_test",       {SRC_FOLDER "disk_cache.cpp", SRC_FOLDER "logging.cpp"}},
+    {"irradiance_sh_test",    {SRC_FOLDER "irradiance_sh.cpp"}},
+    {"pixel_conversion_test", {SRC_FOLDER "pixel_conversion.cpp", SRC_FOLDER "logging.cpp"}},
+    {"polyline_ring_test",    {SRC_FOLDER "polyline_ring.cpp"}},
+    {"primitive_mesh_test",   {SRC_FOLDER "primitive_mesh.cpp"}},
+    {"segmentation_id_test",  {NULL}},
+    {"shm_export_test",       {SRC_FOLDER "shm_export.cpp", SRC_FOLDER "logging.cpp"}},
+    {"slot_map_test",         {NULL}},
+};
+
+bool build_and_run_unit_tests(Cmd *cmd)
+{
+    for (int i = 0; i < ARRAY_LEN(unit_tests); ++i) {
+        const Unit_Test* test = &unit_tests[i];
+        cmd_append(cmd, CXX, CPPFLAGS, "-O2", "-o", test->name);
+        cmd_append(cmd, "-I", INCLUDE_FOLDER,
+                   "-I", FILAMENT_BACKEND_INCLUDE_PATH,
+                   "-I", FILAMENT_MATH_INCLUDE_PATH,
+                   "-I", FILAMENT_UTILS_INCLUDE_PATH,
+                   "-I", FILAMENT_SDL2_INCLUDE_PATH);
+        cmd_append(cmd, temp_sprintf(TESTS_FOLDER "%s.cpp", test->name));
+        for (int j = 0; j < ARRAY_LEN(test->sources) && test->sources[j]; ++j) {
+            cmd_append(cmd, test->sources[j]);
+        }
+        if (!cmd_run_sync_and_reset(cmd)) return false;
+
+        move_local_file_to_folder(test->name, BUILD_FOLDER BIN_FOLDER);
+
+        cmd_append(cmd, temp_sprintf(BUILD_FOLDER BIN_FOLDER "%s", test->name));
+        if (!cmd_run_sync_and_reset(cmd)) return false;
+    }
+
+    build_success("unit tests");
+    return true;
+}
+
 void print_help()
 {
     static const char* help_message =
@@ -400,8 +520,9 @@ void print_help()
         "  'filament'    Build Google-Filament. Make sure to install the dependencies first!!\n"
         "  'libenv'      Build 'libenvironment.so' .\n"
         "  'clean'       Clean the build.\n"
-        "  'tests'       Build the tests.\n"
+        "  'tests'       Build the tests and run the unit tests.\n"
         "  'materials'   Compile the materials (.mat to .filamat).\n"
+        "  'ktx2'        Convert the textures of the .glb assets to KTX2 (needs gltf-transform and toktx).\n"
         "  'strliteral'  Build strliteral.c, a tool for converting binary data into C (string-literals)\n";
     
     printf("%s", help_message);
@@ -427,6 +548,7 @@ int main(int argc, char **argv)
     bool compile_materials = false;
     bool build_filament = false;
     bool build_strliteral = false;
+    bool convert_ktx2 = false;
 
     // No arguments means, nothing will happen.
     if (argc == 0) {
@@ -461,6 +583,9 @@ int main(int argc, char **argv)
         else if (!strcmp(nob_cmd, "strliteral")) {
             build_strliteral = true; 
         }
+        else if (!strcmp(nob_cmd, "ktx2")) {
+            convert_ktx2 = true;
+        }
         else if (!strcmp(nob_cmd, "all")) {
             build_libenv = true; 
             build_tests = true; 
@@ -492,12 +617,17 @@ int main(int argc, char **argv)
         if (!compile_and_embed_filament_materials(&cmd)) return 1;
     }
 
+    if (convert_ktx2) {
+        if (!convert_assets_to_ktx2(&cmd)) return 1;
+    }
+
     if (build_libenv) {
         if (!build_libenvironment_shared(&cmd)) return 1;
     }
 
     if (build_tests) {
         if (!build_libenvironment_shared_test(&cmd)) return 1;
+        if (!build_and_run_unit_tests(&cmd)) return 1;
     }
 
     return 0;
@@ -0,0 +1,309 @@
+#include "../environments.hpp"
+#include <animation.hpp>
+
+#include <environment.hpp>
+#include <object_manager.hpp>
+#include <logging.hpp>
+#include <math.hpp>
+
+#include <filament/Engine.h>
+#include <filament/TransformManager.h>
+#include <gltfio/Animator.h>
+#include <gltfio/FilamentAsset.h>
+#include <gltfio/FilamentInstance.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Every function below gets its animator through here, instances without animations are refused.
+static fgltfio::Animator* get_animator(glTF_Instance instance)
+{
+    if (!instance.is_valid()) return nullptr;
+    fgltfio::Animator* animator = instance.gltf_instance->getAnimator();
+    if (!animator) {
+        env_soft_error("The glTF instance has no animator, its resources might not be loaded yet.");
+    }
+    return animator;
+}
+
+static bool check_animation_index(fgltfio::Animator* animator, uint32_t animation_index)
+{
+    if (animation_index < animator->getAnimationCount()) return true;
+    env_soft_error("Animation index %u is out of range, the instance has %zu animations.",
+                   animation_index, animator->getAnimationCount());
+    return false;
+}
+
+static Animated_Instance* get_or_add_animated_instance(glTF_Instance instance)
+{
+    Environment* env = instance.associated_env;
+    auto itr = env->animated_instances.find(instance.gltf_instance);
+    if (itr != env->animated_instances.end()) return itr->second;
+
+    Animated_Instance* animated = new Animated_Instance;
+    animated->instance = instance.gltf_instance;
+    env->animated_instances[instance.gltf_instance] = animated;
+    return animated;
+}
+
+static Animation_Track* find_track(glTF_Instance instance, uint32_t animation_index)
+{
+    auto itr = instance.associated_env->animated_instances.find(instance.gltf_instance);
+    if (itr == instance.associated_env->animated_instances.end()) return nullptr;
+    for (Animation_Track& track : itr->second->tracks) {
+        if (track.animation_index == animation_index) return &track;
+    }
+    return nullptr;
+}
+
+uint32_t get_gltf_animation_count(glTF_Instance_ID gltf_instance_id)
+{
+    fgltfio::Animator* animator = get_animator(g_objm.get_object(gltf_instance_id));
+    if (!animator) return 0;
+    return uint32_t(animator->getAnimationCount());
+}
+
+int32_t get_gltf_animation_index(glTF_Instance_ID gltf_instance_id, const char* name)
+{
+    fgltfio::Animator* animator = get_animator(g_objm.get_object(gltf_instance_id));
+    if (!animator) return -1;
+
+    for (size_t i = 0; i < animator->getAnimationCount(); ++i) {
+        const char* animation_name = animator->getAnimationName(i);
+        if (animation_name && strcmp(animation_name, name) == 0) return int32_t(i);
+    }
+    return -1;
+}
+
+double get_gltf_animation_duration(glTF_Instance_ID gltf_instance_id, uint32_t animation_index)
+{
+    fgltfio::Animator* animator = get_animator(g_objm.get_object(gltf_instance_id));
+    if (!animator || !check_animation_index(animator, animation_index)) return 0.0;
+    return animator->getAnimationDuration(animation_index);
+}
+
+bool play_gltf_animation(glTF_Instance_ID gltf_instance_id, uint32_t animation_index, bool loop)
+{
+    glTF_Instance instance = g_objm.get_object(gltf_instance_id);
+    fgltfio::Animator* animator = get_animator(instance);
+    if (!animator || !check_animation_index(animator, animation_index)) return false;
+
+    // playing an animation again restarts it
+    Animation_Track* track = find_track(instance, animation_index);
+    if (!track) {
+        Animated_Instance* animated = get_or_add_animated_instance(instance);
+        animated->tracks.push_back({});
+        track = &animated->tracks.back();
+        track->animation_index = animation_index;
+    }
+    track->time_s = 0.0;
+    track->loop = loop;
+    track->finished = false;
+    instance.associated_env->animations_dirty = true;
+    return true;
+}
+
+// The instance keeps the pose of the last applied frame.
+bool stop_gltf_animation(glTF_Instance_ID gltf_instance_id, uint32_t animation_index)
+{
+    glTF_Instance instance = g_objm.get_object(gltf_instance_id);
+    if (!instance.is_valid()) return false;
+
+    auto itr = instance.associated_env->animated_instances.find(instance.gltf_instance);
+    if (itr == instance.associated_env->animated_instances.end()) return true;
+
+    std::vector<Animation_Track>& tracks = itr->second->tracks;
+    for (size_t i = 0; i < tracks.size(); ++i) {
+        if (tracks[i].animation_index != animation_index) continue;
+        tracks[i] = tracks.back();
+        tracks.pop_back();
+        break;
+    }
+    return true;
+}
+
+bool set_gltf_animation_speed(glTF_Instance_ID gltf_instance_id, uint32_t animation_index, double speed)
+{
+    glTF_Instance instance = g_objm.get_object(gltf_instance_id);
+    if (!instance.is_valid()) return false;
+
+    Animation_Track* track = find_track(instance, animation_index);
+    if (!track) {
+        env_soft_error("Animation %u is not playing, start it with 'play_gltf_animation' first.", animation_index);
+        return false;
+    }
+    track->speed = speed;
+    return true;
+}
+
+bool set_gltf_animation_time(glTF_Instance_ID gltf_instance_id, uint32_t animation_index, double time_s)
+{
+    glTF_Instance instance = g_objm.get_object(gltf_instance_id);
+    if (!instance.is_valid()) return false;
+
+    Animation_Track* track = find_track(instance, animation_index);
+    if (!track) {
+        env_soft_error("Animation %u is not playing, start it with 'play_gltf_animation' first.", animation_index);
+        return false;
+    }
+    track->time_s = time_s;
+    track->finished = false;
+    instance.associated_env->animations_dirty = true;
+    return true;
+}
+
+int32_t add_gltf_spin_channel(glTF_Instance_ID gltf_instance_id, const char* node_name, float3 axis)
+{
+    glTF_Instance instance = g_objm.get_object(gltf_instance_id);
+    if (!instance.is_valid()) return -1;
+
+    const fgltfio::FilamentAsset* asset = instance.gltf_instance->getAsset();
+    const utils::Entity* entities = instance.gltf_instance->getEntities();
+    utils::Entity node;
+    for (size_t i = 0; i < instance.gltf_instance->getEntityCount(); ++i) {
+        const char* name = asset->getName(entities[i]);
+        if (name && strcmp(name, node_name) == 0) {
+            node = entities[i];
+            break;
+        }
+    }
+    if (node.isNull()) {
+        env_soft_error("The glTF instance has no node named '%s'.", node_name);
+        return -1;
+    }
+
+    fmath::float3 faxis = f3_to_ff3(axis);
+    if (length(faxis) == 0.0f) {
+        env_soft_error("The axis of a spin channel must not be zero.");
+        return -1;
+    }
+
+    fmt::TransformManager& trans_m = instance.associated_env->engine->getTransformManager();
+    Spin_Channel channel;
+    channel.node = node;
+    channel.rest_transform = trans_m.getTransform(trans_m.getInstance(node));
+    channel.axis = normalize(faxis);
+
+    Animated_Instance* animated = get_or_add_animated_instance(instance);
+    animated->spin_channels.push_back(channel);
+    instance.associated_env->animations_dirty = true;
+    return int32_t(animated->spin_channels.size() - 1);
+}
+
+bool set_gltf_spin_rates(const glTF_Instance_ID* gltf_instance_ids, uint32_t n_instances, const float* rates_rad_per_s, uint32_t n_channels)
+{
+    bool all_set = true;
+    for (uint32_t i = 0; i < n_instances; ++i) {
+        glTF_Instance instance = g_objm.get_object(gltf_instance_ids[i]);
+        if (!instance.is_valid()) {
+            all_set = false;
+            continue;
+        }
+
+        auto itr = instance.associated_env->animated_instances.find(instance.gltf_instance);
+        if (itr == instance.associated_env->animated_instances.end() || itr->second->spin_channels.size() < n_channels) {
+            env_soft_error("The glTF instance has less than %u spin channels.", n_channels);
+            all_set = false;
+            continue;
+        }
+        for (uint32_t c = 0; c < n_channels; ++c) {
+            itr->second->spin_channels[c].rate = rates_rad_per_s[size_t(i) * n_channels + c];
+        }
+    }
+    return all_set;
+}
+
+bool set_gltf_spin_angle(glTF_Instance_ID gltf_instance_id, uint32_t channel_index, double angle_rad)
+{
+    glTF_Instance instance = g_objm.get_object(gltf_instance_id);
+    if (!instance.is_valid()) return false;
+
+    auto itr = instance.associated_env->animated_instances.find(instance.gltf_instance);
+    if (itr == instance.associated_env->animated_instances.end() || channel_index >= itr->second->spin_channels.size()) {
+        env_soft_error("The glTF instance has no spin channel %u.", channel_index);
+        return false;
+    }
+    itr->second->spin_channels[channel_index].angle = std::fmod(angle_rad, 2.0 * M_PI);
+    instance.associated_env->animations_dirty = true;
+    return true;
+}
+
+bool advance_gltf_animations(Environment_ID env_id, double dt_s)
+{
+    Environment* env = g_objm.get_object(env_id);
+    if (!env) return false;
+
+    for (auto& [instance, animated] : env->animated_instances) {
+        fgltfio::Animator* animator = instance->getAnimator();
+        if (animator) {
+            for (Animation_Track& track : animated->tracks) {
+                double duration = animator->getAnimationDuration(track.animation_index);
+                track.time_s += dt_s * track.speed;
+                if (track.loop && duration > 0.0) {
+                    track.time_s = std::fmod(track.time_s, duration);
+                    if (track.time_s < 0.0) track.time_s += duration;
+                }
+                else if (track.time_s >= duration || track.time_s < 0.0) {
+                    track.time_s = std::clamp(track.time_s, 0.0, duration);
+                    track.finished = true;
+                }
+            }
+        }
+        for (Spin_Channel& channel : animated->spin_channels) {
+            channel.angle = std::fmod(channel.angle + channel.rate * dt_s, 2.0 * M_PI);
+        }
+    }
+    env->animations_dirty = true;
+    return true;
+}
+
+void animations_apply(Environment* env)
+{
+    if (!env->animations_dirty) return;
+    env->animations_dirty = false;
+
+    // the animators set the node transforms in their own transactions
+    for (auto& [instance, animated] : env->animated_instances) {
+        fgltfio::Animator* animator = instance->getAnimator();
+        if (!animator) continue;
+
+        for (size_t i = 0; i < animated->tracks.size();) {
+            Animation_Track& track = animated->tracks[i];
+            animator->applyAnimation(track.animation_index, float(track.time_s));
+            if (track.finished) {
+                // the last pose stays
+                track = animated->tracks.back();
+                animated->tracks.pop_back();
+            }
+            else {
+                i++;
+            }
+        }
+    }
+
+    // all spin channels of the environment in one transaction, the world transforms are updated once at the end
+    fmt::TransformManager& trans_m = env->engine->getTransformManager();
+    trans_m.openLocalTransformTransaction();
+    for (auto& [instance, animated] : env->animated_instances) {
+        for (Spin_Channel& channel : animated->spin_channels) {
+            fmath::mat4f rotation = fmath::mat4f::rotation(float(channel.angle), channel.axis);
+            trans_m.setTransform(trans_m.getInstance(channel.node), channel.rest_transform * rotation);
+        }
+    }
+    trans_m.commitLocalTransformTransaction();
+
+    // skins follow their joints, spun nodes included
+    for (auto& [instance, animated] : env->animated_instances) {
+        fgltfio::Animator* animator = instance->getAnimator();
+        if (animator) animator->updateBoneMatrices();
+    }
+}
+
+void animations_forget_instance(Environment* env, fgltfio::FilamentInstance* instance)
+{
+    auto itr = env->animated_instances.find(instance);
+    if (itr == env->animated_instances.end()) return;
+    delete itr->second;
+    env->animated_instances.erase(itr);
+}
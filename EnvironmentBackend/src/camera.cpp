@@ -5,9 +5,15 @@
 #include <object_manager.hpp>
 #include <logging.hpp>
 #include <math.hpp>
+#include <segmentation.hpp>
 
 #include <filament/Engine.h>
+#include <filament/Box.h>
 #include <filament/Camera.h>
+#include <filament/Frustum.h>
+#include <filament/RenderableManager.h>
+#include <filament/Scene.h>
+#include <filament/TransformManager.h>
 #include <filament/View.h>
 #include <filament/Viewport.h>
 #include <utils/EntityManager.h>
@@ -40,8 +46,6 @@ Camera_ID create_camera(Environment_ID env_id, double3 pos, double3 lookat, doub
     camera->view->setScene(env->scene);
     camera->view->setViewport({0, 0, width, height});
 
-    camera->renderer = env->engine->createRenderer();
-
     return g_objm.add_object(camera);
 }
 
@@ -49,9 +53,43 @@ Camera::~Camera()
 {
     fmt::Engine* engine = env->engine;
     engine->destroy(view);
+    if (depth_view) {
+        engine->destroy(depth_view);
+    }
+    if (mask_view) {
+        engine->destroy(mask_view);
+    }
+}
+
+// Views for the auxiliary images (depth, segmentation), they share the camera but skip everything,
+// that would alter the raw values written into the render target.
+static fmt::View* create_auxiliary_view(Camera* camera)
+{
+    fmt::View* view = camera->env->engine->createView();
+    view->setCamera(camera->fcamera);
+    view->setScene(camera->env->scene);
+    view->setPostProcessingEnabled(false);
+    view->setShadowingEnabled(false);
+    return view;
+}
 
-    // FIXME: WE SHOULD DESTROY THE RENDERER, BUT FILAMENT CRASHES HERE SOMETIMES
-    // engine->destroy(renderer);
+fmt::View* get_camera_depth_view(Camera* camera)
+{
+    if (!camera->depth_view) {
+        camera->depth_view = create_auxiliary_view(camera);
+    }
+    camera->depth_view->setViewport(camera->view->getViewport());
+    return camera->depth_view;
+}
+
+fmt::View* get_camera_mask_view(Camera* camera)
+{
+    if (!camera->mask_view) {
+        camera->mask_view = create_auxiliary_view(camera);
+        camera->mask_view->setVisibleLayers(0xFF, ENV_SEGMENTATION_LAYER);
+    }
+    camera->mask_view->setViewport(camera->view->getViewport());
+    return camera->mask_view;
 }
 
 // Environment* get_camera_environment(Camera* camera) { return camera->env; }
@@ -110,6 +148,42 @@ double update_image_time(Camera* camera)
     return prev_time;
 }
 
+// The same test filament culls with: the world space bounding box of every renderable visible to the
+// view against the frustum of the camera. Renderables outside of the visible layers are not counted.
+void update_culling_stats(Camera* camera)
+{
+    fmt::RenderableManager& rm = camera->env->engine->getRenderableManager();
+    fmt::TransformManager& trans_m = camera->env->engine->getTransformManager();
+    fmt::Frustum frustum = camera->fcamera->getFrustum();
+    uint8_t visible_layers = camera->view->getVisibleLayers();
+
+    uint32_t n_drawn = 0;
+    uint32_t n_culled = 0;
+    camera->env->scene->forEach([&](utils::Entity entity) {
+        auto ri = rm.getInstance(entity);
+        if (!ri || !(rm.getLayerMask(ri) & visible_layers)) return;
+
+        fmt::Box box = rm.getAxisAlignedBoundingBox(ri);
+        auto ti = trans_m.getInstance(entity);
+        if (ti) box = rigidTransform(box, trans_m.getWorldTransform(ti));
+
+        if (frustum.intersects(box)) n_drawn++;
+        else n_culled++;
+    });
+    camera->n_drawn_renderables = n_drawn;
+    camera->n_culled_renderables = n_culled;
+}
+
+bool get_camera_culling_stats(Camera_ID camera_id, uint32_t* n_drawn, uint32_t* n_culled)
+{
+    Camera* camera = g_objm.get_object(camera_id);
+    if (!camera) return false;
+
+    *n_drawn = camera->n_drawn_renderables;
+    *n_culled = camera->n_culled_renderables;
+    return true;
+}
+
 ENV_API Filament_Entity_ID get_camera_filament_entity(Camera_ID camera_id)
 {
     Camera* camera = g_objm.get_object(camera_id);
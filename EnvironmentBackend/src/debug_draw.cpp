@@ -0,0 +1,284 @@
+#include "../environments.hpp"
+#include <debug_draw.hpp>
+
+#include <environment.hpp>
+#include <engine_context.hpp>
+#include <object_manager.hpp>
+#include <renderable_buffers.hpp>
+#include <logging.hpp>
+
+#include <filament/Box.h>
+#include <filament/Engine.h>
+#include <filament/Material.h>
+#include <filament/MaterialInstance.h>
+#include <filament/Scene.h>
+#include <filament/RenderableManager.h>
+#include <filament/VertexBuffer.h>
+#include <filament/IndexBuffer.h>
+#include <utils/EntityManager.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+#define DEBUG_DRAW_MIN_CAPACITY 1024
+#define DEBUG_DRAW_CIRCLE_SEGMENTS 24
+
+static void push_segment(Environment* env, fmath::double3 a, fmath::double3 b, uint32_t color)
+{
+    env->debug_draw.vertices.push_back({fmath::float3(a), color});
+    env->debug_draw.vertices.push_back({fmath::float3(b), color});
+}
+
+// The index buffer is just 0, 1, 2, ..., the vertices already come in pairs.
+static bool create_debug_draw_buffers(Environment* env, Debug_Draw* dd, uint32_t capacity)
+{
+    dd->vertex_buffer = fmt::VertexBuffer::Builder()
+        .vertexCount(capacity)
+        .bufferCount(1)
+        .attribute(fmt::VertexAttribute::POSITION, 0, fmt::VertexBuffer::AttributeType::FLOAT3,
+                   offsetof(Debug_Vertex, position), sizeof(Debug_Vertex))
+        .attribute(fmt::VertexAttribute::COLOR, 0, fmt::VertexBuffer::AttributeType::UBYTE4,
+                   offsetof(Debug_Vertex, color), sizeof(Debug_Vertex))
+        .normalized(fmt::VertexAttribute::COLOR)
+        .build(*env->engine);
+
+    dd->index_buffer = fmt::IndexBuffer::Builder()
+        .indexCount(capacity)
+        .bufferType(fmt::IndexBuffer::IndexType::UINT)
+        .build(*env->engine);
+
+    if (!dd->vertex_buffer || !dd->index_buffer) return false;
+
+    set_sequential_indices(env->engine, dd->index_buffer, capacity);
+    dd->capacity = capacity;
+    return true;
+}
+
+static void destroy_debug_draw_buffers(Environment* env, fmt::VertexBuffer* vertex_buffer, fmt::IndexBuffer* index_buffer)
+{
+    if (vertex_buffer) env->engine->destroy(vertex_buffer);
+    if (index_buffer) env->engine->destroy(index_buffer);
+}
+
+// The renderable is created lazily, environments without debug drawing don't pay for it.
+static bool ensure_debug_draw_renderable(Environment* env)
+{
+    Debug_Draw* dd = &env->debug_draw;
+    if (dd->material) return true;
+
+    if (!create_debug_draw_buffers(env, dd, DEBUG_DRAW_MIN_CAPACITY)) {
+        env_soft_error("Failed to create the debug draw buffers.");
+        destroy_debug_draw_buffers(env, dd->vertex_buffer, dd->index_buffer);
+        dd->vertex_buffer = nullptr;
+        dd->index_buffer = nullptr;
+        dd->capacity = 0;
+        return false;
+    }
+    dd->material = env->ctx->vertex_color_material->createInstance();
+
+    // Not registered for segmentation and only on ENV_DEBUG_DRAW_LAYER, so only the frames showing debug drawing see it.
+    dd->entity = utils::EntityManager::get().create();
+    fmt::RenderableManager::Builder(1)
+        .boundingBox({{0, 0, 0}, {0, 0, 0}})
+        .layerMask(0xFF, ENV_DEBUG_DRAW_LAYER)
+        .material(0, dd->material)
+        .geometry(0, fmt::RenderableManager::PrimitiveType::LINES,
+                  dd->vertex_buffer, dd->index_buffer, 0, 0)
+        .receiveShadows(false)
+        .castShadows(false)
+        .build(*env->engine, dd->entity);
+    env->scene->addEntity(dd->entity);
+    return true;
+}
+
+static Environment* get_debug_draw_environment()
+{
+    Environment* env = g_objm.get_active_environment();
+    if (!env) return nullptr;
+    if (!ensure_debug_draw_renderable(env)) return nullptr;
+    return env;
+}
+
+bool debug_line(double3 a, double3 b, float3 color)
+{
+    Environment* env = get_debug_draw_environment();
+    if (!env) return false;
+
+    push_segment(env, d3_to_fd3(a), d3_to_fd3(b), pack_color(color));
+    return true;
+}
+
+bool debug_arrow(double3 origin, double3 vector, float3 color)
+{
+    Environment* env = get_debug_draw_environment();
+    if (!env) return false;
+
+    fmath::double3 o = d3_to_fd3(origin);
+    fmath::double3 v = d3_to_fd3(vector);
+    fmath::double3 tip = o + v;
+    uint32_t c = pack_color(color);
+    push_segment(env, o, tip, c);
+
+    double len = length(v);
+    if (len == 0.0) return true;
+
+    // four head lines, spread around the shaft by two vectors perpendicular to it
+    fmath::double3 dir = v / len;
+    fmath::double3 helper = std::abs(dir.y) < 0.9 ? fmath::double3{0, 1, 0} : fmath::double3{1, 0, 0};
+    fmath::double3 side_a = normalize(cross(dir, helper));
+    fmath::double3 side_b = cross(dir, side_a);
+    double head_length = 0.2 * len;
+    fmath::double3 head_base = tip - dir * head_length;
+    double head_radius = 0.4 * head_length;
+    push_segment(env, tip, head_base + side_a * head_radius, c);
+    push_segment(env, tip, head_base - side_a * head_radius, c);
+    push_segment(env, tip, head_base + side_b * head_radius, c);
+    push_segment(env, tip, head_base - side_b * head_radius, c);
+    return true;
+}
+
+bool debug_axes(double3 position, Quaternion orientation, double length)
+{
+    Environment* env = get_debug_draw_environment();
+    if (!env) return false;
+
+    fmath::mat4 pose = pose_to_mat4(position, orientation);
+    fmath::double3 o = pose[3].xyz;
+    push_segment(env, o, o + pose[0].xyz * length, pack_color({1.0f, 0.0f, 0.0f}));
+    push_segment(env, o, o + pose[1].xyz * length, pack_color({0.0f, 1.0f, 0.0f}));
+    push_segment(env, o, o + pose[2].xyz * length, pack_color({0.0f, 0.0f, 1.0f}));
+    return true;
+}
+
+bool debug_sphere_wire(double3 center, double radius, float3 color)
+{
+    Environment* env = get_debug_draw_environment();
+    if (!env) return false;
+
+    fmath::double3 c = d3_to_fd3(center);
+    uint32_t packed = pack_color(color);
+
+    // one circle in each of the xy, yz and zx planes
+    for (int plane = 0; plane < 3; ++plane) {
+        auto point_on_circle = [&](int k) {
+            double t = 2.0 * PI * k / DEBUG_DRAW_CIRCLE_SEGMENTS;
+            fmath::double3 p = {0, 0, 0};
+            p[plane] = radius * cos(t);
+            p[(plane + 1) % 3] = radius * sin(t);
+            return c + p;
+        };
+        for (int k = 0; k < DEBUG_DRAW_CIRCLE_SEGMENTS; ++k) {
+            push_segment(env, point_on_circle(k), point_on_circle(k + 1), packed);
+        }
+    }
+    return true;
+}
+
+bool debug_box_wire(double3 center, double3 half_extents, Quaternion orientation, float3 color)
+{
+    Environment* env = get_debug_draw_environment();
+    if (!env) return false;
+
+    fmath::mat4 pose = pose_to_mat4(center, orientation);
+    fmath::double3 corners[8];
+    for (int i = 0; i < 8; ++i) {
+        fmath::double3 local = {
+            (i & 1) ? half_extents.x : -half_extents.x,
+            (i & 2) ? half_extents.y : -half_extents.y,
+            (i & 4) ? half_extents.z : -half_extents.z
+        };
+        corners[i] = (pose * fmath::double4(local, 1.0)).xyz;
+    }
+
+    // the corners i and i ^ axis_bit are connected by an edge
+    uint32_t packed = pack_color(color);
+    for (int i = 0; i < 8; ++i) {
+        for (int axis_bit = 1; axis_bit < 8; axis_bit <<= 1) {
+            if (!(i & axis_bit)) {
+                push_segment(env, corners[i], corners[i | axis_bit], packed);
+            }
+        }
+    }
+    return true;
+}
+
+static bool grow_debug_draw_buffers(Environment* env, Debug_Draw* dd, uint32_t min_capacity)
+{
+    fmt::VertexBuffer* old_vertex_buffer = dd->vertex_buffer;
+    fmt::IndexBuffer* old_index_buffer = dd->index_buffer;
+    uint32_t old_capacity = dd->capacity;
+
+    uint32_t new_capacity = grow_capacity(dd->capacity, min_capacity);
+    if (!create_debug_draw_buffers(env, dd, new_capacity)) {
+        env_soft_error("Failed to grow the debug draw buffers to %u vertices.", new_capacity);
+        destroy_debug_draw_buffers(env, dd->vertex_buffer, dd->index_buffer);
+        dd->vertex_buffer = old_vertex_buffer;
+        dd->index_buffer = old_index_buffer;
+        dd->capacity = old_capacity;
+        return false;
+    }
+
+    set_renderable_geometry(env->engine, dd->entity, fmt::RenderableManager::PrimitiveType::LINES,
+                            dd->vertex_buffer, dd->index_buffer);
+    destroy_debug_draw_buffers(env, old_vertex_buffer, old_index_buffer);
+    dd->n_uploaded = 0;
+    return true;
+}
+
+// Called once per environment before rendering, the debug geometry only shows up in this render.
+void debug_draw_upload(Environment* env)
+{
+    Debug_Draw* dd = &env->debug_draw;
+    if (!dd->material) return;
+    if (dd->vertices.empty() && dd->n_uploaded == 0) return;
+
+    if (dd->vertices.size() > dd->capacity) {
+        if (dd->vertices.size() > UINT32_MAX / 2 || !grow_debug_draw_buffers(env, dd, uint32_t(dd->vertices.size()))) {
+            // draw what fits
+            dd->vertices.resize(dd->capacity);
+        }
+    }
+
+    uint32_t n_vertices = uint32_t(dd->vertices.size());
+    fmath::float3 aabb_min = {INFINITY, INFINITY, INFINITY};
+    fmath::float3 aabb_max = {-INFINITY, -INFINITY, -INFINITY};
+    if (n_vertices > 0) {
+        for (const Debug_Vertex& vertex : dd->vertices) {
+            aabb_min = min(aabb_min, vertex.position);
+            aabb_max = max(aabb_max, vertex.position);
+        }
+
+        size_t size = n_vertices * sizeof(Debug_Vertex);
+        void* data = malloc(size);
+        if (!data) env_hard_error(ENV_ERR_MEM_ALLOC);
+        std::memcpy(data, dd->vertices.data(), size);
+        dd->vertex_buffer->setBufferAt(*env->engine, 0,
+            fmt::VertexBuffer::BufferDescriptor(data, size, free_buffer_callback));
+    }
+
+    fmt::RenderableManager& rm = env->engine->getRenderableManager();
+    auto ri = rm.getInstance(dd->entity);
+    rm.setGeometryAt(ri, 0, fmt::RenderableManager::PrimitiveType::LINES,
+                     dd->vertex_buffer, dd->index_buffer, 0, n_vertices);
+    if (n_vertices > 0) {
+        rm.setAxisAlignedBoundingBox(ri, fmt::Box().set(aabb_min, aabb_max));
+    }
+    dd->n_uploaded = n_vertices;
+    dd->vertices.clear(); // keeps its capacity for the next frame
+}
+
+void debug_draw_destroy(Environment* env)
+{
+    Debug_Draw* dd = &env->debug_draw;
+    if (!dd->material) return;
+
+    env->scene->remove(dd->entity);
+    env->engine->destroy(dd->entity);
+    utils::EntityManager::get().destroy(dd->entity);
+    destroy_debug_draw_buffers(env, dd->vertex_buffer, dd->index_buffer);
+    env->engine->destroy(dd->material);
+    *dd = Debug_Draw();
+}
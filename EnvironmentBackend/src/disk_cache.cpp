@@ -0,0 +1,115 @@
+#include "../environments.hpp"
+#include <disk_cache.hpp>
+
+#include <logging.hpp>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static bool g_cache_directory_initialized = false;
+static std::string g_cache_directory;
+
+static const std::string& get_cache_directory()
+{
+    if (!g_cache_directory_initialized) {
+        g_cache_directory_initialized = true;
+        if (const char* xdg_cache = getenv("XDG_CACHE_HOME"); xdg_cache && xdg_cache[0]) {
+            g_cache_directory = std::string(xdg_cache) + "/tinydronessim";
+        }
+        else if (const char* home = getenv("HOME"); home && home[0]) {
+            g_cache_directory = std::string(home) + "/.cache/tinydronessim";
+        }
+    }
+    return g_cache_directory;
+}
+
+bool set_cache_directory(const char* path)
+{
+    g_cache_directory_initialized = true;
+    g_cache_directory = path ? path : "";
+    while (g_cache_directory.size() > 1 && g_cache_directory.back() == '/') {
+        g_cache_directory.pop_back();
+    }
+    return true;
+}
+
+// FNV-1a over 8 byte words (folding the high bits down, the multiplication only carries upwards), the tail
+// byte wise. Only used to tell cache entries apart, not for security.
+uint64_t hash_bytes(const void* data, size_t size, uint64_t seed)
+{
+    constexpr uint64_t FNV_PRIME = 0x100000001b3ull;
+    uint64_t hash = 0xcbf29ce484222325ull ^ seed;
+    const uint8_t* bytes = (const uint8_t*)data;
+
+    size_t n_words = size / sizeof(uint64_t);
+    for (size_t i = 0; i < n_words; ++i) {
+        uint64_t word;
+        memcpy(&word, bytes + i * sizeof(uint64_t), sizeof(uint64_t));
+        hash = (hash ^ word) * FNV_PRIME;
+        hash ^= hash >> 32;
+    }
+    for (size_t i = n_words * sizeof(uint64_t); i < size; ++i) {
+        hash = (hash ^ bytes[i]) * FNV_PRIME;
+    }
+    return hash ^ uint64_t(size);
+}
+
+static bool make_directories(const std::string& path)
+{
+    for (size_t i = 1; i <= path.size(); ++i) {
+        if (i < path.size() && path[i] != '/') continue;
+        std::string prefix = path.substr(0, i);
+        if (mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST) {
+            env_warning("Unable to create the cache directory '%s': %s", prefix.c_str(), strerror(errno));
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string disk_cache_path(const char* kind, uint64_t key, const char* extension)
+{
+    const std::string& cache_directory = get_cache_directory();
+    if (cache_directory.empty()) return {};
+
+    std::string directory = cache_directory + "/" + kind;
+    if (!make_directories(directory)) return {};
+
+    char file_name[32];
+    snprintf(file_name, sizeof(file_name), "/%016" PRIx64, key);
+    return directory + file_name + extension;
+}
+
+bool disk_cache_write(const std::string& path, const void* data, size_t size)
+{
+    std::string tmp_path = path + ".tmp" + std::to_string(getpid());
+    int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        env_warning("Unable to write the cache file '%s': %s", tmp_path.c_str(), strerror(errno));
+        return false;
+    }
+
+    const uint8_t* bytes = (const uint8_t*)data;
+    size_t n_written = 0;
+    while (n_written < size) {
+        ssize_t n = write(fd, bytes + n_written, size - n_written);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        n_written += size_t(n);
+    }
+    close(fd);
+
+    if (n_written != size || rename(tmp_path.c_str(), path.c_str()) != 0) {
+        env_warning("Unable to write the cache file '%s': %s", path.c_str(), strerror(errno));
+        unlink(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
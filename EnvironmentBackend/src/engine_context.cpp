@@ -0,0 +1,217 @@
+#include "../environments.hpp"
+#include <engine_context.hpp>
+
+#include <embedded_asset_info.hpp>
+#include <disk_cache.hpp>
+#include <mapped_file.hpp>
+#include <material_provider.hpp>
+#include <primitives.hpp>
+#include <texture_provider.hpp>
+#include <logging.hpp>
+
+#include <filament/Engine.h>
+#include <filament/Material.h>
+#include <filament/Renderer.h>
+#include <filament/SwapChain.h>
+#include <utils/EntityManager.h>
+#include <utils/NameComponentManager.h>
+#include <gltfio/AssetLoader.h>
+#include <gltfio/MaterialProvider.h>
+#include <gltfio/TextureProvider.h>
+#include <backend/Platform.h>
+#include <backend/platforms/PlatformEGLHeadless.h>
+#include <materials/uberarchive.h>
+
+#include <unistd.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace futils = utils;
+
+constexpr filament::backend::Backend ENGINE_BACKEND = fmt::Engine::Backend::OPENGL;
+
+static Engine_Context* g_engine_ctx = nullptr;
+static glTF_Material_Mode g_gltf_material_mode = GLTF_MATERIALS_JIT;
+static Render_Platform g_render_platform = RENDER_PLATFORM_AUTO;
+
+bool set_gltf_material_mode(glTF_Material_Mode mode)
+{
+    if (g_engine_ctx) {
+        env_soft_error("The glTF material mode has to be set before the first environment is created.");
+        return false;
+    }
+    g_gltf_material_mode = mode;
+    return true;
+}
+
+bool set_render_platform(Render_Platform platform)
+{
+    if (g_engine_ctx) {
+        env_soft_error("The render platform has to be set before the first environment is created.");
+        return false;
+    }
+    g_render_platform = platform;
+    return true;
+}
+
+static bool use_headless_platform()
+{
+    switch (g_render_platform) {
+        case RENDER_PLATFORM_WINDOWED: return false;
+        case RENDER_PLATFORM_HEADLESS: return true;
+        default: {
+            const char* display = getenv("DISPLAY");
+            const char* wayland_display = getenv("WAYLAND_DISPLAY");
+            return (!display || !display[0]) && (!wayland_display || !wayland_display[0]);
+        }
+    }
+}
+
+/*
+ * Compiled shader programs, filament asks for them before compiling a material variant, so later runs skip
+ * the driver compile. The key covers the material package (for the jit materials: their glTF configuration)
+ * and the variant. A cache entry starts with the key, hash collisions are told apart by comparing it.
+ * Called from the driver thread.
+ */
+static void insert_program_blob(const void* key, size_t key_size, const void* value, size_t value_size)
+{
+    std::string path = disk_cache_path("programs", hash_bytes(key, key_size), ".bin");
+    if (path.empty()) return;
+
+    uint64_t stored_key_size = key_size;
+    std::vector<uint8_t> entry(sizeof(stored_key_size) + key_size + value_size);
+    memcpy(entry.data(), &stored_key_size, sizeof(stored_key_size));
+    memcpy(entry.data() + sizeof(stored_key_size), key, key_size);
+    memcpy(entry.data() + sizeof(stored_key_size) + key_size, value, value_size);
+    disk_cache_write(path, entry.data(), entry.size());
+}
+
+// Returns the size of the stored program, it is only copied if 'value' is big enough.
+static size_t retrieve_program_blob(const void* key, size_t key_size, void* value, size_t value_size)
+{
+    std::string path = disk_cache_path("programs", hash_bytes(key, key_size), ".bin");
+    if (path.empty() || access(path.c_str(), R_OK) != 0) return 0;
+
+    Mapped_File file;
+    if (!map_file(path.c_str(), &file)) return 0;
+
+    size_t blob_size = 0;
+    uint64_t stored_key_size = 0;
+    size_t header_size = sizeof(stored_key_size) + key_size;
+    if (file.size > header_size) {
+        memcpy(&stored_key_size, file.data, sizeof(stored_key_size));
+        if (stored_key_size == key_size && memcmp(file.data + sizeof(stored_key_size), key, key_size) == 0) {
+            blob_size = file.size - header_size;
+            if (value && value_size >= blob_size) {
+                memcpy(value, file.data + header_size, blob_size);
+            }
+        }
+    }
+    unmap_file(&file);
+    return blob_size;
+}
+
+static fmt::Material* load_material_from_buffer(filament::Engine* engine, const uint8_t* buffer, unsigned int size)
+{
+    fmt::Material* material = fmt::Material::Builder().package(buffer, size).build(*engine);
+    if (!material) {
+        env_soft_error("Failed to load material");
+    }
+    return material;
+}
+
+static Engine_Context* create_engine_context()
+{
+    Engine_Context* ctx = new Engine_Context;
+
+    // the JobSystem also decodes the glTF textures, it gets every core but the one of the main thread
+    uint32_t n_cores = std::thread::hardware_concurrency();
+    fmt::Engine::Config engine_config = {};
+    engine_config.jobSystemThreadCount = n_cores > 1 ? n_cores - 1 : 1;
+    // Without a display GLX can't create a context, EGL headless renders through a pbuffer instead.
+    // The default platform (GLX) is kept for windowed use, SDL windows need its X11/Wayland surfaces.
+    fmt::Engine::Builder engine_builder;
+    engine_builder.backend(ENGINE_BACKEND).config(&engine_config);
+    ctx->headless = use_headless_platform();
+    if (ctx->headless) {
+        ctx->platform = new fmt::backend::PlatformEGLHeadless();
+        engine_builder.platform(ctx->platform);
+    }
+    ctx->engine = engine_builder.build();
+    if (!ctx->engine) {
+        env_soft_error("Failed to create the filament engine.");
+        delete ctx->platform;
+        delete ctx;
+        return nullptr;
+    }
+    ctx->engine->getPlatform()->setBlobFunc(insert_program_blob, retrieve_program_blob);
+    ctx->renderer = ctx->engine->createRenderer();
+    // Offscreen frames render into their own RenderTarget, this swap chain is never presented.
+    ctx->headless_swap_chain = ctx->engine->createSwapChain(1, 1);
+
+    ctx->base_lit_material = load_material_from_buffer(ctx->engine, __assets_sandboxLit_filamat, __assets_sandboxLit_filamat_len);
+    ctx->base_unlit_material = load_material_from_buffer(ctx->engine, __assets_sandboxUnlit_filamat, __assets_sandboxUnlit_filamat_len);
+    ctx->vertex_color_material = load_material_from_buffer(ctx->engine, __assets_vertexColorUnlit_filamat, __assets_vertexColorUnlit_filamat_len);
+    if (!ctx->base_lit_material || !ctx->base_unlit_material || !ctx->vertex_color_material) {
+        delete ctx;
+        return nullptr;
+    }
+
+    if (g_gltf_material_mode == GLTF_MATERIALS_UBERSHADER) {
+        ctx->gltf.material_provider = fgltfio::createUbershaderProvider(ctx->engine, UBERARCHIVE_DEFAULT_DATA, UBERARCHIVE_DEFAULT_SIZE);
+    }
+    else {
+        ctx->gltf.material_provider = create_cached_material_provider(ctx->engine);
+    }
+    ctx->gltf.texture_provider = create_parallel_texture_provider(ctx->engine);
+    ctx->gltf.ktx2_texture_provider = fgltfio::createKtx2Provider(ctx->engine);
+
+    ctx->gltf.names = new futils::NameComponentManager(futils::EntityManager::get());
+
+    fgltfio::AssetConfiguration asset_loader_config{
+        .engine = ctx->engine,
+        .materials = ctx->gltf.material_provider,
+        .entities = &futils::EntityManager::get(),
+        .names = ctx->gltf.names,
+    };
+
+    ctx->gltf.asset_loader = fgltfio::AssetLoader::create(asset_loader_config);
+    return ctx;
+}
+
+Engine_Context* get_engine_context()
+{
+    if (!g_engine_ctx) {
+        g_engine_ctx = create_engine_context();
+    }
+    return g_engine_ctx;
+}
+
+Engine_Context::~Engine_Context()
+{
+    if (gltf.asset_loader) {
+        fgltfio::AssetLoader::destroy(&gltf.asset_loader);
+    }
+    if (gltf.material_provider) {
+        gltf.material_provider->destroyMaterials();
+        delete gltf.material_provider;
+    }
+    delete gltf.texture_provider;
+    delete gltf.ktx2_texture_provider;
+    delete gltf.names;
+
+    primitive_geometries_destroy(this);
+
+    if (base_lit_material) engine->destroy(base_lit_material);
+    if (base_unlit_material) engine->destroy(base_unlit_material);
+    if (vertex_color_material) engine->destroy(vertex_color_material);
+    if (headless_swap_chain) engine->destroy(headless_swap_chain);
+    if (renderer) engine->destroy(renderer);
+
+    // FIXME: WE SHOULD DESTROY THE ENGINE, BUT FILAMENT CRASHES HERE SOMETIMES
+    // fmt::Engine::destroy(&engine);
+    // delete platform; // only after the engine is destroyed
+}
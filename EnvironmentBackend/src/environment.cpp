@@ -2,15 +2,20 @@
 #include "filament_object_wrappers.hpp"
 #include <environment.hpp>
 
-#include <embedded_asset_info.hpp>
+#include <engine_context.hpp>
 #include <camera.hpp>
 #include <math.hpp>
 #include <logging.hpp>
+#include <mapped_file.hpp>
+#include <ibl.hpp>
+#include <texture_provider.hpp>
 #include <object_manager.hpp>
 
+#include <filament/Box.h>
 #include <filament/Engine.h>
 #include <filament/Scene.h>
 #include <filament/Material.h>
+#include <filament/MaterialInstance.h>
 #include <filament/IndirectLight.h>
 #include <filament/Skybox.h>
 #include <filament/TransformManager.h>
@@ -29,76 +34,27 @@
 
 #include <stb_image.h>
 
+#include <algorithm>
 #include <cstdint>
-#include <fcntl.h>
-#include <unistd.h>
 #include <cstring>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <sys/stat.h>
 
 namespace futils = utils;
 namespace fmath = filament::math;
 
-constexpr filament::backend::Backend ENGINE_BACKEND = fmt::Engine::Backend::OPENGL;
-
-static bool read_entire_file(const char* path, uint8_t** data, size_t* size)
-{
-    int fd = open(path, O_RDONLY);
-    
-    if (fd >= 0) {
-        *size = lseek(fd, 0, SEEK_END);
-        lseek(fd, 0, SEEK_SET);
-
-        *data = new uint8_t[*size];
-        read(fd, *data, *size);
-        
-        if (!*data) {
-            env_hard_error(ENV_ERR_MEM_ALLOC);
-        }
-        close(fd);
-        return true;
-    }
-    else {
-        env_soft_error("Unable to open file '%s'", path);
-        return false;
-    }
-}
-
-static fmt::Material* load_material_from_buffer(filament::Engine* engine, const uint8_t* buffer, unsigned int size)
-{
-    fmt::Material* material = fmt::Material::Builder().package(buffer, size).build(*engine);
-    if (!material) {
-        env_soft_error("Failed to load material");
-    }
-    return material;
-}
-
 Environment_ID create_environment()
 {
-    Environment* env = new Environment;
+    Engine_Context* ctx = get_engine_context();
+    if (!ctx) return {ENV_INVALID_UUID};
 
-    env->engine = fmt::Engine::create(ENGINE_BACKEND);
+    Environment* env = new Environment;
+    env->ctx = ctx;
+    env->engine = ctx->engine;
     env->scene = env->engine->createScene();
-    
-    env->base_lit_material = load_material_from_buffer(env->engine, __assets_sandboxLit_filamat, __assets_sandboxLit_filamat_len);
-    if (!env->base_lit_material) {
-        return {ENV_INVALID_UUID};
-    }
-
-    env->base_unlit_material = load_material_from_buffer(env->engine, __assets_sandboxUnlit_filamat, __assets_sandboxUnlit_filamat_len);
-    if (!env->base_unlit_material) {
-        return {ENV_INVALID_UUID};
-    }
 
-    env->gltf.material_provider = fgltfio::createJitShaderProvider(env->engine);
-    env->gltf.texture_provider = fgltfio::createStbProvider(env->engine);
-
-    fgltfio::AssetConfiguration asset_loader_config{
-        .engine = env->engine,
-        .materials = env->gltf.material_provider,
-        .entities = &futils::EntityManager::get(),
-    };
-        
-    env->gltf.asset_loader = fgltfio::AssetLoader::create(asset_loader_config);
-    
     Environment_ID env_id = g_objm.add_object(env);
     g_objm.environment_activate(env_id);
     
@@ -106,40 +62,95 @@ Environment_ID create_environment()
     return env_id;
 }
 
+bool environment_set_culling_stats(Environment_ID env_id, bool enabled)
+{
+    Environment* env = g_objm.get_object(env_id);
+    if (!env) return false;
+
+    env->culling_stats_enabled = enabled;
+    return true;
+}
+
+static void gltf_async_load_destroy(glTF_Async_Load* load, bool cancel)
+{
+    if (cancel) {
+        load->resource_loader->asyncCancelLoad();
+    }
+    delete load->resource_loader; // uses the texture providers until it is gone
+    delete load->texture_provider;
+    delete load->ktx2_texture_provider;
+}
+
 Environment::~Environment()
 {
     // destroy gltf stuff
+    for (glTF_Async_Load& load : gltf.async_loads) {
+        gltf_async_load_destroy(&load, true);
+    }
+    gltf.async_loads.clear();
+    for (auto& [instance, animated] : animated_instances) {
+        delete animated;
+    }
+    animated_instances.clear();
     for (fgltfio::FilamentAsset* asset : gltf.assets) {
         scene->removeEntities(asset->getEntities(), asset->getEntityCount());
-        gltf.asset_loader->destroyAsset(asset);
+        ctx->gltf.asset_loader->destroyAsset(asset);
+    }
+    gltf.assets.clear();
+    gltf.n_references.clear();
+    gltf.cache.clear();
+
+    for (auto& [entity_id, mesh] : meshes) {
+        delete mesh;
+    }
+    meshes.clear();
+
+    for (auto& [entity_id, polyline] : polylines) {
+        polyline_destroy(this, polyline);
+    }
+    polylines.clear();
+
+    for (auto& [entity_id, swarm] : swarms) {
+        swarm_destroy(this, swarm);
+    }
+    swarms.clear();
+
+    for (auto& [entity_id, point_cloud] : point_clouds) {
+        point_cloud_destroy(this, point_cloud);
+    }
+    point_clouds.clear();
+
+    for (auto& [entity_id, primitive] : primitives) {
+        primitive_destroy(this, primitive);
     }
+    primitives.clear();
 
+    debug_draw_destroy(this);
+
+    // The materials are shared with other environments, but the instances are ours.
+    // They go after the renderables, which are using them.
+    size_t n_material_instances = material_registry.numRegistered();
+    std::vector<fmt::MaterialInstance*> material_instances(n_material_instances);
+    material_registry.getRegisteredMaterials(material_instances.data());
     material_registry.unregisterAll();
-        
-    gltf.material_provider->destroyMaterials();
-    delete gltf.material_provider;
-    delete gltf.texture_provider;
-    fgltfio::AssetLoader::destroy(&gltf.asset_loader);
+    for (fmt::MaterialInstance* mat_i : material_instances) {
+        engine->destroy(mat_i);
+    }
+
+    segmentation_destroy(this);
 
     // destroy handles
     engine->destroy(scene);
-
-    // FIXME: WE SHOULD DESTROY THE ENGINE, BUT FILAMENT CRASHES HERE SOMETIMES
-    // fmt::Engine::destroy(&engine);
 }
 
-bool add_ibl_skybox(const char* file_path_cstr)
+// Decodes the equirectangular image and prefilters it on the gpu.
+static bool prefilter_ibl(Environment* env, const Mapped_File& file, const char* file_path_cstr, const IBL_Prefilter_Settings& settings, IBL* ibl)
 {
-    Environment* env = g_objm.get_active_environment();
-    if (!env) return false;
-    
-    futils::Path path{file_path_cstr};
-
-    int width, height, n_channels;
-    stbi_info(path.getAbsolutePath().c_str(), &width, &height, nullptr);
+    int width = 0, height = 0, n_channels = 0;
+    stbi_info_from_memory(file.data, int(file.size), &width, &height, nullptr);
     // load image as float
     size_t size = width * height * sizeof(fmath::float3);
-    fmath::float3* data = (fmath::float3*)stbi_loadf(path.getAbsolutePath().c_str(), &width, &height, &n_channels, 3);
+    fmath::float3* data = (fmath::float3*)stbi_loadf_from_memory(file.data, int(file.size), &width, &height, &n_channels, 3);
     fmt::Texture::PixelBufferDescriptor::Callback destroy_callback = [](void* data, size_t, void*) {
         stbi_image_free(data);
     };
@@ -170,21 +181,56 @@ bool add_ibl_skybox(const char* file_path_cstr)
 
     equirect->setImage(*env->engine, 0, std::move(buffer));
 
+    // the irradiance comes from spherical harmonics, computed from the reflections on the way into the cache
     IBLPrefilterContext context(*env->engine);
     IBLPrefilterContext::EquirectangularToCubemap equirectangularToCubemap(context);
-    IBLPrefilterContext::SpecularFilter specularFilter(context);
-    IBLPrefilterContext::IrradianceFilter irradianceFilter(context);
+    IBLPrefilterContext::SpecularFilter::Config specular_config;
+    specular_config.sampleCount = uint16_t(settings.sample_count);
+    specular_config.levelCount = uint8_t(settings.reflections_levels);
+    IBLPrefilterContext::SpecularFilter specularFilter(context, specular_config);
+    IBLPrefilterContext::SpecularFilter::Options specular_options;
+    specular_options.hdrLinear = settings.hdr_linear;
+    specular_options.hdrMax = settings.hdr_max;
+    specular_options.lodOffset = settings.lod_offset;
+
+    ibl->skybox = equirectangularToCubemap(equirect);
+    ibl->reflections = specularFilter(specular_options, ibl->skybox);
+    env->engine->destroy(equirect);
+    return true;
+}
 
-    fmt::Texture* skybox_texture = equirectangularToCubemap(equirect);
-    fmt::Texture* texture = specularFilter(skybox_texture);
+bool add_ibl_skybox(const char* file_path_cstr)
+{
+    Environment* env = g_objm.get_active_environment();
+    if (!env) return false;
     
-    fmt::IndirectLight* indirect_light = fmt::IndirectLight::Builder()
-        .reflections(texture)
-        .intensity(20000.0f)
-        .build(*env->engine);
+    futils::Path path{file_path_cstr};
+    Mapped_File file;
+    if (!map_file(path.getAbsolutePath().c_str(), &file)) return false;
+
+    IBL ibl;
+    IBL_Prefilter_Settings settings;
+    uint64_t cache_key = ibl_cache_key(file.data, file.size, settings);
+    if (!ibl_cache_load(env->ctx, cache_key, &ibl)) {
+        if (!prefilter_ibl(env, file, file_path_cstr, settings, &ibl)) {
+            unmap_file(&file);
+            return false;
+        }
+        ibl_read_back_and_store(env->ctx, cache_key, &ibl);
+    }
+    unmap_file(&file);
+
+    fmt::IndirectLight::Builder indirect_light_builder;
+    indirect_light_builder
+        .reflections(ibl.reflections)
+        .intensity(20000.0f);
+    if (ibl.has_irradiance) {
+        indirect_light_builder.irradiance(3, ibl.irradiance_sh);
+    }
+    fmt::IndirectLight* indirect_light = indirect_light_builder.build(*env->engine);
 
     fmt::Skybox* skybox = fmt::Skybox::Builder()
-            .environment(skybox_texture)
+            .environment(ibl.skybox)
             .showSun(true)
             .build(*env->engine);
 
@@ -199,19 +245,34 @@ Filament_Entity_ID add_filamesh_from_file(const char* path)
     Environment* env = g_objm.get_active_environment();
     if (!env) return {ENV_INVALID_UUID};
     
-    fmesh::MeshReader::Mesh mesh = filamesh::MeshReader::loadMeshFromFile(env->engine, futils::Path(path), env->material_registry);
+    // The buffers are uploaded straight out of the mapping, it is released by the buffer callback after the upload.
+    Mapped_File* file = new Mapped_File;
+    if (!map_file(path, file)) {
+        delete file;
+        return {ENV_INVALID_UUID};
+    }
+    // the mesh reader drops invalid files without calling the callback
+    if (file->size < 8 || memcmp(file->data, "FILAMESH", 8) != 0) {
+        env_soft_error("Not a filamesh file: %s", path);
+        unmap_file_callback(nullptr, 0, file);
+        return {ENV_INVALID_UUID};
+    }
+    fmesh::MeshReader::Mesh mesh = filamesh::MeshReader::loadMeshFromBuffer(env->engine, file->data, unmap_file_callback, file, env->material_registry);
 
     env->scene->addEntity(mesh.renderable);
 
     // add transform component to the mesh (make it transformable)
     env->engine->getTransformManager().create(mesh.renderable);
+    env->meshes[mesh.renderable.getId()] = new Mesh(mesh, env);
 
-    return g_objm.add_object({mesh.renderable, env});
+    Filament_Entity_ID fentity_id = g_objm.add_object({mesh.renderable, env});
+    segmentation_register(env, &mesh.renderable, 1, fentity_id, {ENV_INVALID_UUID});
+    return fentity_id;
 }
 
 static fmt::MaterialInstance* create_material_instance(Environment* env, float3 base_color, float roughness, float metallic, float reflectance, float sheen_color, float clear_coat, float clear_coat_roughness)
 {
-    fmt::MaterialInstance* mat_i = env->base_lit_material->createInstance();
+    fmt::MaterialInstance* mat_i = env->ctx->base_lit_material->createInstance();
     mat_i->setParameter("baseColor", fmt::RgbType::sRGB, f3_to_ff3(base_color));
     mat_i->setParameter("roughness", roughness);
     mat_i->setParameter("metallic", metallic);
@@ -224,7 +285,7 @@ static fmt::MaterialInstance* create_material_instance(Environment* env, float3
 
 static fmt::MaterialInstance* create_material_instance(Environment* env, float3 base_color, float4 emmisive)
 {
-    fmt::MaterialInstance* mat_i = env->base_unlit_material->createInstance();
+    fmt::MaterialInstance* mat_i = env->ctx->base_unlit_material->createInstance();
     mat_i->setParameter("baseColor", fmt::RgbType::sRGB, fmath::float3{base_color.x, base_color.y, base_color.z});
     mat_i->setParameter("emissive", f4_to_ff4(emmisive));
     return mat_i;
@@ -250,113 +311,258 @@ bool add_unlit_material(const char* material_name, float3 base_color, float4 emm
     return true;
 }
 
-glTF_Instance_ID add_gltf_asset_and_create_instance(const char* filepath)
+static void release_gltf_asset(Environment* env, fgltfio::FilamentAsset* asset)
 {
-    Environment* env = g_objm.get_active_environment();
-    if (!env) return {ENV_INVALID_UUID};
+    auto itr = env->gltf.n_references.find(asset);
+    if (itr == env->gltf.n_references.end() || --itr.value() > 0) return;
+
+    env->gltf.n_references.erase(itr);
+    auto load = std::find_if(env->gltf.async_loads.begin(), env->gltf.async_loads.end(),
+                             [asset](const glTF_Async_Load& l) { return l.asset == asset; });
+    if (load != env->gltf.async_loads.end()) {
+        gltf_async_load_destroy(&*load, true);
+        env->gltf.async_loads.erase(load);
+    }
+    env->gltf.assets.erase(std::find(env->gltf.assets.begin(), env->gltf.assets.end(), asset));
+    env->scene->removeEntities(asset->getEntities(), asset->getEntityCount());
+    env->ctx->gltf.asset_loader->destroyAsset(asset);
+}
+
+static fgltfio::FilamentAsset* load_gltf_asset(Environment* env, const char* filepath, bool async)
+{
+    // createAsset keeps its own copy of the source data, so the mapping only lives for the parse
+    Mapped_File file;
+    if (!map_file(filepath, &file)) return nullptr;
+    fgltfio::FilamentAsset* asset = env->ctx->gltf.asset_loader->createAsset(file.data, uint32_t(file.size));
+    unmap_file(&file);
+    if (!asset) {
+        env_soft_error("Could not parse glTF file: %s", filepath);
+        return nullptr;
+    }
 
-    uint8_t* data = nullptr;
-    size_t size = 0;
-    fgltfio::FilamentAsset* asset = nullptr;
-    if (read_entire_file(filepath, &data, &size)) {
-        asset = env->gltf.asset_loader->createAsset(data, size);
-        delete[] data;
+    if (async) {
+        // the buffers are uploaded right away, only the textures are decoded in the background
+        glTF_Async_Load load;
+        load.asset = asset;
+        load.texture_provider = create_parallel_texture_provider(env->engine);
+        load.ktx2_texture_provider = fgltfio::createKtx2Provider(env->engine);
+        load.resource_loader = new fgltfio::ResourceLoader({env->engine, filepath, true});
+        load.resource_loader->addTextureProvider("image/png", load.texture_provider);
+        load.resource_loader->addTextureProvider("image/jpeg", load.texture_provider);
+        load.resource_loader->addTextureProvider("image/ktx2", load.ktx2_texture_provider);
+        if (!load.resource_loader->asyncBeginLoad(asset)) {
+            env_soft_error("Could not load the resources of the glTF file: %s", filepath);
+            gltf_async_load_destroy(&load, false);
+            env->ctx->gltf.asset_loader->destroyAsset(asset);
+            return nullptr;
+        }
+        env->gltf.async_loads.push_back(load);
     }
     else {
-        return {ENV_INVALID_UUID};
+        fgltfio::ResourceLoader resource_loader({env->engine, filepath, true});
+        resource_loader.addTextureProvider("image/png", env->ctx->gltf.texture_provider);
+        resource_loader.addTextureProvider("image/jpeg", env->ctx->gltf.texture_provider);
+        resource_loader.addTextureProvider("image/ktx2", env->ctx->gltf.ktx2_texture_provider);
+        resource_loader.loadResources(asset);
     }
 
-    fgltfio::ResourceLoader resource_loader({env->engine, filepath, true});
-    resource_loader.addTextureProvider("image/png", env->gltf.texture_provider);
-    resource_loader.addTextureProvider("image/jpeg", env->gltf.texture_provider);
-    resource_loader.loadResources(asset);
-    
-    env->gltf.assets.push_back(asset);
-
     // Never remove cpu side data, because we always want to be able to create new instances
     // asset->releaseSourceData();
 
-    fgltfio::FilamentInstance* instance = asset->getInstance();
+    env->gltf.assets.push_back(asset);
+    return asset;
+}
+
+static glTF_Instance_ID add_gltf_instance(Environment* env, fgltfio::FilamentInstance* instance)
+{
     env->scene->addEntities(instance->getEntities(), instance->getEntityCount());
-    
-    return g_objm.add_object({instance, env});
+    env->gltf.n_references[(fgltfio::FilamentAsset*)instance->getAsset()]++;
+
+    glTF_Instance_ID instance_id = g_objm.add_object({instance, env});
+    segmentation_register(env, instance->getEntities(), instance->getEntityCount(), {ENV_INVALID_UUID}, instance_id);
+    return instance_id;
 }
 
-glTF_Instance_ID create_gltf_instance_sibling(glTF_Instance_ID gltf_instance_id)
+static glTF_Instance_ID add_gltf_asset_and_create_instance(Environment* env, const char* filepath, bool async)
 {
-    glTF_Instance instance = g_objm.get_object(gltf_instance_id);
-    if (!instance.is_valid()) return {ENV_INVALID_UUID};
-    
-    // we are violating constness here, but I don't think this is an issue.
-    fgltfio::FilamentInstance* sibling_instance = instance.associated_env->gltf.asset_loader->createInstance(
-        (fgltfio::FilamentAsset*)instance.gltf_instance->getAsset());
-    instance.associated_env->scene->addEntities(sibling_instance->getEntities(), sibling_instance->getEntityCount());
-    return g_objm.add_object({sibling_instance, instance.associated_env});
+
+    char canonical_path[PATH_MAX];
+    struct stat st;
+    if (!realpath(filepath, canonical_path) || stat(canonical_path, &st) != 0) {
+        env_soft_error("Unable to open file '%s': %s", filepath, strerror(errno));
+        return {ENV_INVALID_UUID};
+    }
+    int64_t mtime_ns = int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+
+    // a repeated load only creates a new instance, unless the file was changed in the meantime
+    if (auto itr = env->gltf.cache.find(canonical_path); itr != env->gltf.cache.end()) {
+        glTF_Cache_Entry entry = itr->second;
+        if (entry.mtime_ns == mtime_ns && entry.size == uint64_t(st.st_size)) {
+            return add_gltf_instance(env, env->ctx->gltf.asset_loader->createInstance(entry.asset));
+        }
+        env->gltf.cache.erase(itr);
+        release_gltf_asset(env, entry.asset);
+    }
+
+    fgltfio::FilamentAsset* asset = load_gltf_asset(env, canonical_path, async);
+    if (!asset) return {ENV_INVALID_UUID};
+
+    env->gltf.cache[canonical_path] = {asset, mtime_ns, uint64_t(st.st_size)};
+    env->gltf.n_references[asset] = 1;
+    return add_gltf_instance(env, asset->getInstance());
 }
 
-/* DONT FORGET: LEAKING MEMORY (just temporary) */
-Filament_Entity_ID add_plane(double3 center, double length_x, double length_z, const char* material_name, Quaternion rotation)
+glTF_Instance_ID add_gltf_asset_and_create_instance(const char* filepath)
 {
     Environment* env = g_objm.get_active_environment();
     if (!env) return {ENV_INVALID_UUID};
 
-    uint32_t* indices = new uint32_t[6]{ 0, 1, 2, 2, 3, 0 };
+    return add_gltf_asset_and_create_instance(env, filepath, false);
+}
 
-    filament::math::float3* vertices = new filament::math::float3[4]{
-        d3_to_fd3(quaternion_rotate_vector({ -length_x / 2.0, 0, -length_z / 2.0 }, rotation)) + d3_to_fd3(center),
-        d3_to_fd3(quaternion_rotate_vector({ -length_x / 2.0, 0,  length_z / 2.0 }, rotation)) + d3_to_fd3(center),
-        d3_to_fd3(quaternion_rotate_vector({  length_x / 2.0, 0,  length_z / 2.0 }, rotation)) + d3_to_fd3(center),
-        d3_to_fd3(quaternion_rotate_vector({  length_x / 2.0, 0, -length_z / 2.0 }, rotation)) + d3_to_fd3(center)
-    };
+glTF_Instance_ID add_gltf_asset_and_create_instance_async(const char* filepath)
+{
+    Environment* env = g_objm.get_active_environment();
+    if (!env) return {ENV_INVALID_UUID};
 
-    fmath::short4 tbn = fmath::packSnorm16(
-        fmath::mat3f::packTangentFrame(
-            fmath::mat3f{d3_to_fd3(quaternion_rotate_vector({ 1.0f, 0.0f, 0.0f }, rotation)),
-                         d3_to_fd3(quaternion_rotate_vector({ 0.0f, 0.0f, 1.0f }, rotation)),
-                         d3_to_fd3(quaternion_rotate_vector({ 0.0f, 1.0f, 0.0f }, rotation))}
-            ).xyzw);
+    return add_gltf_asset_and_create_instance(env, filepath, true);
+}
 
-    fmath::short4* normals = new fmath::short4[4]{ tbn, tbn, tbn, tbn };
+float gltf_load_progress(glTF_Instance_ID gltf_instance_id)
+{
+    glTF_Instance instance = g_objm.get_object(gltf_instance_id);
+    if (!instance.is_valid()) return -1.0f;
 
-    fmt::VertexBuffer* vertex_buffer = fmt::VertexBuffer::Builder()
-        .vertexCount(4)
-        .bufferCount(2)
-        .attribute(fmt::VertexAttribute::POSITION, 0, fmt::VertexBuffer::AttributeType::FLOAT3)
-        .attribute(fmt::VertexAttribute::TANGENTS, 1, fmt::VertexBuffer::AttributeType::SHORT4)
-        .normalized(fmt::VertexAttribute::TANGENTS)
-        .build(*env->engine);
+    const fgltfio::FilamentAsset* asset = instance.gltf_instance->getAsset();
+    for (const glTF_Async_Load& load : instance.associated_env->gltf.async_loads) {
+        if (load.asset == asset) return load.resource_loader->asyncGetLoadProgress();
+    }
+    return 1.0f;
+}
 
-    vertex_buffer->setBufferAt(*env->engine, 0, fmt::VertexBuffer::BufferDescriptor(
-                                  vertices, vertex_buffer->getVertexCount() * sizeof(vertices[0])));
-    vertex_buffer->setBufferAt(*env->engine, 1, fmt::VertexBuffer::BufferDescriptor(
-                                  normals, vertex_buffer->getVertexCount() * sizeof(normals[0])));
+// Binds the textures decoded since the last frame, finished loads are dropped.
+void gltf_update_async_loads(Environment* env)
+{
+    std::vector<glTF_Async_Load>& loads = env->gltf.async_loads;
+    for (size_t i = 0; i < loads.size();) {
+        loads[i].resource_loader->asyncUpdateLoad();
+        if (loads[i].resource_loader->asyncGetLoadProgress() < 1.0f) {
+            i++;
+            continue;
+        }
+        gltf_async_load_destroy(&loads[i], false);
+        loads.erase(loads.begin() + i);
+    }
+}
 
-    fmt::IndexBuffer* index_buffer = fmt::IndexBuffer::Builder()
-        .indexCount(6)
-        .build(*env->engine);
+bool evict_gltf_asset(const char* filepath)
+{
+    Environment* env = g_objm.get_active_environment();
+    if (!env) return false;
 
-    index_buffer->setBuffer(*env->engine, fmt::IndexBuffer::BufferDescriptor(
-                               indices, index_buffer->getIndexCount() * sizeof(uint32_t)));
+    char canonical_path[PATH_MAX];
+    if (!realpath(filepath, canonical_path)) {
+        env_soft_error("Unable to resolve the path '%s': %s", filepath, strerror(errno));
+        return false;
+    }
 
-    futils::Entity plane_renderable = utils::EntityManager::get().create();
-    fmt::RenderableManager::Builder(1)
-        .boundingBox({{0, 0, 0},
-                      { length_x / 2.0, 1e-4f, length_z / 2.0 }}) // this is bullshit, but still working (this code is depricated anyway)
-        // .material(0, create_material_instance(env, material_settings))
-        .material(0, env->material_registry.getMaterialInstance(futils::CString(material_name)))
-        .geometry(0, fmt::RenderableManager::PrimitiveType::TRIANGLES,
-                  vertex_buffer, index_buffer, 0, 6)
-        .culling(false)
-        .receiveShadows(true)
-        .castShadows(false)
-        .build(*env->engine, plane_renderable);
+    auto itr = env->gltf.cache.find(canonical_path);
+    if (itr == env->gltf.cache.end()) {
+        env_soft_error("There is no cached asset for '%s'.", filepath);
+        return false;
+    }
+
+    fgltfio::FilamentAsset* asset = itr->second.asset;
+    env->gltf.cache.erase(itr);
+    release_gltf_asset(env, asset);
+    return true;
+}
+
+bool clear_gltf_asset_cache()
+{
+    Environment* env = g_objm.get_active_environment();
+    if (!env) return false;
 
-    env->scene->addEntity(plane_renderable);
+    std::vector<fgltfio::FilamentAsset*> cached_assets;
+    for (const auto& [path, entry] : env->gltf.cache) {
+        cached_assets.push_back(entry.asset);
+    }
+    env->gltf.cache.clear();
+    for (fgltfio::FilamentAsset* asset : cached_assets) {
+        release_gltf_asset(env, asset);
+    }
+    return true;
+}
+
+glTF_Instance_ID create_gltf_instance_sibling(glTF_Instance_ID gltf_instance_id)
+{
+    glTF_Instance instance = g_objm.get_object(gltf_instance_id);
+    if (!instance.is_valid()) return {ENV_INVALID_UUID};
     
-    return g_objm.add_object({plane_renderable, env});
+    // we are violating constness here, but I don't think this is an issue.
+    fgltfio::FilamentInstance* sibling_instance = instance.associated_env->ctx->gltf.asset_loader->createInstance(
+        (fgltfio::FilamentAsset*)instance.gltf_instance->getAsset());
+    return add_gltf_instance(instance.associated_env, sibling_instance);
+}
+
+// Destroys an entity made by one of the add_* functions, together with everything only it was using.
+// Returns false for entities, which are part of something else (cameras, roots of glTF instances).
+bool environment_destroy_entity(Environment* env, utils::Entity entity, Filament_Entity_ID filament_entity_id)
+{
+    uint32_t key = entity.getId();
+    if (auto itr = env->meshes.find(key); itr != env->meshes.end()) {
+        segmentation_unregister(env, filament_entity_id, {ENV_INVALID_UUID});
+        delete itr->second;
+        env->meshes.erase(itr);
+        return true;
+    }
+    if (auto itr = env->primitives.find(key); itr != env->primitives.end()) {
+        segmentation_unregister(env, filament_entity_id, {ENV_INVALID_UUID});
+        primitive_destroy(env, itr->second);
+        env->primitives.erase(itr);
+        return true;
+    }
+    if (auto itr = env->polylines.find(key); itr != env->polylines.end()) {
+        segmentation_unregister(env, filament_entity_id, {ENV_INVALID_UUID});
+        polyline_destroy(env, itr->second);
+        env->polylines.erase(itr);
+        return true;
+    }
+    if (auto itr = env->point_clouds.find(key); itr != env->point_clouds.end()) {
+        segmentation_unregister(env, filament_entity_id, {ENV_INVALID_UUID});
+        point_cloud_destroy(env, itr->second);
+        env->point_clouds.erase(itr);
+        return true;
+    }
+    if (auto itr = env->swarms.find(key); itr != env->swarms.end()) {
+        segmentation_unregister(env, filament_entity_id, {ENV_INVALID_UUID});
+        swarm_destroy(env, itr->second);
+        env->swarms.erase(itr);
+        return true;
+    }
+
+    env_soft_error("The Filament-Entity with id %#llx can't be destroyed on its own, destroy the camera or glTF instance it belongs to.",
+                   (unsigned long long)filament_entity_id.id);
+    return false;
+}
+
+void environment_destroy_gltf_instance(Environment* env, fgltfio::FilamentInstance* instance, glTF_Instance_ID gltf_instance_id)
+{
+    segmentation_unregister(env, {ENV_INVALID_UUID}, gltf_instance_id);
+    animations_forget_instance(env, instance);
+    env->scene->removeEntities(instance->getEntities(), instance->getEntityCount());
+
+    // The instance itself stays allocated until its asset is destroyed.
+    release_gltf_asset(env, (fgltfio::FilamentAsset*)instance->getAsset());
+}
+
+// Same as a PRIMITIVE_PLANE, kept for the existing scenes.
+Filament_Entity_ID add_plane(double3 center, double length_x, double length_z, const char* material_name, Quaternion rotation)
+{
+    return add_primitive(PRIMITIVE_PLANE, center, {length_x, 0.0, length_z}, material_name, rotation);
 }
 
-/* DONT FORGET: LEAKING MEMORY (just temporary) */
+// For many connected segments use 'add_polyline', it is a single entity.
 Filament_Entity_ID add_line(double3 begin, double3 end, const char* material_name)
 {
     Environment* env = g_objm.get_active_environment();
@@ -367,6 +573,8 @@ Filament_Entity_ID add_line(double3 begin, double3 end, const char* material_nam
     filament::math::float3* vertices = new filament::math::float3[2] {
         d3_to_fd3(begin), d3_to_fd3(end)
     };
+    // the vertices belong to filament after the upload
+    fmt::Box bounds = fmt::Box().set(min(vertices[0], vertices[1]), max(vertices[0], vertices[1]));
 
     fmt::VertexBuffer* vertex_buffer = fmt::VertexBuffer::Builder()
         .vertexCount(2)
@@ -375,29 +583,32 @@ Filament_Entity_ID add_line(double3 begin, double3 end, const char* material_nam
         .build(*env->engine);
 
     vertex_buffer->setBufferAt(*env->engine, 0, fmt::VertexBuffer::BufferDescriptor(
-                                   vertices, vertex_buffer->getVertexCount() * sizeof(vertices[0])));
+                                   vertices, vertex_buffer->getVertexCount() * sizeof(vertices[0]),
+                                   [](void* buffer, size_t, void*) { delete[] (filament::math::float3*)buffer; }));
 
     fmt::IndexBuffer* index_buffer = fmt::IndexBuffer::Builder()
         .indexCount(2)
         .build(*env->engine);
 
     index_buffer->setBuffer(*env->engine, fmt::IndexBuffer::BufferDescriptor(
-                                indices, index_buffer->getIndexCount() * sizeof(uint32_t)));
+                                indices, index_buffer->getIndexCount() * sizeof(uint32_t),
+                                [](void* buffer, size_t, void*) { delete[] (uint32_t*)buffer; }));
 
     
     futils::Entity line_renderable = utils::EntityManager::get().create();
     fmt::RenderableManager::Builder(1)
-        .boundingBox({d3_to_fd3(begin),
-                      d3_to_fd3(end)})
+        .boundingBox(bounds)
         .material(0, env->material_registry.getMaterialInstance(futils::CString(material_name)))
         .geometry(0, fmt::RenderableManager::PrimitiveType::LINES,
                   vertex_buffer, index_buffer, 0, 2)
-        .culling(false)
         .receiveShadows(false)
         .castShadows(false)
         .build(*env->engine, line_renderable);
 
     env->scene->addEntity(line_renderable);
+    env->meshes[line_renderable.getId()] = new Mesh(line_renderable, vertex_buffer, index_buffer, env);
     
-    return g_objm.add_object({line_renderable, env});
+    Filament_Entity_ID fentity_id = g_objm.add_object({line_renderable, env});
+    segmentation_register(env, &line_renderable, 1, fentity_id, {ENV_INVALID_UUID});
+    return fentity_id;
 }
@@ -10,6 +10,8 @@
 #include <math/mat4.h>
 #include <math/quat.h>
 
+#include <vector>
+
 namespace fmt = filament;
 
 double3 get_position(Filament_Entity_ID id)
@@ -71,3 +73,46 @@ bool set_position_and_orientation(Filament_Entity_ID id, double3 pos, Quaternion
     trans_m.setTransform(entity_instance, mat);
     return true;
 }
+
+/*
+ * Same as calling 'set_position_and_orientation' for every entity, but the handles are resolved
+ * up front, the matrices are built in one tight loop and filament only updates the world
+ * transforms of the hierarchy once, when the transaction is committed.
+ */
+bool set_transforms(const Filament_Entity_ID* ids, const double3* positions, const Quaternion* orientations, uint32_t n)
+{
+    if (n == 0) return true;
+
+    // reused between calls, so that updating every tick doesn't allocate
+    static std::vector<utils::Entity> entities;
+    static std::vector<fmath::mat4> transforms;
+    entities.resize(n);
+    transforms.resize(n);
+
+    bool all_valid = true;
+    fmt::Engine* engine = nullptr;
+    for (uint32_t i = 0; i < n; ++i) {
+        Filament_Entity fentity = g_objm.get_object(ids[i]);
+        entities[i] = fentity.entity; // null for invalid handles, those are skipped below
+        if (!fentity.is_valid()) {
+            all_valid = false;
+            continue;
+        }
+        engine = fentity.associated_env->engine;
+    }
+    if (!engine) return false;
+
+    for (uint32_t i = 0; i < n; ++i) {
+        transforms[i] = pose_to_mat4(positions[i], orientations[i]);
+    }
+
+    // all environments share one engine, so one transaction covers every entity
+    fmt::TransformManager& trans_m = engine->getTransformManager();
+    trans_m.openLocalTransformTransaction();
+    for (uint32_t i = 0; i < n; ++i) {
+        if (entities[i].isNull()) continue;
+        trans_m.setTransform(trans_m.getInstance(entities[i]), transforms[i]);
+    }
+    trans_m.commitLocalTransformTransaction();
+    return all_valid;
+}
@@ -3,13 +3,30 @@
 
 #include <camera.hpp>
 #include <environment.hpp>
+#include <engine_context.hpp>
+#include <segmentation.hpp>
+#include <pixel_conversion.hpp>
+#include <polyline.hpp>
+#include <debug_draw.hpp>
 #include <object_manager.hpp>
 #include <logging.hpp>
 
 #include <filament/Renderer.h>
 #include <filament/Engine.h>
+#include <filament/RenderTarget.h>
+#include <filament/Texture.h>
+#include <filament/View.h>
+#include <filament/Camera.h>
+#include <math/mat4.h>
 #include <backend/PixelBufferDescriptor.h>
 
+#include <SDL.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
 ENV_API Frame_ID create_frame(Environment_ID env_id, uint32_t width, uint32_t height)
 {
     Environment* env = g_objm.get_object(env_id);
@@ -29,9 +46,144 @@ Frame* create_frame(Environment* env, fmt::SwapChain* swap_chain)
     return frame;
 }
 
+static bool create_render_target(Frame* frame, uint32_t width, uint32_t height)
+{
+    fmt::Engine* engine = frame->env->engine;
+
+    frame->color_texture = fmt::Texture::Builder()
+        .width(width)
+        .height(height)
+        .levels(1)
+        .usage(fmt::Texture::Usage::COLOR_ATTACHMENT | fmt::Texture::Usage::SAMPLEABLE)
+        .format(fmt::Texture::InternalFormat::RGBA8)
+        .build(*engine);
+
+    frame->depth_texture = fmt::Texture::Builder()
+        .width(width)
+        .height(height)
+        .levels(1)
+        .usage(fmt::Texture::Usage::DEPTH_ATTACHMENT)
+        .format(fmt::Texture::InternalFormat::DEPTH32F)
+        .build(*engine);
+
+    if (!frame->color_texture || !frame->depth_texture) {
+        env_soft_error("Failed to create the textures of an offscreen frame (%u x %u).", width, height);
+        return false;
+    }
+
+    frame->render_target = fmt::RenderTarget::Builder()
+        .texture(fmt::RenderTarget::AttachmentPoint::COLOR, frame->color_texture)
+        .texture(fmt::RenderTarget::AttachmentPoint::DEPTH, frame->depth_texture)
+        .build(*engine);
+
+    frame->texture_width = width;
+    frame->texture_height = height;
+    return frame->render_target != nullptr;
+}
+
+static void destroy_render_target(Frame* frame)
+{
+    fmt::Engine* engine = frame->env->engine;
+    if (frame->render_target) engine->destroy(frame->render_target);
+    if (frame->color_texture) engine->destroy(frame->color_texture);
+    if (frame->depth_texture) engine->destroy(frame->depth_texture);
+    frame->render_target = nullptr;
+    frame->color_texture = nullptr;
+    frame->depth_texture = nullptr;
+}
+
+ENV_API Frame_ID create_offscreen_frame(Environment_ID env_id, uint32_t width, uint32_t height)
+{
+    Environment* env = g_objm.get_object(env_id);
+    if (!env) return {ENV_INVALID_UUID};
+
+    if (width == 0 || height == 0) {
+        env_soft_error("An offscreen frame needs a size of at least 1 x 1, got %u x %u.", width, height);
+        return {ENV_INVALID_UUID};
+    }
+
+    Frame* frame = new Frame;
+    frame->env = env;
+    frame->width = width;
+    frame->height = height;
+    if (!create_render_target(frame, width, height)) {
+        delete frame;
+        return {ENV_INVALID_UUID};
+    }
+    return g_objm.add_object(frame);
+}
+
+ENV_API bool resize_offscreen_frame(Frame_ID frame_id, uint32_t width, uint32_t height)
+{
+    Frame* frame = g_objm.get_object(frame_id);
+    if (!frame) return false;
+
+    if (!frame->is_offscreen()) {
+        env_soft_error("Only offscreen frames can be resized, window frames follow their window.");
+        return false;
+    }
+    if (width == 0 || height == 0) {
+        env_soft_error("An offscreen frame needs a size of at least 1 x 1, got %u x %u.", width, height);
+        return false;
+    }
+
+    if (width > frame->texture_width || height > frame->texture_height) {
+        // the gpu might still render into the old textures
+        frame->env->engine->flushAndWait();
+        destroy_render_target(frame);
+        if (!create_render_target(frame, std::max(width, frame->texture_width), std::max(height, frame->texture_height))) {
+            return false;
+        }
+    }
+    frame->width = width;
+    frame->height = height;
+    return true;
+}
+
+static double get_time_ms()
+{
+    static double sdl_ticks_per_ms = double(SDL_GetPerformanceFrequency()) * 1e-3;
+    return double(SDL_GetPerformanceCounter()) / sdl_ticks_per_ms;
+}
+
+static bool any_readback_in_flight(Readback_Ring* ring)
+{
+    for (Pixel_Readback_Slot& slot : ring->slots) {
+        if (slot.in_flight && !slot.completed.load(std::memory_order_acquire)) return true;
+    }
+    return false;
+}
+
+static void free_readback_slots(Frame* frame, Readback_Ring* ring)
+{
+    // the gpu may still be writing into our buffers
+    if (any_readback_in_flight(ring)) {
+        frame->env->engine->flushAndWait();
+    }
+
+    for (Pixel_Readback_Slot& slot : ring->slots) {
+        if (!slot.shared_export) free(slot.pixel_data);
+        slot.shared_export = nullptr;
+        slot.pixel_data = nullptr;
+        slot.pixel_data_size = 0;
+        slot.in_flight = false;
+        slot.acquired = false;
+        slot.converted = false;
+        slot.completed.store(false, std::memory_order_relaxed);
+    }
+    ring->acquired_slot_idx = -1;
+}
+
 Frame::~Frame()
 {
-    env->engine->destroy(swap_chain);
+    free_readback_slots(this, &pixel_readback);
+    free_readback_slots(this, &depth_readback);
+    free_readback_slots(this, &segmentation_readback);
+    shm_export_destroy(pixel_readback.shared_export);
+    destroy_render_target(this);
+    if (swap_chain) {
+        env->engine->destroy(swap_chain);
+    }
 }
 
 ENV_API bool enable_pixel_capture(Frame_ID frame_id, filament::backend::PixelDataFormat pixel_data_format, filament::backend::PixelDataType pixel_data_type)
@@ -39,13 +191,218 @@ ENV_API bool enable_pixel_capture(Frame_ID frame_id, filament::backend::PixelDat
     Frame* frame = g_objm.get_object(frame_id);
     if (!frame) return false;
 
+    // changing the format invalidates all previous readbacks
+    if (frame->capture_pixels && (frame->pixel_data_format != pixel_data_format || frame->pixel_data_type != pixel_data_type)) {
+        free_readback_slots(frame, &frame->pixel_readback);
+        frame->conversion.valid = false;
+    }
+
     frame->capture_pixels = true;
     frame->pixel_data_format = pixel_data_format;
     frame->pixel_data_type = pixel_data_type;
     return true;
 }
 
-ENV_API bool get_pixel_data(Frame_ID frame_id, void** pixel_data, uint32_t* width, uint32_t* height)
+ENV_API bool disable_pixel_capture(Frame_ID frame_id)
+{
+    Frame* frame = g_objm.get_object(frame_id);
+    if (!frame) return false;
+
+    frame->capture_pixels = false;
+    return true;
+}
+
+ENV_API bool enable_shared_memory_export(Frame_ID frame_id, const char* name, uint32_t max_width, uint32_t max_height)
+{
+    Frame* frame = g_objm.get_object(frame_id);
+    if (!frame) return false;
+
+    if (!frame->capture_pixels) {
+        env_soft_error("Can't export the pixels, because they are not being captured, call 'enable_pixel_capture' first.");
+        return false;
+    }
+
+    size_t slot_capacity = filament::backend::PixelBufferDescriptor::computeDataSize(
+        frame->pixel_data_format, frame->pixel_data_type, max_width, max_height, 1);
+    Shm_Export* shared_export = shm_export_create(name, ENV_PIXEL_READBACK_SLOTS, slot_capacity);
+    if (!shared_export) return false;
+
+    // the slots hold on to their old buffers until they are freed
+    free_readback_slots(frame, &frame->pixel_readback);
+    frame->conversion.valid = false;
+    shm_export_destroy(frame->pixel_readback.shared_export);
+    frame->pixel_readback.shared_export = shared_export;
+    return true;
+}
+
+ENV_API bool disable_shared_memory_export(Frame_ID frame_id)
+{
+    Frame* frame = g_objm.get_object(frame_id);
+    if (!frame) return false;
+
+    if (!frame->pixel_readback.shared_export) return true;
+
+    free_readback_slots(frame, &frame->pixel_readback);
+    frame->conversion.valid = false;
+    shm_export_destroy(frame->pixel_readback.shared_export);
+    frame->pixel_readback.shared_export = nullptr;
+    return true;
+}
+
+ENV_API bool set_frame_debug_draw(Frame_ID frame_id, bool visible)
+{
+    Frame* frame = g_objm.get_object(frame_id);
+    if (!frame) return false;
+
+    frame->show_debug_draw = visible;
+    return true;
+}
+
+// The depth is read back with glReadPixels(GL_DEPTH_COMPONENT, GL_FLOAT), which only desktop OpenGL has.
+// GLES (Android, WebGL), Vulkan and Metal can only read back color attachments.
+static bool backend_supports_depth_readback(fmt::Engine* engine)
+{
+#if defined(__ANDROID__) || defined(__EMSCRIPTEN__)
+    (void)engine;
+    return false;
+#else
+    return engine->getBackend() == fmt::Engine::Backend::OPENGL;
+#endif
+}
+
+ENV_API bool enable_depth_capture(Frame_ID frame_id, Depth_Format depth_format)
+{
+    Frame* frame = g_objm.get_object(frame_id);
+    if (!frame) return false;
+
+    if (!frame->is_offscreen()) {
+        env_soft_error("Depth can only be captured from offscreen frames, use 'create_offscreen_frame'.");
+        return false;
+    }
+    if (depth_format != DEPTH_FLOAT32_METERS && depth_format != DEPTH_UINT16_MILLIMETERS) {
+        env_soft_error("Unknown depth format '%d'.", depth_format);
+        return false;
+    }
+    if (!backend_supports_depth_readback(frame->env->engine)) {
+        env_soft_error("Depth capture needs the desktop OpenGL backend, it can't read back depth buffers otherwise.");
+        return false;
+    }
+
+    // already converted slots are in the old format
+    if (frame->capture_depth && frame->depth_format != depth_format) {
+        free_readback_slots(frame, &frame->depth_readback);
+    }
+
+    frame->capture_depth = true;
+    frame->depth_format = depth_format;
+    return true;
+}
+
+ENV_API bool disable_depth_capture(Frame_ID frame_id)
+{
+    Frame* frame = g_objm.get_object(frame_id);
+    if (!frame) return false;
+
+    frame->capture_depth = false;
+    return true;
+}
+
+ENV_API bool enable_segmentation_capture(Frame_ID frame_id)
+{
+    Frame* frame = g_objm.get_object(frame_id);
+    if (!frame) return false;
+
+    if (!frame->is_offscreen()) {
+        env_soft_error("Segmentation masks can only be captured from offscreen frames, use 'create_offscreen_frame'.");
+        return false;
+    }
+
+    frame->capture_segmentation = true;
+    return true;
+}
+
+ENV_API bool disable_segmentation_capture(Frame_ID frame_id)
+{
+    Frame* frame = g_objm.get_object(frame_id);
+    if (!frame) return false;
+
+    frame->capture_segmentation = false;
+    return true;
+}
+
+// The slots 'in_flight' flag is only cleared here, because the callback might run on another thread.
+static void collect_completed_readbacks(Readback_Ring* ring)
+{
+    for (Pixel_Readback_Slot& slot : ring->slots) {
+        if (slot.in_flight && slot.completed.load(std::memory_order_acquire)) {
+            slot.in_flight = false;
+        }
+    }
+}
+
+static int find_latest_completed_slot(Readback_Ring* ring)
+{
+    int latest_idx = -1;
+    for (int i = 0; i < ENV_PIXEL_READBACK_SLOTS; ++i) {
+        Pixel_Readback_Slot& slot = ring->slots[i];
+        if (!slot.in_flight && slot.completed.load(std::memory_order_acquire)
+            && (latest_idx < 0 || slot.frame_index > ring->slots[latest_idx].frame_index)) {
+            latest_idx = i;
+        }
+    }
+    return latest_idx;
+}
+
+// Returns a slot, which is neither read by the user nor written by the gpu,
+// preferring empty slots and otherwise the oldest completed one.
+static Pixel_Readback_Slot* find_free_slot(Readback_Ring* ring)
+{
+    Pixel_Readback_Slot* free_slot = nullptr;
+    for (Pixel_Readback_Slot& slot : ring->slots) {
+        if (slot.in_flight || slot.acquired) continue;
+        if (!slot.completed.load(std::memory_order_acquire)) return &slot;
+        if (!free_slot || slot.frame_index < free_slot->frame_index) {
+            free_slot = &slot;
+        }
+    }
+    return free_slot;
+}
+
+// Only one image per ring is handed out at a time, the previous one is released implicitly.
+static Pixel_Readback_Slot* acquire_latest_slot(Readback_Ring* ring)
+{
+    collect_completed_readbacks(ring);
+    int latest_idx = find_latest_completed_slot(ring);
+    if (latest_idx < 0) return nullptr;
+
+    if (ring->acquired_slot_idx >= 0) {
+        ring->slots[ring->acquired_slot_idx].acquired = false;
+    }
+    ring->slots[latest_idx].acquired = true;
+    ring->acquired_slot_idx = latest_idx;
+    return &ring->slots[latest_idx];
+}
+
+static bool release_slot(Readback_Ring* ring)
+{
+    if (ring->acquired_slot_idx < 0) {
+        env_soft_error("Can't release the frame, because none has been acquired.");
+        return false;
+    }
+    ring->slots[ring->acquired_slot_idx].acquired = false;
+    ring->acquired_slot_idx = -1;
+    return true;
+}
+
+ENV_API bool release_pixel_frame(Frame_ID frame_id)
+{
+    Frame* frame = g_objm.get_object(frame_id);
+    if (!frame) return false;
+
+    return release_slot(&frame->pixel_readback);
+}
+
+ENV_API bool acquire_latest_pixel_frame(Frame_ID frame_id, void** pixel_data, uint32_t* width, uint32_t* height, uint64_t* frame_index, double* render_time_ms)
 {
     Frame* frame = g_objm.get_object(frame_id);
     if (!frame) return false;
@@ -55,61 +412,437 @@ ENV_API bool get_pixel_data(Frame_ID frame_id, void** pixel_data, uint32_t* widt
                        " being captured, call 'enable_pixel_capture' first");
         return false;
     }
-    *pixel_data = frame->pixel_data;
-    *width = frame->width;
-    *height = frame->height;
-    return *pixel_data != nullptr;
+
+    Pixel_Readback_Slot* slot = acquire_latest_slot(&frame->pixel_readback);
+    if (!slot) {
+        *pixel_data = nullptr;
+        return false;
+    }
+
+    Pixel_Conversion* conversion = &frame->conversion;
+    if (conversion->enabled && (!conversion->valid || conversion->frame_index != slot->frame_index)) {
+        if (frame->pixel_data_format == filament::backend::PixelDataFormat::RGBA
+            && frame->pixel_data_type == filament::backend::PixelDataType::UBYTE) {
+            convert_pixels(conversion, (const uint8_t*)slot->pixel_data, slot->width, slot->height);
+            conversion->frame_index = slot->frame_index;
+            conversion->valid = true;
+        }
+        else {
+            env_soft_error("Pixel conversion needs the pixels to be captured as RGBA / UBYTE.");
+            conversion->valid = false;
+        }
+    }
+
+    *pixel_data = slot->pixel_data;
+    *width = slot->width;
+    *height = slot->height;
+    if (frame_index) *frame_index = slot->frame_index;
+    if (render_time_ms) *render_time_ms = slot->render_time_ms;
+    return true;
 }
 
-ENV_API bool disable_pixel_capture(Frame_ID frame_id)
+ENV_API bool get_pixel_data(Frame_ID frame_id, void** pixel_data, uint32_t* width, uint32_t* height)
+{
+    return acquire_latest_pixel_frame(frame_id, pixel_data, width, height, nullptr, nullptr);
+}
+
+ENV_API bool enable_pixel_conversion(Frame_ID frame_id, const Pixel_Conversion_Settings* settings)
 {
     Frame* frame = g_objm.get_object(frame_id);
     if (!frame) return false;
 
-    frame->capture_pixels = false;
+    if (!pixel_conversion_settings_valid(*settings)) return false;
+
+    frame->conversion.settings = *settings;
+    frame->conversion.enabled = true;
+    frame->conversion.valid = false;
     return true;
 }
 
-bool render_frame(Camera* camera, Frame* frame)
+ENV_API bool disable_pixel_conversion(Frame_ID frame_id)
+{
+    Frame* frame = g_objm.get_object(frame_id);
+    if (!frame) return false;
+
+    frame->conversion = Pixel_Conversion{};
+    return true;
+}
+
+// Returns the converted pixels of the frame, that was acquired last with 'acquire_latest_pixel_frame'.
+ENV_API bool get_converted_pixel_data(Frame_ID frame_id, Pixel_Conversion_Output output, void** data, uint32_t* width, uint32_t* height)
+{
+    Frame* frame = g_objm.get_object(frame_id);
+    if (!frame) return false;
+
+    Pixel_Conversion* conversion = &frame->conversion;
+    if (!conversion->enabled) {
+        env_soft_error("Can't get converted pixel data, call 'enable_pixel_conversion' first.");
+        return false;
+    }
+    if (!(conversion->settings.outputs & output)) {
+        env_soft_error("The pixel conversion output '%u' was not requested in 'enable_pixel_conversion'.", output);
+        return false;
+    }
+    if (!conversion->valid) {
+        *data = nullptr;
+        return false;
+    }
+
+    switch (output) {
+        case PIXEL_OUTPUT_RGBA8:       *data = conversion->rgba8.data(); break;
+        case PIXEL_OUTPUT_GRAY8:       *data = conversion->gray8.data(); break;
+        case PIXEL_OUTPUT_CHW_FLOAT32: *data = conversion->chw_float32.data(); break;
+        default:
+            env_soft_error("Unknown pixel conversion output '%u'.", output);
+            return false;
+    }
+    *width = conversion->width;
+    *height = conversion->height;
+    return true;
+}
+
+/*
+ * Filament renders with reversed-z, in the shaders the gl clip space depth is remapped
+ * with 'depth = 0.5 * (1 - z_ndc)', so the near plane ends up at 1 and infinity at 0.
+ * Solving the projection for the view space distance gives: distance = P32 / (z_ndc + P22).
+ * With filaments infinite far plane for rendering this simplifies to 'near / depth'.
+ */
+static void convert_depth_to_linear(Pixel_Readback_Slot* slot, Depth_Format depth_format)
+{
+    const float* raw_depth = (const float*)slot->pixel_data;
+    size_t n_pixels = size_t(slot->width) * size_t(slot->height);
+
+    if (depth_format == DEPTH_FLOAT32_METERS) {
+        float* linear_depth = (float*)slot->pixel_data;
+        for (size_t i = 0; i < n_pixels; ++i) {
+            double z_ndc = 1.0 - 2.0 * double(raw_depth[i]);
+            double distance = slot->projection_32 / (z_ndc + slot->projection_22);
+            bool no_hit = raw_depth[i] <= 0.0f || distance > slot->far_plane;
+            linear_depth[i] = no_hit ? INFINITY : float(distance);
+        }
+    }
+    else {
+        // writing 2 bytes for every 4 read, so converting in place is safe
+        uint16_t* linear_depth = (uint16_t*)slot->pixel_data;
+        for (size_t i = 0; i < n_pixels; ++i) {
+            double z_ndc = 1.0 - 2.0 * double(raw_depth[i]);
+            double distance_mm = 1e3 * slot->projection_32 / (z_ndc + slot->projection_22);
+            bool no_hit = raw_depth[i] <= 0.0f || distance_mm > 1e3 * slot->far_plane;
+            linear_depth[i] = no_hit ? 0 : uint16_t(std::min(distance_mm + 0.5, double(UINT16_MAX)));
+        }
+    }
+    slot->converted = true;
+}
+
+ENV_API bool acquire_latest_depth_frame(Frame_ID frame_id, void** depth_data, uint32_t* width, uint32_t* height, uint64_t* frame_index, double* render_time_ms)
+{
+    Frame* frame = g_objm.get_object(frame_id);
+    if (!frame) return false;
+
+    if (!frame->capture_depth) {
+        env_soft_error("Can't get depth data, because the depth is not"
+                       " being captured, call 'enable_depth_capture' first");
+        return false;
+    }
+
+    Pixel_Readback_Slot* slot = acquire_latest_slot(&frame->depth_readback);
+    if (!slot) {
+        *depth_data = nullptr;
+        return false;
+    }
+
+    if (!slot->converted) {
+        convert_depth_to_linear(slot, frame->depth_format);
+    }
+
+    *depth_data = slot->pixel_data;
+    *width = slot->width;
+    *height = slot->height;
+    if (frame_index) *frame_index = slot->frame_index;
+    if (render_time_ms) *render_time_ms = slot->render_time_ms;
+    return true;
+}
+
+ENV_API bool release_depth_frame(Frame_ID frame_id)
+{
+    Frame* frame = g_objm.get_object(frame_id);
+    if (!frame) return false;
+
+    return release_slot(&frame->depth_readback);
+}
+
+ENV_API bool acquire_latest_segmentation_frame(Frame_ID frame_id, void** mask_data, uint32_t* width, uint32_t* height, uint64_t* frame_index, double* render_time_ms)
+{
+    Frame* frame = g_objm.get_object(frame_id);
+    if (!frame) return false;
+
+    if (!frame->capture_segmentation) {
+        env_soft_error("Can't get the segmentation mask, because it is not"
+                       " being captured, call 'enable_segmentation_capture' first");
+        return false;
+    }
+
+    Pixel_Readback_Slot* slot = acquire_latest_slot(&frame->segmentation_readback);
+    if (!slot) {
+        *mask_data = nullptr;
+        return false;
+    }
+
+    if (!slot->converted) {
+        segmentation_decode_mask(slot->pixel_data, slot->width, slot->height);
+        slot->converted = true;
+    }
+
+    *mask_data = slot->pixel_data;
+    *width = slot->width;
+    *height = slot->height;
+    if (frame_index) *frame_index = slot->frame_index;
+    if (render_time_ms) *render_time_ms = slot->render_time_ms;
+    return true;
+}
+
+ENV_API bool release_segmentation_frame(Frame_ID frame_id)
+{
+    Frame* frame = g_objm.get_object(frame_id);
+    if (!frame) return false;
+
+    return release_slot(&frame->segmentation_readback);
+}
+
+static Pixel_Readback_Slot* issue_readback(fmt::Renderer* renderer, Frame* frame, Readback_Ring* ring,
+                                           filament::backend::PixelDataFormat format, filament::backend::PixelDataType type,
+                                           uint32_t width, uint32_t height)
 {
-    // beginFrame() returns false if we need to skip a frame (gpu too busy)
-    if (camera->renderer->beginFrame(frame->swap_chain)) {
-        
-        camera->renderer->render(camera->view);
-        
-        if (frame->capture_pixels) {
-
-            frame->width = get_camera_image_width(camera);
-            frame->height = get_camera_image_height(camera);
-            size_t new_pixel_data_size = filament::backend::PixelBufferDescriptor::computeDataSize(
-                frame->pixel_data_format,
-                frame->pixel_data_type,
-                frame->width, frame->height, 1);
-            
-            if (frame->pixel_data_size != new_pixel_data_size) {
-                free(frame->pixel_data);
-                frame->pixel_data = nullptr;
+    collect_completed_readbacks(ring);
+
+    // All slots are busy, the consumer is too slow. We rather drop this image than stall the gpu.
+    Pixel_Readback_Slot* slot = find_free_slot(ring);
+    if (!slot) return nullptr;
+
+    slot->width = width;
+    slot->height = height;
+    size_t new_pixel_data_size = filament::backend::PixelBufferDescriptor::computeDataSize(
+        format, type, slot->width, slot->height, 1);
+
+    uint32_t slot_idx = uint32_t(slot - ring->slots);
+    void* shared_data = nullptr;
+    if (ring->shared_export) {
+        shared_data = shm_export_begin_write(ring->shared_export, slot_idx, frame->frame_counter, width, height,
+                                             uint32_t(format), uint32_t(type), new_pixel_data_size);
+    }
+
+    if (shared_data) {
+        if (!slot->shared_export) free(slot->pixel_data);
+        slot->pixel_data = shared_data;
+        slot->pixel_data_size = new_pixel_data_size;
+        slot->shared_export = ring->shared_export;
+        slot->shared_slot_idx = slot_idx;
+    }
+    else {
+        if (slot->shared_export) {
+            // the image is too big for the shared memory, this one stays private
+            slot->pixel_data = nullptr;
+            slot->pixel_data_size = 0;
+            slot->shared_export = nullptr;
+        }
+        if (slot->pixel_data_size != new_pixel_data_size) {
+            free(slot->pixel_data);
+            slot->pixel_data = malloc(new_pixel_data_size);
+            if (!slot->pixel_data) {
+                env_hard_error(ENV_ERR_MEM_ALLOC);
             }
-            
-            if (!frame->pixel_data) {
-                frame->pixel_data = malloc(frame->pixel_data_size);
+            slot->pixel_data_size = new_pixel_data_size;
+        }
+    }
+
+    slot->frame_index = frame->frame_counter;
+    slot->render_time_ms = get_time_ms();
+    slot->converted = false;
+    slot->completed.store(false, std::memory_order_relaxed);
+    slot->in_flight = true;
+
+    filament::backend::PixelBufferDescriptor pixel_buffer(
+        slot->pixel_data,
+        slot->pixel_data_size,
+        format,
+        type,
+        [](void*, size_t, void* user) {
+            Pixel_Readback_Slot* slot = static_cast<Pixel_Readback_Slot*>(user);
+            if (slot->shared_export) {
+                shm_export_end_write(slot->shared_export, slot->shared_slot_idx);
             }
-            
-            filament::backend::PixelBufferDescriptor pixel_buffer(
-                frame->pixel_data,
-                frame->pixel_data_size,
-                frame->pixel_data_format,
-                frame->pixel_data_type);
+            slot->completed.store(true, std::memory_order_release);
+        },
+        slot);
 
-            camera->renderer->readPixels(0, 0, frame->width, frame->height, std::move(pixel_buffer));
-        }
-        
-        camera->renderer->endFrame();
-        return true;
+    if (frame->is_offscreen()) {
+        renderer->readPixels(frame->render_target, 0, 0, slot->width, slot->height, std::move(pixel_buffer));
+    }
+    else {
+        renderer->readPixels(0, 0, slot->width, slot->height, std::move(pixel_buffer));
+    }
+    return slot;
+}
+
+static bool appears_before(Frame* const* frames, uint32_t idx)
+{
+    for (uint32_t i = 0; i < idx; ++i) {
+        if (frames[i] == frames[idx]) return true;
     }
     return false;
 }
 
+static bool env_appears_before(Frame* const* frames, uint32_t idx)
+{
+    for (uint32_t i = 0; i < idx; ++i) {
+        if (frames[i]->env == frames[idx]->env) return true;
+    }
+    return false;
+}
+
+// Uploads everything that changed in the environment since it was last rendered.
+static void prepare_environment_for_rendering(Environment* env)
+{
+    polylines_upload(env);
+    debug_draw_upload(env);
+    gltf_update_async_loads(env);
+    animations_apply(env);
+}
+
+// Renders all views targeting 'frame' (starting at 'first_idx') and issues its readback.
+// Must be called in between beginFrame() and endFrame().
+static void render_views_into_frame(fmt::Renderer* renderer, Camera* const* cameras, Frame* const* frames, uint32_t first_idx, uint32_t n)
+{
+    Frame* frame = frames[first_idx];
+    // counted first, so every readback of this frame (depth, segmentation, pixels) has the same index, starting at 1
+    frame->frame_counter++;
+
+    if (frame->is_offscreen()) {
+        for (uint32_t j = first_idx; j < n; ++j) {
+            if (frames[j] != frame) continue;
+            Camera* camera = cameras[j];
+            // the frame dictates the image size, just like a window does
+            if (get_camera_image_width(camera) != frame->width || get_camera_image_height(camera) != frame->height) {
+                set_camera_image_size(camera, frame->width, frame->height);
+            }
+        }
+    }
+
+    /*
+     * With post-processing, filament resolves only the color into our render target, so the depth
+     * is taken from a post-processing free view in the same submission, before the color views.
+     */
+    if (frame->capture_depth && frame->is_offscreen()) {
+        Camera* depth_camera = nullptr;
+        for (uint32_t j = first_idx; j < n; ++j) {
+            if (frames[j] != frame) continue;
+            depth_camera = cameras[j];
+            fmt::View* depth_view = get_camera_depth_view(depth_camera);
+            depth_view->setRenderTarget(frame->render_target);
+            renderer->render(depth_view);
+        }
+
+        Pixel_Readback_Slot* slot = issue_readback(renderer, frame, &frame->depth_readback,
+                                                   filament::backend::PixelDataFormat::DEPTH_COMPONENT,
+                                                   filament::backend::PixelDataType::FLOAT,
+                                                   frame->width, frame->height);
+        if (slot) {
+            fmath::mat4 projection = depth_camera->fcamera->getProjectionMatrix();
+            slot->projection_22 = projection[2][2];
+            slot->projection_32 = projection[3][2];
+            slot->far_plane = depth_camera->fcamera->getCullingFar();
+        }
+    }
+
+    // The segmentation mask is rendered in the same submission, with the materials swapped for id colors.
+    if (frame->capture_segmentation && frame->is_offscreen()) {
+        segmentation_begin_mask_pass(frame->env);
+        for (uint32_t j = first_idx; j < n; ++j) {
+            if (frames[j] != frame) continue;
+            fmt::View* mask_view = get_camera_mask_view(cameras[j]);
+            mask_view->setRenderTarget(frame->render_target);
+            renderer->render(mask_view);
+        }
+        segmentation_end_mask_pass(frame->env);
+
+        issue_readback(renderer, frame, &frame->segmentation_readback,
+                       filament::backend::PixelDataFormat::RGBA,
+                       filament::backend::PixelDataType::UBYTE,
+                       frame->width, frame->height);
+    }
+
+    uint32_t width = 0;
+    uint32_t height = 0;
+    for (uint32_t j = first_idx; j < n; ++j) {
+        if (frames[j] != frame) continue;
+        Camera* camera = cameras[j];
+        camera->view->setRenderTarget(frame->is_offscreen() ? frame->render_target : nullptr);
+        camera->view->setVisibleLayers(ENV_DEBUG_DRAW_LAYER, frame->show_debug_draw ? ENV_DEBUG_DRAW_LAYER : 0);
+        if (frame->env->culling_stats_enabled) {
+            update_culling_stats(camera);
+        }
+        renderer->render(camera->view);
+        width = std::max(width, get_camera_image_width(camera));
+        height = std::max(height, get_camera_image_height(camera));
+    }
+
+    if (frame->capture_pixels) {
+        issue_readback(renderer, frame, &frame->pixel_readback, frame->pixel_data_format, frame->pixel_data_type, width, height);
+    }
+}
+
+// All offscreen frames are rendered in between one beginFrame()/endFrame() of the shared renderer,
+// views into swap chains are grouped by their frame, because filament binds one swap chain per frame.
+// Returns false if any of the frames had to be skipped.
+bool render_views(Camera* const* cameras, Frame* const* frames, uint32_t n)
+{
+    if (n == 0) return true;
+
+    bool all_rendered = true;
+    Engine_Context* ctx = frames[0]->env->ctx;
+    fmt::Renderer* renderer = ctx->renderer;
+
+    bool has_offscreen_frames = false;
+    for (uint32_t i = 0; i < n; ++i) {
+        has_offscreen_frames |= frames[i]->is_offscreen();
+        if (!env_appears_before(frames, i)) {
+            prepare_environment_for_rendering(frames[i]->env);
+        }
+    }
+
+    if (has_offscreen_frames) {
+        // beginFrame() returns false if we need to skip a frame (gpu too busy)
+        if (renderer->beginFrame(ctx->headless_swap_chain)) {
+            for (uint32_t i = 0; i < n; ++i) {
+                if (!frames[i]->is_offscreen() || appears_before(frames, i)) continue;
+                render_views_into_frame(renderer, cameras, frames, i, n);
+            }
+            renderer->endFrame();
+        }
+        else {
+            all_rendered = false;
+        }
+    }
+
+    for (uint32_t i = 0; i < n; ++i) {
+        Frame* frame = frames[i];
+        if (frame->is_offscreen() || appears_before(frames, i)) continue; // already rendered together with an earlier view
+
+        if (!renderer->beginFrame(frame->swap_chain)) {
+            all_rendered = false;
+            continue;
+        }
+        render_views_into_frame(renderer, cameras, frames, i, n);
+        renderer->endFrame();
+    }
+    return all_rendered;
+}
+
+bool render_frame(Camera* camera, Frame* frame)
+{
+    return render_views(&camera, &frame, 1);
+}
+
 ENV_API bool render_frame(Camera_ID camera_id, Frame_ID frame_id)
 {
     Camera* camera = g_objm.get_object(camera_id);
@@ -118,3 +851,20 @@ ENV_API bool render_frame(Camera_ID camera_id, Frame_ID frame_id)
     
     return render_frame(camera, frame);
 }
+
+ENV_API bool render_views(const Camera_ID* camera_ids, const Frame_ID* frame_ids, uint32_t n)
+{
+    // reused between calls, so that rendering every tick doesn't allocate
+    static std::vector<Camera*> cameras;
+    static std::vector<Frame*> frames;
+    cameras.resize(n);
+    frames.resize(n);
+
+    for (uint32_t i = 0; i < n; ++i) {
+        cameras[i] = g_objm.get_object(camera_ids[i]);
+        frames[i] = g_objm.get_object(frame_ids[i]);
+        if (!cameras[i] || !frames[i]) return false;
+    }
+
+    return render_views(cameras.data(), frames.data(), n);
+}
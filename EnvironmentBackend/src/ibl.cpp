@@ -0,0 +1,290 @@
+#include <ibl.hpp>
+
+#include <engine_context.hpp>
+#include <disk_cache.hpp>
+#include <irradiance_sh.hpp>
+#include <mapped_file.hpp>
+#include <logging.hpp>
+
+#include <filament/Engine.h>
+#include <filament/Renderer.h>
+#include <filament/RenderTarget.h>
+#include <filament/Texture.h>
+#include <math/half.h>
+#include <math/vec4.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+#include <unistd.h>
+
+/*
+ * Cache file layout: the header, then the pixels as RGB half floats, every level with the faces in
+ * the order +X, -X, +Y, -Y, +Z, -Z and the rows in the order of Texture::setImage().
+ * First the single level of the skybox, then all reflection levels.
+ * Bump the version whenever the layout or the way the content is computed changes.
+ */
+#define IBL_CACHE_MAGIC "ENVIBL2"
+#define IBL_CACHE_VERSION 2
+
+struct IBL_Cache_Header {
+    char magic[8];
+    uint64_t key;
+    uint32_t skybox_size;
+    uint32_t reflections_size;
+    uint32_t reflections_levels;
+    uint32_t version;
+    float irradiance_sh[9][3];
+};
+
+typedef fmath::half IBL_Cache_Pixel[3];
+
+static uint32_t level_size(uint32_t size, uint32_t level) { return std::max(1u, size >> level); }
+
+static size_t cubemap_level_pixel_count(uint32_t size) { return size_t(size) * size * 6; }
+
+static size_t ibl_cache_file_size(const IBL_Cache_Header& header)
+{
+    size_t n_pixels = cubemap_level_pixel_count(header.skybox_size);
+    for (uint32_t level = 0; level < header.reflections_levels; ++level) {
+        n_pixels += cubemap_level_pixel_count(level_size(header.reflections_size, level));
+    }
+    return sizeof(IBL_Cache_Header) + n_pixels * sizeof(IBL_Cache_Pixel);
+}
+
+uint64_t ibl_cache_key(const void* source, size_t source_size, const IBL_Prefilter_Settings& settings)
+{
+    // hashed field by field, the struct could contain padding
+    float parameters[] = {
+        float(IBL_CACHE_VERSION),
+        float(settings.sample_count),
+        float(settings.reflections_levels),
+        settings.hdr_linear,
+        settings.hdr_max,
+        settings.lod_offset,
+    };
+    return hash_bytes(parameters, sizeof(parameters), hash_bytes(source, source_size));
+}
+
+struct Cubemap_Level {
+    fmt::Texture* cubemap;
+    uint32_t level;
+    std::vector<fmath::float4> pixels;
+};
+
+/*
+ * Reads all faces of the given cubemap levels back within one frame and blocks until they arrived.
+ * The read back goes through a render target per face, the pixels are converted to float, whatever the
+ * texture format is, and their rows are put into the order of Texture::setImage().
+ */
+static bool read_back_cubemap_levels(Engine_Context* ctx, Cubemap_Level* levels, uint32_t n_levels)
+{
+    size_t n_pixels = 0;
+    for (uint32_t i = 0; i < n_levels; ++i) {
+        n_pixels += cubemap_level_pixel_count(level_size(uint32_t(levels[i].cubemap->getWidth()), levels[i].level));
+    }
+    // stays alive, if the read back never finishes, the driver would write into freed memory otherwise
+    fmath::float4* buffer = (fmath::float4*)malloc(n_pixels * sizeof(fmath::float4));
+    if (!buffer) {
+        env_hard_error(ENV_ERR_MEM_ALLOC);
+    }
+    std::atomic<uint32_t>* n_pending = new std::atomic<uint32_t>(6 * n_levels);
+
+    // readPixels() has to be called in between beginFrame() and endFrame(), which fails if the gpu is busy
+    fmt::Renderer* renderer = ctx->renderer;
+    if (!renderer->beginFrame(ctx->headless_swap_chain)) {
+        ctx->engine->flushAndWait();
+        if (!renderer->beginFrame(ctx->headless_swap_chain)) {
+            env_warning("Unable to read back the prefiltered environment map, the gpu is busy.");
+            free(buffer);
+            delete n_pending;
+            return false;
+        }
+    }
+
+    std::vector<fmt::RenderTarget*> targets;
+    fmath::float4* dst = buffer;
+    for (uint32_t i = 0; i < n_levels; ++i) {
+        uint32_t size = level_size(uint32_t(levels[i].cubemap->getWidth()), levels[i].level);
+        size_t face_n_pixels = size_t(size) * size;
+        for (uint32_t face = 0; face < 6; ++face) {
+            fmt::RenderTarget* target = fmt::RenderTarget::Builder()
+                .texture(fmt::RenderTarget::AttachmentPoint::COLOR, levels[i].cubemap)
+                .mipLevel(fmt::RenderTarget::AttachmentPoint::COLOR, uint8_t(levels[i].level))
+                .face(fmt::RenderTarget::AttachmentPoint::COLOR, fmt::RenderTarget::CubemapFace(face))
+                .build(*ctx->engine);
+            targets.push_back(target);
+
+            fmt::Texture::PixelBufferDescriptor face_buffer(
+                dst, face_n_pixels * sizeof(fmath::float4),
+                fmt::Texture::Format::RGBA, fmt::Texture::Type::FLOAT,
+                [](void*, size_t, void* user) { ((std::atomic<uint32_t>*)user)->fetch_sub(1, std::memory_order_release); },
+                n_pending);
+            renderer->readPixels(target, 0, 0, size, size, std::move(face_buffer));
+            dst += face_n_pixels;
+        }
+    }
+    renderer->endFrame();
+
+    // the callbacks are dispatched by the message queues once the gpu is done
+    ctx->engine->flushAndWait();
+    ctx->engine->pumpMessageQueues();
+    for (fmt::RenderTarget* target : targets) {
+        ctx->engine->destroy(target);
+    }
+    if (n_pending->load(std::memory_order_acquire) > 0) {
+        env_warning("Reading back the prefiltered environment map didn't finish.");
+        return false;
+    }
+
+    // The OpenGL backend returns the rows of textures, which were filled with setImage(), upside down
+    // (see Renderer::readPixels()), the cache and the spherical harmonics need them in setImage() order.
+    bool flip_rows = ctx->engine->getBackend() == fmt::Engine::Backend::OPENGL;
+    const fmath::float4* src = buffer;
+    for (uint32_t i = 0; i < n_levels; ++i) {
+        uint32_t size = level_size(uint32_t(levels[i].cubemap->getWidth()), levels[i].level);
+        std::vector<fmath::float4>& pixels = levels[i].pixels;
+        pixels.resize(cubemap_level_pixel_count(size));
+        for (uint32_t face = 0; face < 6; ++face) {
+            for (uint32_t y = 0; y < size; ++y) {
+                uint32_t src_y = flip_rows ? size - 1 - y : y;
+                const fmath::float4* src_row = src + (size_t(face) * size + src_y) * size;
+                std::copy(src_row, src_row + size, pixels.data() + (size_t(face) * size + y) * size);
+            }
+        }
+        src += pixels.size();
+    }
+    free(buffer);
+    delete n_pending;
+    return true;
+}
+
+static IBL_Cache_Pixel* append_cache_pixels(IBL_Cache_Pixel* dst, const std::vector<fmath::float4>& pixels)
+{
+    for (const fmath::float4& pixel : pixels) {
+        (*dst)[0] = fmath::half(pixel.r);
+        (*dst)[1] = fmath::half(pixel.g);
+        (*dst)[2] = fmath::half(pixel.b);
+        dst++;
+    }
+    return dst;
+}
+
+bool ibl_read_back_and_store(Engine_Context* ctx, uint64_t key, IBL* ibl)
+{
+    std::string path = disk_cache_path("ibl", key, ".ibl");
+
+    // the sharpest reflection level is the unfiltered radiance, the irradiance is computed from it
+    std::vector<Cubemap_Level> levels;
+    levels.push_back({ibl->reflections, 0, {}});
+    uint32_t reflections_levels = uint32_t(ibl->reflections->getLevels());
+    if (!path.empty()) {
+        for (uint32_t level = 1; level < reflections_levels; ++level) {
+            levels.push_back({ibl->reflections, level, {}});
+        }
+        levels.push_back({ibl->skybox, 0, {}});
+    }
+    if (!read_back_cubemap_levels(ctx, levels.data(), uint32_t(levels.size()))) return false;
+
+    compute_irradiance_sh(levels[0].pixels.data(), uint32_t(ibl->reflections->getWidth()), ibl->irradiance_sh);
+    ibl->has_irradiance = true;
+    if (path.empty()) return true;
+
+    IBL_Cache_Header header = {};
+    memcpy(header.magic, IBL_CACHE_MAGIC, sizeof(header.magic));
+    header.key = key;
+    header.skybox_size = uint32_t(ibl->skybox->getWidth());
+    header.reflections_size = uint32_t(ibl->reflections->getWidth());
+    header.reflections_levels = reflections_levels;
+    header.version = IBL_CACHE_VERSION;
+    memcpy(header.irradiance_sh, ibl->irradiance_sh, sizeof(header.irradiance_sh));
+
+    std::vector<uint8_t> file_data(ibl_cache_file_size(header));
+    memcpy(file_data.data(), &header, sizeof(header));
+    IBL_Cache_Pixel* dst = (IBL_Cache_Pixel*)(file_data.data() + sizeof(header));
+    dst = append_cache_pixels(dst, levels.back().pixels); // skybox
+    for (uint32_t level = 0; level < reflections_levels; ++level) {
+        dst = append_cache_pixels(dst, levels[level].pixels);
+    }
+
+    disk_cache_write(path, file_data.data(), file_data.size());
+    return true;
+}
+
+// All uploads point into the same mapping, the last one to finish unmaps it.
+struct IBL_Cache_Upload {
+    Mapped_File file;
+    std::atomic<uint32_t> n_pending{0};
+};
+
+static void ibl_cache_upload_done(void*, size_t, void* user)
+{
+    IBL_Cache_Upload* upload = (IBL_Cache_Upload*)user;
+    if (upload->n_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        unmap_file(&upload->file);
+        delete upload;
+    }
+}
+
+static fmt::Texture* create_cubemap_from_cache(Engine_Context* ctx, IBL_Cache_Upload* upload, const IBL_Cache_Pixel** src, uint32_t size, uint32_t n_levels)
+{
+    fmt::Texture* cubemap = fmt::Texture::Builder()
+        .width(size)
+        .height(size)
+        .levels(uint8_t(n_levels))
+        .format(fmt::Texture::InternalFormat::R11F_G11F_B10F)
+        .sampler(fmt::Texture::Sampler::SAMPLER_CUBEMAP)
+        .build(*ctx->engine);
+
+    for (uint32_t level = 0; level < n_levels; ++level) {
+        uint32_t size_at_level = level_size(size, level);
+        size_t n_pixels = cubemap_level_pixel_count(size_at_level);
+        fmt::Texture::PixelBufferDescriptor buffer(
+            *src, n_pixels * sizeof(IBL_Cache_Pixel),
+            fmt::Texture::Format::RGB, fmt::Texture::Type::HALF,
+            ibl_cache_upload_done, upload);
+        cubemap->setImage(*ctx->engine, level, 0, 0, 0, size_at_level, size_at_level, 6, std::move(buffer));
+        *src += n_pixels;
+    }
+    return cubemap;
+}
+
+bool ibl_cache_load(Engine_Context* ctx, uint64_t key, IBL* ibl)
+{
+    std::string path = disk_cache_path("ibl", key, ".ibl");
+    if (path.empty() || access(path.c_str(), R_OK) != 0) return false;
+
+    IBL_Cache_Upload* upload = new IBL_Cache_Upload;
+    if (!map_file(path.c_str(), &upload->file)) {
+        delete upload;
+        return false;
+    }
+
+    IBL_Cache_Header header;
+    bool valid = upload->file.size >= sizeof(header);
+    if (valid) {
+        memcpy(&header, upload->file.data, sizeof(header));
+        valid = memcmp(header.magic, IBL_CACHE_MAGIC, sizeof(header.magic)) == 0
+             && header.key == key
+             && header.version == IBL_CACHE_VERSION
+             && header.skybox_size > 0 && header.reflections_size > 0
+             && header.reflections_levels > 0 && header.reflections_levels <= 16
+             && ibl_cache_file_size(header) == upload->file.size;
+    }
+    if (!valid) {
+        env_warning("Ignoring the damaged cache file '%s'.", path.c_str());
+        unmap_file(&upload->file);
+        delete upload;
+        return false;
+    }
+
+    upload->n_pending.store(1 + header.reflections_levels, std::memory_order_relaxed);
+    const IBL_Cache_Pixel* src = (const IBL_Cache_Pixel*)(upload->file.data + sizeof(header));
+    ibl->skybox = create_cubemap_from_cache(ctx, upload, &src, header.skybox_size, 1);
+    ibl->reflections = create_cubemap_from_cache(ctx, upload, &src, header.reflections_size, header.reflections_levels);
+    memcpy(ibl->irradiance_sh, header.irradiance_sh, sizeof(header.irradiance_sh));
+    ibl->has_irradiance = true;
+    return true;
+}
@@ -0,0 +1,49 @@
+#include <irradiance_sh.hpp>
+
+#include <cmath>
+
+fmath::double3 cubemap_direction(uint32_t face, double s, double t)
+{
+    switch (face) {
+        case 0:  return { 1.0,  -t,  -s};
+        case 1:  return {-1.0,  -t,   s};
+        case 2:  return {   s, 1.0,   t};
+        case 3:  return {   s, -1.0, -t};
+        case 4:  return {   s,  -t, 1.0};
+        default: return {  -s,  -t, -1.0};
+    }
+}
+
+void compute_irradiance_sh(const fmath::float4* pixels, uint32_t size, fmath::float3 sh[9])
+{
+    constexpr double NORMALIZATION[9] = {0.282095, 0.488603, 0.488603, 0.488603, 1.092548, 1.092548, 0.315392, 1.092548, 0.546274};
+    constexpr double CLAMPED_COSINE[9] = {M_PI, 2.0 * M_PI / 3.0, 2.0 * M_PI / 3.0, 2.0 * M_PI / 3.0,
+                                          M_PI / 4.0, M_PI / 4.0, M_PI / 4.0, M_PI / 4.0, M_PI / 4.0};
+
+    fmath::double3 accumulated[9] = {};
+    double texel_area = (2.0 / size) * (2.0 / size);
+    for (uint32_t face = 0; face < 6; ++face) {
+        for (uint32_t y = 0; y < size; ++y) {
+            for (uint32_t x = 0; x < size; ++x) {
+                double s = 2.0 * (x + 0.5) / size - 1.0;
+                double t = 2.0 * (y + 0.5) / size - 1.0;
+                fmath::double3 dir = cubemap_direction(face, s, t);
+                double length_2 = dot(dir, dir);
+                double solid_angle = texel_area / (length_2 * std::sqrt(length_2));
+                dir /= std::sqrt(length_2);
+
+                double basis[9] = {
+                    1.0, dir.y, dir.z, dir.x,
+                    dir.x * dir.y, dir.y * dir.z, 3.0 * dir.z * dir.z - 1.0, dir.x * dir.z, dir.x * dir.x - dir.y * dir.y
+                };
+                fmath::double3 radiance = fmath::double3(pixels[(size_t(face) * size + y) * size + x].xyz);
+                for (uint32_t i = 0; i < 9; ++i) {
+                    accumulated[i] += radiance * (basis[i] * solid_angle);
+                }
+            }
+        }
+    }
+    for (uint32_t i = 0; i < 9; ++i) {
+        sh[i] = fmath::float3(accumulated[i] * (NORMALIZATION[i] * NORMALIZATION[i] * CLAMPED_COSINE[i] * M_1_PI));
+    }
+}
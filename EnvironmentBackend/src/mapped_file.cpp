@@ -0,0 +1,62 @@
+#include <mapped_file.hpp>
+
+#include <logging.hpp>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+bool map_file(const char* path, Mapped_File* file)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        env_soft_error("Unable to open file '%s': %s", path, strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        env_soft_error("'%s' is not a regular file.", path);
+        close(fd);
+        return false;
+    }
+    if (st.st_size == 0) {
+        env_soft_error("The file '%s' is empty.", path);
+        close(fd);
+        return false;
+    }
+
+    void* mapping = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping keeps the file alive
+    if (mapping == MAP_FAILED) {
+        env_soft_error("Unable to map file '%s': %s", path, strerror(errno));
+        return false;
+    }
+    // the loaders parse front to back, so let the kernel read ahead aggressively (the advice values are no flags)
+    madvise(mapping, size_t(st.st_size), MADV_SEQUENTIAL);
+    madvise(mapping, size_t(st.st_size), MADV_WILLNEED);
+
+    file->data = (const uint8_t*)mapping;
+    file->size = size_t(st.st_size);
+    return true;
+}
+
+void unmap_file(Mapped_File* file)
+{
+    if (file->data) {
+        munmap((void*)file->data, file->size);
+    }
+    file->data = nullptr;
+    file->size = 0;
+}
+
+void unmap_file_callback(void*, size_t, void* user)
+{
+    Mapped_File* file = (Mapped_File*)user;
+    unmap_file(file);
+    delete file;
+}
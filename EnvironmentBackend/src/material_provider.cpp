@@ -0,0 +1,347 @@
+#include <material_provider.hpp>
+
+#include <disk_cache.hpp>
+#include <mapped_file.hpp>
+#include <logging.hpp>
+
+#include <filament/Engine.h>
+#include <filament/Material.h>
+#include <filament/MaterialEnums.h>
+#include <gltfio/MaterialProvider.h>
+#include <filamat/MaterialBuilder.h>
+#include <filamat/Package.h>
+#include <materials/uberarchive.h>
+#include <tsl/robin_map.h>
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Bump whenever the generated shaders or material settings change, old cache entries are ignored then.
+#define MATERIAL_CACHE_VERSION 2
+
+typedef filamat::MaterialBuilder Material_Builder;
+
+// Only the core metallic-roughness and unlit materials are generated here, every extension and
+// specular-glossiness goes to the jit shader provider.
+static bool uses_only_core_features(const fgltfio::MaterialKey& config)
+{
+    return !config.useSpecularGlossiness && !config.enableDiagnostics && !config.hasClearCoat
+        && !config.hasTransmission && !config.hasSheen && !config.hasVolume && !config.hasIOR && !config.hasSpecular;
+}
+
+// The core fields copied into a zeroed key, so the padding and the unused fields never reach the hash.
+static fgltfio::MaterialKey core_material_key(const fgltfio::MaterialKey& config)
+{
+    fgltfio::MaterialKey core;
+    memset(&core, 0, sizeof(core));
+    core.doubleSided = config.doubleSided;
+    core.unlit = config.unlit;
+    core.hasVertexColors = config.hasVertexColors;
+    core.hasBaseColorTexture = config.hasBaseColorTexture;
+    core.hasNormalTexture = config.hasNormalTexture;
+    core.hasOcclusionTexture = config.hasOcclusionTexture;
+    core.hasEmissiveTexture = config.hasEmissiveTexture;
+    core.alphaMode = config.alphaMode;
+    core.hasMetallicRoughnessTexture = config.hasMetallicRoughnessTexture;
+    core.metallicRoughnessUV = config.metallicRoughnessUV;
+    core.baseColorUV = config.baseColorUV;
+    core.hasTextureTransforms = config.hasTextureTransforms;
+    core.emissiveUV = config.emissiveUV;
+    core.aoUV = config.aoUV;
+    core.normalUV = config.normalUV;
+    return core;
+}
+
+/*
+ * The generator below mirrors gltfio's, the cached packages must not outlive the filament build they were
+ * made for. The ubershader archive is built from the same gltfio material sources, its hash changes with them.
+ */
+static uint64_t gltfio_build_hash()
+{
+    static const uint64_t hash = hash_bytes(UBERARCHIVE_DEFAULT_DATA, UBERARCHIVE_DEFAULT_SIZE);
+    return hash;
+}
+
+static uint64_t material_cache_key(const fgltfio::MaterialKey& config, const fgltfio::UvMap& uvmap, fmt::Engine* engine)
+{
+    uint64_t parameters[] = {
+        MATERIAL_CACHE_VERSION,
+        uint64_t(fmt::MATERIAL_VERSION),
+        gltfio_build_hash(),
+        uint64_t(engine->getBackend()),
+    };
+    fgltfio::MaterialKey core = core_material_key(config);
+    uint64_t key = hash_bytes(parameters, sizeof(parameters));
+    key = hash_bytes(&core, sizeof(core), key);
+    return hash_bytes(uvmap.data(), sizeof(uvmap), key);
+}
+
+/*
+ * Shader generation, follows gltfio's jit shader provider, so the materials have exactly the parameters
+ * the AssetLoader and ResourceLoader set.
+ */
+
+static std::string uv_getter(const fgltfio::UvMap& uvmap, uint8_t texcoord)
+{
+    return uvmap[texcoord] == fgltfio::UvSet::UV1 ? "getUV1()" : "getUV0()";
+}
+
+static std::string texture_uv(const fgltfio::MaterialKey& config, const fgltfio::UvMap& uvmap, uint8_t texcoord, const char* name)
+{
+    std::string shader = std::string("    float2 ") + name + "UV = " + uv_getter(uvmap, texcoord) + ";\n";
+    if (config.hasTextureTransforms) {
+        shader += std::string("    ") + name + "UV = (vec3(" + name + "UV, 1.0) * materialParams." + name + "UvMatrix).xy;\n";
+    }
+    return shader;
+}
+
+static std::string shader_from_key(const fgltfio::MaterialKey& config, const fgltfio::UvMap& uvmap)
+{
+    std::string shader = "void material(inout MaterialInputs material) {\n";
+
+    if (config.hasNormalTexture && !config.unlit) {
+        shader += texture_uv(config, uvmap, config.normalUV, "normal");
+        shader += "    material.normal = texture(materialParams_normalMap, normalUV).xyz * 2.0 - 1.0;\n"
+                  "    material.normal.xy *= materialParams.normalScale;\n";
+    }
+
+    shader += "    prepareMaterial(material);\n"
+              "    material.baseColor = materialParams.baseColorFactor;\n";
+    if (config.hasBaseColorTexture) {
+        shader += texture_uv(config, uvmap, config.baseColorUV, "baseColor");
+        shader += "    material.baseColor *= texture(materialParams_baseColorMap, baseColorUV);\n";
+    }
+    if (config.alphaMode == fgltfio::AlphaMode::BLEND) {
+        shader += "    material.baseColor.rgb *= material.baseColor.a;\n";
+    }
+    if (config.hasVertexColors) {
+        shader += "    material.baseColor *= getColor();\n";
+    }
+
+    if (!config.unlit) {
+        shader += "    material.roughness = materialParams.roughnessFactor;\n"
+                  "    material.metallic = materialParams.metallicFactor;\n"
+                  "    material.emissive = vec4(materialParams.emissiveStrength * materialParams.emissiveFactor.rgb, 0.0);\n";
+        if (config.hasMetallicRoughnessTexture) {
+            shader += texture_uv(config, uvmap, config.metallicRoughnessUV, "metallicRoughness");
+            shader += "    vec4 mr = texture(materialParams_metallicRoughnessMap, metallicRoughnessUV);\n"
+                      "    material.roughness *= mr.g;\n"
+                      "    material.metallic *= mr.b;\n";
+        }
+        if (config.hasOcclusionTexture) {
+            shader += texture_uv(config, uvmap, config.aoUV, "occlusion");
+            shader += "    float occlusion = texture(materialParams_occlusionMap, occlusionUV).r;\n"
+                      "    material.ambientOcclusion = 1.0 + materialParams.aoStrength * (occlusion - 1.0);\n";
+        }
+        if (config.hasEmissiveTexture) {
+            shader += texture_uv(config, uvmap, config.emissiveUV, "emissive");
+            shader += "    material.emissive.rgb *= texture(materialParams_emissiveMap, emissiveUV).rgb;\n";
+        }
+    }
+
+    shader += "}\n";
+    return shader;
+}
+
+static void add_texture_parameters(Material_Builder* builder, const fgltfio::MaterialKey& config, const char* map, const char* uv_matrix)
+{
+    builder->parameter(map, Material_Builder::SamplerType::SAMPLER_2D);
+    if (config.hasTextureTransforms) {
+        builder->parameter(uv_matrix, Material_Builder::UniformType::MAT3, Material_Builder::ParameterPrecision::HIGH);
+    }
+}
+
+static Material_Builder::TargetApi target_api_of(fmt::Engine* engine)
+{
+    switch (engine->getBackend()) {
+        case fmt::Engine::Backend::VULKAN: return Material_Builder::TargetApi::VULKAN;
+        case fmt::Engine::Backend::METAL:  return Material_Builder::TargetApi::METAL;
+        default:                           return Material_Builder::TargetApi::OPENGL;
+    }
+}
+
+static filamat::Package build_material_package(fmt::Engine* engine, const fgltfio::MaterialKey& config, const fgltfio::UvMap& uvmap, const char* label)
+{
+    std::string shader = shader_from_key(config, uvmap);
+
+    Material_Builder builder;
+    builder.name(label)
+        .flipUV(false)
+        .specularAmbientOcclusion(Material_Builder::SpecularAmbientOcclusion::SIMPLE)
+        .specularAntiAliasing(true)
+        .clearCoatIorChange(false)
+        .material(shader.c_str())
+        .doubleSided(config.doubleSided)
+        .transparencyMode(config.doubleSided ? Material_Builder::TransparencyMode::TWO_PASSES_TWO_SIDES
+                                             : Material_Builder::TransparencyMode::DEFAULT)
+        .reflectionMode(Material_Builder::ReflectionMode::SCREEN_SPACE)
+        .targetApi(target_api_of(engine));
+
+    uint8_t n_uv_sets = 0;
+    for (fgltfio::UvSet uv_set : uvmap) {
+        n_uv_sets = std::max(n_uv_sets, uint8_t(uv_set));
+    }
+    if (n_uv_sets > 0) builder.require(fmt::VertexAttribute::UV0);
+    if (n_uv_sets > 1) builder.require(fmt::VertexAttribute::UV1);
+    if (config.hasVertexColors) builder.require(fmt::VertexAttribute::COLOR);
+
+    builder.parameter("baseColorFactor", Material_Builder::UniformType::FLOAT4);
+    if (config.hasBaseColorTexture) add_texture_parameters(&builder, config, "baseColorMap", "baseColorUvMatrix");
+
+    builder.parameter("metallicFactor", Material_Builder::UniformType::FLOAT);
+    builder.parameter("roughnessFactor", Material_Builder::UniformType::FLOAT);
+    if (config.hasMetallicRoughnessTexture) add_texture_parameters(&builder, config, "metallicRoughnessMap", "metallicRoughnessUvMatrix");
+
+    builder.parameter("normalScale", Material_Builder::UniformType::FLOAT);
+    if (config.hasNormalTexture) add_texture_parameters(&builder, config, "normalMap", "normalUvMatrix");
+
+    builder.parameter("aoStrength", Material_Builder::UniformType::FLOAT);
+    if (config.hasOcclusionTexture) add_texture_parameters(&builder, config, "occlusionMap", "occlusionUvMatrix");
+
+    builder.parameter("emissiveFactor", Material_Builder::UniformType::FLOAT3);
+    builder.parameter("emissiveStrength", Material_Builder::UniformType::FLOAT);
+    if (config.hasEmissiveTexture) add_texture_parameters(&builder, config, "emissiveMap", "emissiveUvMatrix");
+
+    switch (config.alphaMode) {
+        case fgltfio::AlphaMode::OPAQUE:
+            builder.blending(Material_Builder::BlendingMode::OPAQUE);
+            break;
+        case fgltfio::AlphaMode::MASK:
+            builder.blending(Material_Builder::BlendingMode::MASKED);
+            break;
+        case fgltfio::AlphaMode::BLEND:
+            builder.blending(Material_Builder::BlendingMode::FADE);
+            builder.depthWrite(true);
+            break;
+    }
+    builder.shading(config.unlit ? Material_Builder::Shading::UNLIT : Material_Builder::Shading::LIT);
+
+    return builder.build(engine->getJobSystem());
+}
+
+static fmt::Material* load_cached_material(fmt::Engine* engine, const std::string& path)
+{
+    if (path.empty() || access(path.c_str(), R_OK) != 0) return nullptr;
+
+    Mapped_File file;
+    if (!map_file(path.c_str(), &file)) return nullptr;
+    // the package is parsed during build(), the mapping isn't needed afterwards
+    fmt::Material* material = fmt::Material::Builder().package(file.data, file.size).build(*engine);
+    unmap_file(&file);
+    if (!material) {
+        env_warning("Ignoring the damaged material cache file '%s'.", path.c_str());
+    }
+    return material;
+}
+
+class Cached_Material_Provider final : public fgltfio::MaterialProvider {
+public:
+    explicit Cached_Material_Provider(fmt::Engine* engine)
+        : m_engine(engine), m_jit_provider(fgltfio::createJitShaderProvider(engine))
+    {
+        Material_Builder::init();
+    }
+
+    ~Cached_Material_Provider() override
+    {
+        delete m_jit_provider;
+        Material_Builder::shutdown();
+    }
+
+    fmt::MaterialInstance* createMaterialInstance(fgltfio::MaterialKey* config, fgltfio::UvMap* uvmap,
+                                                  const char* label, const char* extras) override
+    {
+        fgltfio::constrainMaterial(config, uvmap);
+        if (!uses_only_core_features(*config)) {
+            return m_jit_provider->createMaterialInstance(config, uvmap, label, extras);
+        }
+        fmt::Material* material = get_core_material(*config, *uvmap, label);
+        return material ? material->createInstance(label) : nullptr;
+    }
+
+    fmt::Material* getMaterial(fgltfio::MaterialKey* config, fgltfio::UvMap* uvmap, const char* label) override
+    {
+        fgltfio::constrainMaterial(config, uvmap);
+        if (!uses_only_core_features(*config)) {
+            return m_jit_provider->getMaterial(config, uvmap, label);
+        }
+        return get_core_material(*config, *uvmap, label);
+    }
+
+    // Our materials first, then the ones of the jit provider.
+    const fmt::Material* const* getMaterials() const noexcept override
+    {
+        m_all_materials.assign(m_materials.begin(), m_materials.end());
+        const fmt::Material* const* jit_materials = m_jit_provider->getMaterials();
+        m_all_materials.insert(m_all_materials.end(), jit_materials, jit_materials + m_jit_provider->getMaterialsCount());
+        return m_all_materials.data();
+    }
+
+    size_t getMaterialsCount() const noexcept override
+    {
+        return m_materials.size() + m_jit_provider->getMaterialsCount();
+    }
+
+    void destroyMaterials() override
+    {
+        for (fmt::Material* material : m_materials) {
+            m_engine->destroy(material);
+        }
+        m_materials.clear();
+        m_materials_by_key.clear();
+        m_jit_provider->destroyMaterials();
+    }
+
+    bool needsDummyData(fmt::VertexAttribute attrib) const noexcept override
+    {
+        return m_jit_provider->needsDummyData(attrib);
+    }
+
+private:
+    // Looked up in memory, then in the disk cache, generated only if both miss.
+    fmt::Material* get_core_material(const fgltfio::MaterialKey& config, const fgltfio::UvMap& uvmap, const char* label)
+    {
+        uint64_t key = material_cache_key(config, uvmap, m_engine);
+        if (auto it = m_materials_by_key.find(key); it != m_materials_by_key.end()) {
+            return it->second;
+        }
+        if (!label) label = "material";
+
+        std::string path = disk_cache_path("materials", key, ".filamat");
+        fmt::Material* material = load_cached_material(m_engine, path);
+        if (!material) {
+            filamat::Package package = build_material_package(m_engine, config, uvmap, label);
+            if (!package.isValid()) {
+                env_soft_error("Failed to generate the glTF material '%s'.", label);
+                return nullptr;
+            }
+            material = fmt::Material::Builder().package(package.getData(), package.getSize()).build(*m_engine);
+            if (!material) {
+                env_soft_error("Failed to load the glTF material '%s'.", label);
+                return nullptr;
+            }
+            if (!path.empty()) {
+                disk_cache_write(path, package.getData(), package.getSize());
+            }
+        }
+
+        m_materials_by_key[key] = material;
+        m_materials.push_back(material);
+        return material;
+    }
+
+    fmt::Engine* m_engine;
+    fgltfio::MaterialProvider* m_jit_provider;
+    tsl::robin_map<uint64_t, fmt::Material*> m_materials_by_key;
+    std::vector<fmt::Material*> m_materials;
+    mutable std::vector<const fmt::Material*> m_all_materials;
+};
+
+fgltfio::MaterialProvider* create_cached_material_provider(fmt::Engine* engine)
+{
+    return new Cached_Material_Provider(engine);
+}
@@ -1,8 +1,19 @@
 #include <mesh.hpp>
 
+#include <environment.hpp>
+
+#include <filament/Engine.h>
+#include <filament/Scene.h>
+#include <filament/VertexBuffer.h>
+#include <filament/IndexBuffer.h>
+#include <utils/EntityManager.h>
+
 Mesh::~Mesh()
 {
-    // This was very wrong
-    // free(m_vertex_buffer);
-    // free(m_index_buffer);
+    // the renderable goes first, it must never reference destroyed buffers
+    env->scene->remove(m_renderable);
+    env->engine->destroy(m_renderable);
+    futils::EntityManager::get().destroy(m_renderable);
+    env->engine->destroy(m_vertex_buffer);
+    env->engine->destroy(m_index_buffer);
 }
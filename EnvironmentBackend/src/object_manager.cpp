@@ -3,6 +3,8 @@
 #include "../environments.hpp"
 #include "filament_object_wrappers.hpp"
 #include <cstddef>
+#include <algorithm>
+#include <vector>
 
 #include <environment.hpp>
 #include <frame.hpp>
@@ -17,109 +19,128 @@ Object_Manager g_objm;
 
 Environment_ID Object_Manager::add_object(Environment* env)
 {
-    UUID id = g_objm.create_id();
-    auto ins = m_environments.insert({{id}, env});
-    assert(ins.second);
-    return {id};
+    return {m_environments.insert(env, ++m_creation_counter)};
 }
 
 Frame_ID Object_Manager::add_object(Frame* frame)
 {
-    UUID id = g_objm.create_id();
-    auto ins = m_frames.insert({{id}, frame});
-    assert(ins.second);
-    return {id};
+    return {m_frames.insert(frame, ++m_creation_counter)};
 }
 
 Camera_ID Object_Manager::add_object(Camera* camera)
 {
-    UUID id = g_objm.create_id();
-    auto ins = m_cameras.insert({{id}, camera});
-    assert(ins.second);
-    return {id};
+    return {m_cameras.insert(camera, ++m_creation_counter)};
 }
 
 Window_ID Object_Manager::add_object(Window* window)
 {
-    UUID id = g_objm.create_id();
-    auto ins = m_windows.insert({{id}, window});
-    assert(ins.second);
-    return {id};
+    return {m_windows.insert(window, ++m_creation_counter)};
 }
 
 Filament_Entity_ID Object_Manager::add_object(Filament_Entity filament_entity)
 {
-    UUID id = g_objm.create_id();
-    auto ins = m_filament_entities.insert({{id}, filament_entity});
-    assert(ins.second);
-    return {id};
+    return {m_filament_entities.insert(filament_entity, ++m_creation_counter)};
 }
 
 glTF_Instance_ID Object_Manager::add_object(glTF_Instance gltf_instance)
 {
-    UUID id = g_objm.create_id();
-    auto ins = m_gltf_instances.insert({{id}, gltf_instance});
-    assert(ins.second);
-    return {id};
+    return {m_gltf_instances.insert(gltf_instance, ++m_creation_counter)};
+}
+
+static const char* object_type_name(uint8_t tag)
+{
+    switch (tag) {
+        case OBJ_TAG_ENVIRONMENT:     return "Environment";
+        case OBJ_TAG_FRAME:           return "Frame";
+        case OBJ_TAG_CAMERA:          return "Camera";
+        case OBJ_TAG_WINDOW:          return "Window";
+        case OBJ_TAG_FILAMENT_ENTITY: return "Filament-Entity";
+        case OBJ_TAG_GLTF_INSTANCE:   return "glTF-Instance";
+        default:                      return "unknown object";
+    }
+}
+
+static void report_missing_object(uint64_t handle, uint8_t expected_tag)
+{
+    if (handle_tag(handle) != expected_tag) {
+        env_soft_error("Expected the id of a %s, but got the id %#llx of a %s.", object_type_name(expected_tag),
+                       (unsigned long long)handle, object_type_name(handle_tag(handle)));
+    }
+    else {
+        env_soft_error("Couldn't find the %s with id %#llx, it has been destroyed.", object_type_name(expected_tag),
+                       (unsigned long long)handle);
+    }
 }
 
 Environment* Object_Manager::get_object(Environment_ID id)
 {
-    auto itr = m_environments.find(id);
-    if (itr == m_environments.end()) {
-        env_soft_error("Couldn't find the Environment with id: %d", id.id);
+    Environment** env = m_environments.find(id.id);
+    if (!env) {
+        report_missing_object(id.id, OBJ_TAG_ENVIRONMENT);
         return nullptr;
     }
-    return itr.value();
+    return *env;
 }
 
 Frame* Object_Manager::get_object(Frame_ID id)
 {
-    auto itr = m_frames.find(id);
-    if (itr == m_frames.end()) {
-        env_soft_error("Couldn't find the Frame with id: %d", id.id);
+    Frame** frame = m_frames.find(id.id);
+    if (!frame) {
+        report_missing_object(id.id, OBJ_TAG_FRAME);
         return nullptr;
     }
-    return itr.value();
+    return *frame;
 }
 
 Camera* Object_Manager::get_object(Camera_ID id)
 {
-    auto itr = m_cameras.find(id);
-    if (itr == m_cameras.end()) {
-        env_soft_error("Couldn't find the Camera with id: %d", id.id);
+    Camera** camera = m_cameras.find(id.id);
+    if (!camera) {
+        report_missing_object(id.id, OBJ_TAG_CAMERA);
         return nullptr;
     }
-    return itr.value();
+    return *camera;
 }
 
 Window* Object_Manager::get_object(Window_ID id)
 {
-    auto itr = m_windows.find(id);
-    if (itr == m_windows.end()) {
-        env_soft_error("Couldn't find the Window with id: %d", id.id);
+    Window** window = m_windows.find(id.id);
+    if (!window) {
+        report_missing_object(id.id, OBJ_TAG_WINDOW);
         return nullptr;
     }
-    return itr.value();
+    return *window;
 }
 
 Filament_Entity Object_Manager::get_object(Filament_Entity_ID id) {
-    auto itr = m_filament_entities.find(id);
-    if (itr == m_filament_entities.end()) {
-        env_soft_error("Couldn't find the Filament-Entity with id: %d", id.id);
+    Filament_Entity* fentity = m_filament_entities.find(id.id);
+    if (!fentity) {
+        report_missing_object(id.id, OBJ_TAG_FILAMENT_ENTITY);
         return {};
     }
-    return itr.value();
+    return *fentity;
 }
 
 glTF_Instance Object_Manager::get_object(glTF_Instance_ID id)
 {
-    auto itr = m_gltf_instances.find(id);
-    if (itr == m_gltf_instances.end()) {
-        env_soft_error("Couldn't find the glTF-Instance with id: %d", id.id);
+    glTF_Instance* instance = m_gltf_instances.find(id.id);
+    if (!instance) {
+        report_missing_object(id.id, OBJ_TAG_GLTF_INSTANCE);
         return {};
     }
-    return itr.value();
+    return *instance;
+}
+
+template <typename T, uint8_t TAG>
+static void erase_objects_of_environment(Slot_Map<T, TAG>& map, Environment* env)
+{
+    // erase_slot() moves the last live slot into the erased position, which has been visited already
+    for (size_t i = map.live.size(); i > 0; --i) {
+        uint32_t slot_idx = map.live[i - 1];
+        if (map.slots[slot_idx].value.associated_env == env) {
+            map.erase_slot(slot_idx);
+        }
+    }
 }
 
 bool Object_Manager::destroy_object(Environment_ID id)
@@ -131,8 +152,13 @@ bool Object_Manager::destroy_object(Environment_ID id)
 
     Environment* env = get_object(id);
     if (!env) return false;
+
+    // everything in the environment goes with it, so their handles must turn stale as well
+    erase_objects_of_environment(m_filament_entities, env);
+    erase_objects_of_environment(m_gltf_instances, env);
+
     delete env;
-    m_environments.erase(id);
+    m_environments.erase(id.id);
     return true;
 }
 
@@ -141,7 +167,7 @@ bool Object_Manager::destroy_object(Frame_ID id)
     Frame* frame = get_object(id);
     if (!frame) return false;
     delete frame;
-    m_frames.erase(id);
+    m_frames.erase(id.id);
     return true;
 }
 
@@ -150,7 +176,7 @@ bool Object_Manager::destroy_object(Camera_ID id)
     Camera* camera = get_object(id);
     if (!camera) return false;
     delete camera;
-    m_cameras.erase(id);
+    m_cameras.erase(id.id);
     return true;
 }
 
@@ -164,32 +190,66 @@ bool Object_Manager::destroy_object(Window_ID id)
     Window* window = get_object(id);
     if (!window) return false;
     delete window;
-    m_windows.erase(id);
+    m_windows.erase(id.id);
     return true;
 }
 
+bool Object_Manager::destroy_object(Filament_Entity_ID id)
+{
+    Filament_Entity fentity = get_object(id);
+    if (!fentity.is_valid()) return false;
+    if (!environment_destroy_entity(fentity.associated_env, fentity.entity, id)) return false;
+    m_filament_entities.erase(id.id);
+    return true;
+}
+
+// The root entity of the instance has a handle of its own, it turns stale too.
+bool Object_Manager::destroy_object(glTF_Instance_ID id)
+{
+    glTF_Instance instance = get_object(id);
+    if (!instance.is_valid()) return false;
+    environment_destroy_gltf_instance(instance.associated_env, instance.gltf_instance, id);
+    m_filament_entities.erase(instance.root_entity_id.id);
+    m_gltf_instances.erase(id.id);
+    return true;
+}
+
+struct Live_Object {
+    uint64_t created_at;
+    uint64_t handle;
+};
+
+template <typename T, uint8_t TAG>
+static void collect_live_objects(const Slot_Map<T, TAG>& map, std::vector<Live_Object>& objects)
+{
+    for (uint32_t slot_idx : map.live) {
+        objects.push_back({map.slots[slot_idx].created_at, map.handle_of(slot_idx)});
+    }
+}
+
 bool Object_Manager::destroy_all_objects()
 {
-    // Destroy all objects in reverse order of creation.
-    // This is possible because the ids are 'sorted by creation' (next_id = prev_id + 1).
-    UUID current_max_id = get_current_max_id();
-    for (UUID uuid = current_max_id; uuid.id > m_guaranteed_invalid_ids_between_here_and_0.id; --uuid.id)
-    {
-        if (m_environments.find({uuid}) != m_environments.end()) { destroy_object(Environment_ID{uuid}); continue; }
-        if (m_frames.find({uuid}) != m_frames.end())             { destroy_object(Frame_ID{uuid}); continue; }
-        if (m_cameras.find({uuid}) != m_cameras.end())           { destroy_object(Camera_ID{uuid}); continue; }
-        if (m_windows.find({uuid}) != m_windows.end())           { destroy_object(Window_ID{uuid}); continue; }
+    // Destroy all objects in reverse order of creation, so everything is gone before what it was created from.
+    std::vector<Live_Object> objects;
+    objects.reserve(m_environments.size() + m_frames.size() + m_cameras.size() + m_windows.size());
+    collect_live_objects(m_environments, objects);
+    collect_live_objects(m_frames, objects);
+    collect_live_objects(m_cameras, objects);
+    collect_live_objects(m_windows, objects);
+    std::sort(objects.begin(), objects.end(), [](const Live_Object& a, const Live_Object& b) { return a.created_at > b.created_at; });
+
+    for (const Live_Object& object : objects) {
+        switch (handle_tag(object.handle)) {
+            case OBJ_TAG_ENVIRONMENT: destroy_object(Environment_ID{object.handle}); break;
+            case OBJ_TAG_FRAME:       destroy_object(Frame_ID{object.handle}); break;
+            case OBJ_TAG_CAMERA:      destroy_object(Camera_ID{object.handle}); break;
+            case OBJ_TAG_WINDOW:      destroy_object(Window_ID{object.handle}); break;
+        }
     }
 
-    m_environments.clear();
-    m_frames.clear();
-    m_cameras.clear();
-    m_windows.clear();
+    // the entities and instances are owned by their environment
     m_filament_entities.clear();
     m_gltf_instances.clear();
-    
-    // Since these ids got deleted they can't be used again. Therefore all previous ids guaranteed to be not in use.
-    m_guaranteed_invalid_ids_between_here_and_0 = current_max_id;
     return true;
 }
 
@@ -263,6 +323,8 @@ ENV_API bool destroy_environment(Environment_ID id)         { return g_objm.dest
 ENV_API bool destroy_frame(Frame_ID id)                     { return g_objm.destroy_object(id); }
 ENV_API bool destroy_camera(Camera_ID id)                   { return g_objm.destroy_object(id); }
 ENV_API bool destroy_window(Window_ID id)                   { return g_objm.destroy_object(id); }
+ENV_API bool destroy_filament_entity(Filament_Entity_ID id) { return g_objm.destroy_object(id); }
+ENV_API bool destroy_gltf_instance(glTF_Instance_ID id)     { return g_objm.destroy_object(id); }
 
 ENV_API bool destroy_everything() { return g_objm.destroy_all_objects(); }
 
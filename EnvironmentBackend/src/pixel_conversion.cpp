@@ -0,0 +1,343 @@
+#include <pixel_conversion.hpp>
+
+#include <logging.hpp>
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define ENV_PIXEL_CONVERSION_X86
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define ENV_PIXEL_CONVERSION_NEON
+#include <arm_neon.h>
+#endif
+
+/*
+ * Row kernels
+ *
+ * Every kernel converts 'n' RGBA8 pixels into the outputs, which are not nullptr.
+ * gray = (77 * r + 150 * g + 29 * b + 128) >> 8 is computed in integers, so all kernels agree exactly,
+ * chw  = value * scale + bias with scale = 1 / (255 * std) and bias = -mean / std.
+ */
+
+struct Row_Outputs {
+    uint8_t* rgba8;
+    uint8_t* gray8;
+    float* r;
+    float* g;
+    float* b;
+};
+
+static void convert_row_scalar(const uint8_t* rgba, uint32_t begin, uint32_t n, Row_Outputs out, const float* scale, const float* bias)
+{
+    for (uint32_t i = begin; i < n; ++i) {
+        uint32_t r = rgba[4 * i + 0];
+        uint32_t g = rgba[4 * i + 1];
+        uint32_t b = rgba[4 * i + 2];
+        if (out.gray8) {
+            out.gray8[i] = uint8_t((77 * r + 150 * g + 29 * b + 128) >> 8);
+        }
+        if (out.r) {
+            out.r[i] = float(r) * scale[0] + bias[0];
+            out.g[i] = float(g) * scale[1] + bias[1];
+            out.b[i] = float(b) * scale[2] + bias[2];
+        }
+    }
+}
+
+#ifdef ENV_PIXEL_CONVERSION_X86
+
+__attribute__((target("avx2")))
+static void convert_row_avx2(const uint8_t* rgba, uint32_t n, Row_Outputs out, const float* scale, const float* bias)
+{
+    const __m256i byte_mask = _mm256_set1_epi32(0xFF);
+    const __m256i c77 = _mm256_set1_epi32(77);
+    const __m256i c150 = _mm256_set1_epi32(150);
+    const __m256i c29 = _mm256_set1_epi32(29);
+    const __m256i c128 = _mm256_set1_epi32(128);
+    const __m256 scale_r = _mm256_set1_ps(scale[0]), bias_r = _mm256_set1_ps(bias[0]);
+    const __m256 scale_g = _mm256_set1_ps(scale[1]), bias_g = _mm256_set1_ps(bias[1]);
+    const __m256 scale_b = _mm256_set1_ps(scale[2]), bias_b = _mm256_set1_ps(bias[2]);
+
+    uint32_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i px = _mm256_loadu_si256((const __m256i*)(rgba + 4 * i));
+        __m256i r = _mm256_and_si256(px, byte_mask);
+        __m256i g = _mm256_and_si256(_mm256_srli_epi32(px, 8), byte_mask);
+        __m256i b = _mm256_and_si256(_mm256_srli_epi32(px, 16), byte_mask);
+
+        if (out.gray8) {
+            __m256i y = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(r, c77), _mm256_mullo_epi32(g, c150)),
+                                         _mm256_add_epi32(_mm256_mullo_epi32(b, c29), c128));
+            y = _mm256_srli_epi32(y, 8);
+            // packing works per 128 bit lane, the low 4 bytes of each lane hold our 8 values
+            __m256i y8 = _mm256_packus_epi16(_mm256_packus_epi32(y, y), _mm256_setzero_si256());
+            uint32_t lo = (uint32_t)_mm256_extract_epi32(y8, 0);
+            uint32_t hi = (uint32_t)_mm256_extract_epi32(y8, 4);
+            std::memcpy(out.gray8 + i, &lo, 4);
+            std::memcpy(out.gray8 + i + 4, &hi, 4);
+        }
+        if (out.r) {
+            _mm256_storeu_ps(out.r + i, _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(r), scale_r), bias_r));
+            _mm256_storeu_ps(out.g + i, _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(g), scale_g), bias_g));
+            _mm256_storeu_ps(out.b + i, _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(b), scale_b), bias_b));
+        }
+    }
+    convert_row_scalar(rgba, i, n, out, scale, bias);
+}
+
+// SSE2 has no 32 bit mullo, so the gray value is computed in 16 bit, which can't overflow: 256 * 255 + 128 < 2^16
+static void convert_row_sse2(const uint8_t* rgba, uint32_t n, Row_Outputs out, const float* scale, const float* bias)
+{
+    const __m128i byte_mask = _mm_set1_epi32(0xFF);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i c77 = _mm_set1_epi16(77);
+    const __m128i c150 = _mm_set1_epi16(150);
+    const __m128i c29 = _mm_set1_epi16(29);
+    const __m128i c128 = _mm_set1_epi16(128);
+    const __m128 scale_r = _mm_set1_ps(scale[0]), bias_r = _mm_set1_ps(bias[0]);
+    const __m128 scale_g = _mm_set1_ps(scale[1]), bias_g = _mm_set1_ps(bias[1]);
+    const __m128 scale_b = _mm_set1_ps(scale[2]), bias_b = _mm_set1_ps(bias[2]);
+
+    uint32_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i px_lo = _mm_loadu_si128((const __m128i*)(rgba + 4 * i));
+        __m128i px_hi = _mm_loadu_si128((const __m128i*)(rgba + 4 * i + 16));
+        __m128i r_lo = _mm_and_si128(px_lo, byte_mask);
+        __m128i r_hi = _mm_and_si128(px_hi, byte_mask);
+        __m128i g_lo = _mm_and_si128(_mm_srli_epi32(px_lo, 8), byte_mask);
+        __m128i g_hi = _mm_and_si128(_mm_srli_epi32(px_hi, 8), byte_mask);
+        __m128i b_lo = _mm_and_si128(_mm_srli_epi32(px_lo, 16), byte_mask);
+        __m128i b_hi = _mm_and_si128(_mm_srli_epi32(px_hi, 16), byte_mask);
+
+        if (out.gray8) {
+            __m128i r16 = _mm_packs_epi32(r_lo, r_hi);
+            __m128i g16 = _mm_packs_epi32(g_lo, g_hi);
+            __m128i b16 = _mm_packs_epi32(b_lo, b_hi);
+            __m128i y = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(r16, c77), _mm_mullo_epi16(g16, c150)),
+                                      _mm_add_epi16(_mm_mullo_epi16(b16, c29), c128));
+            y = _mm_srli_epi16(y, 8);
+            _mm_storel_epi64((__m128i*)(out.gray8 + i), _mm_packus_epi16(y, zero));
+        }
+        if (out.r) {
+            _mm_storeu_ps(out.r + i,     _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(r_lo), scale_r), bias_r));
+            _mm_storeu_ps(out.r + i + 4, _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(r_hi), scale_r), bias_r));
+            _mm_storeu_ps(out.g + i,     _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(g_lo), scale_g), bias_g));
+            _mm_storeu_ps(out.g + i + 4, _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(g_hi), scale_g), bias_g));
+            _mm_storeu_ps(out.b + i,     _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(b_lo), scale_b), bias_b));
+            _mm_storeu_ps(out.b + i + 4, _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(b_hi), scale_b), bias_b));
+        }
+    }
+    convert_row_scalar(rgba, i, n, out, scale, bias);
+}
+
+#endif // ENV_PIXEL_CONVERSION_X86
+
+#ifdef ENV_PIXEL_CONVERSION_NEON
+
+static inline float32x4_t neon_normalize(uint32x4_t v, float32x4_t scale, float32x4_t bias)
+{
+    return vmlaq_f32(bias, vcvtq_f32_u32(v), scale);
+}
+
+static void convert_row_neon(const uint8_t* rgba, uint32_t n, Row_Outputs out, const float* scale, const float* bias)
+{
+    const float32x4_t scale_r = vdupq_n_f32(scale[0]), bias_r = vdupq_n_f32(bias[0]);
+    const float32x4_t scale_g = vdupq_n_f32(scale[1]), bias_g = vdupq_n_f32(bias[1]);
+    const float32x4_t scale_b = vdupq_n_f32(scale[2]), bias_b = vdupq_n_f32(bias[2]);
+
+    uint32_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint8x8x4_t px = vld4_u8(rgba + 4 * i); // deinterleaves into r, g, b, a
+
+        if (out.gray8) {
+            uint16x8_t y = vmull_u8(px.val[0], vdup_n_u8(77));
+            y = vmlal_u8(y, px.val[1], vdup_n_u8(150));
+            y = vmlal_u8(y, px.val[2], vdup_n_u8(29));
+            y = vaddq_u16(y, vdupq_n_u16(128));
+            vst1_u8(out.gray8 + i, vshrn_n_u16(y, 8));
+        }
+        if (out.r) {
+            uint16x8_t r = vmovl_u8(px.val[0]);
+            uint16x8_t g = vmovl_u8(px.val[1]);
+            uint16x8_t b = vmovl_u8(px.val[2]);
+            vst1q_f32(out.r + i,     neon_normalize(vmovl_u16(vget_low_u16(r)), scale_r, bias_r));
+            vst1q_f32(out.r + i + 4, neon_normalize(vmovl_u16(vget_high_u16(r)), scale_r, bias_r));
+            vst1q_f32(out.g + i,     neon_normalize(vmovl_u16(vget_low_u16(g)), scale_g, bias_g));
+            vst1q_f32(out.g + i + 4, neon_normalize(vmovl_u16(vget_high_u16(g)), scale_g, bias_g));
+            vst1q_f32(out.b + i,     neon_normalize(vmovl_u16(vget_low_u16(b)), scale_b, bias_b));
+            vst1q_f32(out.b + i + 4, neon_normalize(vmovl_u16(vget_high_u16(b)), scale_b, bias_b));
+        }
+    }
+    convert_row_scalar(rgba, i, n, out, scale, bias);
+}
+
+#endif // ENV_PIXEL_CONVERSION_NEON
+
+typedef void (*Convert_Row_Func)(const uint8_t* rgba, uint32_t n, Row_Outputs out, const float* scale, const float* bias);
+
+#if !defined(ENV_PIXEL_CONVERSION_X86) && !defined(ENV_PIXEL_CONVERSION_NEON)
+static void convert_row_scalar_all(const uint8_t* rgba, uint32_t n, Row_Outputs out, const float* scale, const float* bias)
+{
+    convert_row_scalar(rgba, 0, n, out, scale, bias);
+}
+#endif
+
+static Convert_Row_Func select_row_kernel()
+{
+#if defined(ENV_PIXEL_CONVERSION_X86)
+    if (__builtin_cpu_supports("avx2")) return convert_row_avx2;
+    return convert_row_sse2; // SSE2 is always available on x86-64
+#elif defined(ENV_PIXEL_CONVERSION_NEON)
+    return convert_row_neon;
+#else
+    return convert_row_scalar_all;
+#endif
+}
+
+/*
+ * Downsampling
+ *
+ * Box filter over 'factor' x 'factor' source pixels, rounded as (sum + n / 2) / n. The common factor of 2
+ * sums the four bytes in 16 bit lanes, so the simd kernels match the scalar one exactly
+ * (nested rounding byte averages would round twice).
+ */
+
+static void downsample_row_scalar(const uint8_t* const* rows, uint32_t factor, uint32_t begin, uint32_t out_width, uint8_t* out)
+{
+    uint32_t n_samples = factor * factor;
+    for (uint32_t x = begin; x < out_width; ++x) {
+        for (uint32_t c = 0; c < 4; ++c) {
+            uint32_t sum = 0;
+            for (uint32_t dy = 0; dy < factor; ++dy) {
+                const uint8_t* px = rows[dy] + 4 * (x * factor);
+                for (uint32_t dx = 0; dx < factor; ++dx) {
+                    sum += px[4 * dx + c];
+                }
+            }
+            out[4 * x + c] = uint8_t((sum + n_samples / 2) / n_samples);
+        }
+    }
+}
+
+static void downsample_row_2x(const uint8_t* row0, const uint8_t* row1, uint32_t out_width, uint8_t* out)
+{
+    uint32_t x = 0;
+#if defined(ENV_PIXEL_CONVERSION_X86)
+    // 4 source pixels of both rows -> 2 output pixels
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i two = _mm_set1_epi16(2);
+    for (; x + 2 <= out_width; x += 2) {
+        __m128i top = _mm_loadu_si128((const __m128i*)(row0 + 8 * x));
+        __m128i bottom = _mm_loadu_si128((const __m128i*)(row1 + 8 * x));
+        // vertical sums of source pixels 0, 1 and 2, 3
+        __m128i sum01 = _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+        __m128i sum23 = _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
+        // horizontal sums end up in the low 64 bits
+        sum01 = _mm_add_epi16(sum01, _mm_srli_si128(sum01, 8));
+        sum23 = _mm_add_epi16(sum23, _mm_srli_si128(sum23, 8));
+        __m128i avg = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(sum01, sum23), two), 2);
+        _mm_storel_epi64((__m128i*)(out + 4 * x), _mm_packus_epi16(avg, zero));
+    }
+#elif defined(ENV_PIXEL_CONVERSION_NEON)
+    // 8 source pixels of both rows -> 4 output pixels
+    for (; x + 4 <= out_width; x += 4) {
+        // deinterleaves into the even and odd source pixels
+        uint32x4x2_t top = vld2q_u32((const uint32_t*)(row0 + 8 * x));
+        uint32x4x2_t bottom = vld2q_u32((const uint32_t*)(row1 + 8 * x));
+        uint8x16_t top_even = vreinterpretq_u8_u32(top.val[0]), top_odd = vreinterpretq_u8_u32(top.val[1]);
+        uint8x16_t bottom_even = vreinterpretq_u8_u32(bottom.val[0]), bottom_odd = vreinterpretq_u8_u32(bottom.val[1]);
+        uint16x8_t sum_lo = vaddl_u8(vget_low_u8(top_even), vget_low_u8(top_odd));
+        sum_lo = vaddw_u8(sum_lo, vget_low_u8(bottom_even));
+        sum_lo = vaddw_u8(sum_lo, vget_low_u8(bottom_odd));
+        uint16x8_t sum_hi = vaddl_u8(vget_high_u8(top_even), vget_high_u8(top_odd));
+        sum_hi = vaddw_u8(sum_hi, vget_high_u8(bottom_even));
+        sum_hi = vaddw_u8(sum_hi, vget_high_u8(bottom_odd));
+        // rounding narrowing shift: (sum + 2) >> 2
+        vst1q_u8(out + 4 * x, vcombine_u8(vrshrn_n_u16(sum_lo, 2), vrshrn_n_u16(sum_hi, 2)));
+    }
+#endif
+    const uint8_t* rows[2] = {row0, row1};
+    downsample_row_scalar(rows, 2, x, out_width, out);
+}
+
+bool pixel_conversion_settings_valid(const Pixel_Conversion_Settings& settings)
+{
+    if (settings.outputs == 0 || (settings.outputs & ~uint32_t(PIXEL_OUTPUT_RGBA8 | PIXEL_OUTPUT_GRAY8 | PIXEL_OUTPUT_CHW_FLOAT32))) {
+        env_soft_error("Invalid pixel conversion outputs '%u'.", settings.outputs);
+        return false;
+    }
+    if (settings.downsample_factor == 0 || settings.downsample_factor > ENV_MAX_DOWNSAMPLE_FACTOR) {
+        env_soft_error("The downsample factor must be in [1, %d], got '%u'.", ENV_MAX_DOWNSAMPLE_FACTOR, settings.downsample_factor);
+        return false;
+    }
+    if ((settings.outputs & PIXEL_OUTPUT_CHW_FLOAT32)
+        && (settings.std[0] == 0.0f || settings.std[1] == 0.0f || settings.std[2] == 0.0f)) {
+        env_soft_error("The standard deviations for the pixel normalization can't be zero.");
+        return false;
+    }
+    return true;
+}
+
+void convert_pixels(Pixel_Conversion* conversion, const uint8_t* rgba8, uint32_t width, uint32_t height)
+{
+    static const Convert_Row_Func convert_row = select_row_kernel();
+
+    const Pixel_Conversion_Settings& settings = conversion->settings;
+    uint32_t factor = settings.downsample_factor;
+    uint32_t out_width = width / factor;
+    uint32_t out_height = height / factor;
+    size_t n_out_pixels = size_t(out_width) * size_t(out_height);
+
+    if (settings.outputs & PIXEL_OUTPUT_RGBA8) conversion->rgba8.resize(4 * n_out_pixels);
+    if (settings.outputs & PIXEL_OUTPUT_GRAY8) conversion->gray8.resize(n_out_pixels);
+    if (settings.outputs & PIXEL_OUTPUT_CHW_FLOAT32) conversion->chw_float32.resize(3 * n_out_pixels);
+    if (factor > 1) conversion->downsampled_row.resize(4 * size_t(out_width));
+
+    float scale[3];
+    float bias[3];
+    for (int c = 0; c < 3; ++c) {
+        scale[c] = 1.0f / (255.0f * settings.std[c]);
+        bias[c] = -settings.mean[c] / settings.std[c];
+    }
+
+    const uint8_t* rows[ENV_MAX_DOWNSAMPLE_FACTOR];
+    for (uint32_t y = 0; y < out_height; ++y) {
+        // the gpu delivers the image bottom up
+        uint32_t src_y = (settings.flip_vertical ? out_height - 1 - y : y) * factor;
+
+        const uint8_t* src_row = rgba8 + 4 * size_t(src_y) * width;
+        if (factor == 2) {
+            downsample_row_2x(src_row, src_row + 4 * size_t(width), out_width, conversion->downsampled_row.data());
+            src_row = conversion->downsampled_row.data();
+        }
+        else if (factor > 2) {
+            for (uint32_t dy = 0; dy < factor; ++dy) {
+                rows[dy] = src_row + 4 * size_t(dy) * width;
+            }
+            downsample_row_scalar(rows, factor, 0, out_width, conversion->downsampled_row.data());
+            src_row = conversion->downsampled_row.data();
+        }
+
+        size_t out_offset = size_t(y) * out_width;
+        if (settings.outputs & PIXEL_OUTPUT_RGBA8) {
+            std::memcpy(conversion->rgba8.data() + 4 * out_offset, src_row, 4 * size_t(out_width));
+        }
+
+        Row_Outputs out = {};
+        if (settings.outputs & PIXEL_OUTPUT_GRAY8) {
+            out.gray8 = conversion->gray8.data() + out_offset;
+        }
+        if (settings.outputs & PIXEL_OUTPUT_CHW_FLOAT32) {
+            out.r = conversion->chw_float32.data() + out_offset;
+            out.g = out.r + n_out_pixels;
+            out.b = out.g + n_out_pixels;
+        }
+        if (out.gray8 || out.r) {
+            convert_row(src_row, out_width, out, scale, bias);
+        }
+    }
+
+    conversion->width = out_width;
+    conversion->height = out_height;
+}
@@ -0,0 +1,204 @@
+#include "../environments.hpp"
+#include <point_cloud.hpp>
+
+#include <environment.hpp>
+#include <engine_context.hpp>
+#include <object_manager.hpp>
+#include <renderable_buffers.hpp>
+#include <logging.hpp>
+
+#include <filament/Box.h>
+#include <filament/Engine.h>
+#include <filament/Material.h>
+#include <filament/MaterialInstance.h>
+#include <filament/Scene.h>
+#include <filament/RenderableManager.h>
+#include <filament/VertexBuffer.h>
+#include <filament/IndexBuffer.h>
+#include <utils/EntityManager.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+static bool create_point_cloud_buffers(Environment* env, Point_Cloud* point_cloud, uint32_t capacity)
+{
+    for (Point_Cloud_Buffer& buffer : point_cloud->buffers) {
+        buffer.vertex_buffer = fmt::VertexBuffer::Builder()
+            .vertexCount(capacity)
+            .bufferCount(2)
+            .attribute(fmt::VertexAttribute::POSITION, 0, fmt::VertexBuffer::AttributeType::FLOAT3)
+            .attribute(fmt::VertexAttribute::COLOR, 1, fmt::VertexBuffer::AttributeType::UBYTE4)
+            .normalized(fmt::VertexAttribute::COLOR)
+            .build(*env->engine);
+        buffer.n_default_colors = 0;
+    }
+
+    point_cloud->index_buffer = fmt::IndexBuffer::Builder()
+        .indexCount(capacity)
+        .bufferType(fmt::IndexBuffer::IndexType::UINT)
+        .build(*env->engine);
+
+    if (!point_cloud->buffers[0].vertex_buffer || !point_cloud->buffers[1].vertex_buffer || !point_cloud->index_buffer) {
+        return false;
+    }
+
+    set_sequential_indices(env->engine, point_cloud->index_buffer, capacity);
+    point_cloud->capacity = capacity;
+    return true;
+}
+
+static void destroy_point_cloud_buffers(Environment* env, Point_Cloud* point_cloud)
+{
+    for (Point_Cloud_Buffer& buffer : point_cloud->buffers) {
+        if (buffer.vertex_buffer) env->engine->destroy(buffer.vertex_buffer);
+        buffer.vertex_buffer = nullptr;
+    }
+    if (point_cloud->index_buffer) env->engine->destroy(point_cloud->index_buffer);
+    point_cloud->index_buffer = nullptr;
+}
+
+Filament_Entity_ID add_pointcloud(uint32_t capacity, float3 default_color)
+{
+    Environment* env = g_objm.get_active_environment();
+    if (!env) return {ENV_INVALID_UUID};
+
+    if (capacity == 0) {
+        env_soft_error("A point cloud needs a capacity of at least 1 point.");
+        return {ENV_INVALID_UUID};
+    }
+
+    Point_Cloud* point_cloud = new Point_Cloud;
+    point_cloud->default_color = pack_color(default_color);
+    if (!create_point_cloud_buffers(env, point_cloud, capacity)) {
+        env_soft_error("Failed to create the buffers of a point cloud with %u points.", capacity);
+        destroy_point_cloud_buffers(env, point_cloud);
+        delete point_cloud;
+        return {ENV_INVALID_UUID};
+    }
+    point_cloud->material = env->ctx->vertex_color_material->createInstance();
+
+    point_cloud->entity = utils::EntityManager::get().create();
+    fmt::RenderableManager::Builder(1)
+        .boundingBox({{0, 0, 0}, {0, 0, 0}})
+        .material(0, point_cloud->material)
+        .geometry(0, fmt::RenderableManager::PrimitiveType::POINTS,
+                  point_cloud->buffers[0].vertex_buffer, point_cloud->index_buffer, 0, 0)
+        .receiveShadows(false)
+        .castShadows(false)
+        .build(*env->engine, point_cloud->entity);
+
+    env->scene->addEntity(point_cloud->entity);
+    env->point_clouds[point_cloud->entity.getId()] = point_cloud;
+
+    Filament_Entity_ID fentity_id = g_objm.add_object({point_cloud->entity, env});
+    segmentation_register(env, &point_cloud->entity, 1, fentity_id, {ENV_INVALID_UUID});
+    return fentity_id;
+}
+
+// Both buffers are replaced, the next update fills the back buffer as usual.
+static bool grow_point_cloud(Environment* env, Point_Cloud* point_cloud, uint32_t min_capacity)
+{
+    Point_Cloud old_buffers;
+    old_buffers.buffers[0] = point_cloud->buffers[0];
+    old_buffers.buffers[1] = point_cloud->buffers[1];
+    old_buffers.index_buffer = point_cloud->index_buffer;
+    uint32_t old_capacity = point_cloud->capacity;
+
+    uint32_t new_capacity = grow_capacity(point_cloud->capacity, min_capacity);
+    if (!create_point_cloud_buffers(env, point_cloud, new_capacity)) {
+        env_soft_error("Failed to grow the point cloud to %u points.", new_capacity);
+        destroy_point_cloud_buffers(env, point_cloud);
+        point_cloud->buffers[0] = old_buffers.buffers[0];
+        point_cloud->buffers[1] = old_buffers.buffers[1];
+        point_cloud->index_buffer = old_buffers.index_buffer;
+        point_cloud->capacity = old_capacity;
+        return false;
+    }
+
+    set_renderable_geometry(env->engine, point_cloud->entity, fmt::RenderableManager::PrimitiveType::POINTS,
+                            point_cloud->buffers[point_cloud->front].vertex_buffer, point_cloud->index_buffer);
+    destroy_point_cloud_buffers(env, &old_buffers);
+    point_cloud->n_points = 0;
+    return true;
+}
+
+static void upload_copy(Environment* env, fmt::VertexBuffer* vertex_buffer, uint8_t buffer_index,
+                        const void* src, size_t size, uint32_t byte_offset)
+{
+    void* data = malloc(size);
+    if (!data) env_hard_error(ENV_ERR_MEM_ALLOC);
+    std::memcpy(data, src, size);
+    vertex_buffer->setBufferAt(*env->engine, buffer_index,
+        fmt::VertexBuffer::BufferDescriptor(data, size, free_buffer_callback), byte_offset);
+}
+
+// Replaces all points of the cloud. Without 'rgba' the points get the default color of the cloud.
+bool pointcloud_update(Filament_Entity_ID id, const float3* points, const uint32_t* rgba, uint32_t n)
+{
+    Filament_Entity fentity = g_objm.get_object(id);
+    if (!fentity.is_valid()) return false;
+
+    Environment* env = fentity.associated_env;
+    auto itr = env->point_clouds.find(fentity.entity.getId());
+    if (itr == env->point_clouds.end()) {
+        env_soft_error("The Filament-Entity with id %#llx is not a point cloud.", (unsigned long long)id.id);
+        return false;
+    }
+    Point_Cloud* point_cloud = itr->second;
+
+    if (n > point_cloud->capacity && !grow_point_cloud(env, point_cloud, n)) return false;
+
+    uint32_t back = 1 - point_cloud->front;
+    Point_Cloud_Buffer& buffer = point_cloud->buffers[back];
+
+    fmath::float3 aabb_min = {INFINITY, INFINITY, INFINITY};
+    fmath::float3 aabb_max = {-INFINITY, -INFINITY, -INFINITY};
+    if (n > 0) {
+        static_assert(sizeof(float3) == sizeof(fmath::float3));
+        upload_copy(env, buffer.vertex_buffer, 0, points, n * sizeof(float3), 0);
+        for (uint32_t i = 0; i < n; ++i) {
+            fmath::float3 p = f3_to_ff3(points[i]);
+            aabb_min = min(aabb_min, p);
+            aabb_max = max(aabb_max, p);
+        }
+
+        if (rgba) {
+            upload_copy(env, buffer.vertex_buffer, 1, rgba, n * sizeof(uint32_t), 0);
+            buffer.n_default_colors = 0;
+        }
+        else if (buffer.n_default_colors < n) {
+            // the default colors stay in the buffer, only the missing ones are uploaded
+            uint32_t n_missing = n - buffer.n_default_colors;
+            uint32_t* colors = (uint32_t*)malloc(n_missing * sizeof(uint32_t));
+            if (!colors) env_hard_error(ENV_ERR_MEM_ALLOC);
+            std::fill_n(colors, n_missing, point_cloud->default_color);
+            buffer.vertex_buffer->setBufferAt(*env->engine, 1,
+                fmt::VertexBuffer::BufferDescriptor(colors, n_missing * sizeof(uint32_t), free_buffer_callback),
+                uint32_t(buffer.n_default_colors * sizeof(uint32_t)));
+            buffer.n_default_colors = n;
+        }
+    }
+
+    fmt::RenderableManager& rm = env->engine->getRenderableManager();
+    auto ri = rm.getInstance(point_cloud->entity);
+    rm.setGeometryAt(ri, 0, fmt::RenderableManager::PrimitiveType::POINTS,
+                     buffer.vertex_buffer, point_cloud->index_buffer, 0, n);
+    if (n > 0) {
+        rm.setAxisAlignedBoundingBox(ri, fmt::Box().set(aabb_min, aabb_max));
+    }
+    point_cloud->front = back;
+    point_cloud->n_points = n;
+    return true;
+}
+
+void point_cloud_destroy(Environment* env, Point_Cloud* point_cloud)
+{
+    env->scene->remove(point_cloud->entity);
+    env->engine->destroy(point_cloud->entity);
+    utils::EntityManager::get().destroy(point_cloud->entity);
+    destroy_point_cloud_buffers(env, point_cloud);
+    env->engine->destroy(point_cloud->material);
+    delete point_cloud;
+}
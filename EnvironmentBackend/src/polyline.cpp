@@ -0,0 +1,251 @@
+#include "../environments.hpp"
+#include <polyline.hpp>
+
+#include <environment.hpp>
+#include <object_manager.hpp>
+#include <renderable_buffers.hpp>
+#include <logging.hpp>
+
+#include <filament/Box.h>
+#include <filament/Engine.h>
+#include <filament/MaterialInstance.h>
+#include <filament/Scene.h>
+#include <filament/RenderableManager.h>
+#include <filament/VertexBuffer.h>
+#include <filament/IndexBuffer.h>
+#include <utils/EntityManager.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+static bool create_polyline_buffers(Environment* env, Polyline* polyline)
+{
+    uint32_t capacity = polyline->ring.capacity;
+
+    polyline->vertex_buffer = fmt::VertexBuffer::Builder()
+        .vertexCount(capacity)
+        .bufferCount(1)
+        .attribute(fmt::VertexAttribute::POSITION, 0, fmt::VertexBuffer::AttributeType::FLOAT3)
+        .build(*env->engine);
+
+    uint32_t n_indices = polyline_index_count(capacity);
+    polyline->index_buffer = fmt::IndexBuffer::Builder()
+        .indexCount(n_indices)
+        .bufferType(fmt::IndexBuffer::IndexType::UINT)
+        .build(*env->engine);
+
+    if (!polyline->vertex_buffer || !polyline->index_buffer) return false;
+
+    uint32_t* indices = (uint32_t*)malloc(n_indices * sizeof(uint32_t));
+    if (!indices) env_hard_error(ENV_ERR_MEM_ALLOC);
+    polyline_fill_indices(indices, capacity);
+    polyline->index_buffer->setBuffer(*env->engine, fmt::IndexBuffer::BufferDescriptor(
+        indices, n_indices * sizeof(uint32_t), free_buffer_callback));
+    return true;
+}
+
+static void destroy_polyline_buffers(Environment* env, Polyline* polyline)
+{
+    if (polyline->vertex_buffer) env->engine->destroy(polyline->vertex_buffer);
+    if (polyline->index_buffer) env->engine->destroy(polyline->index_buffer);
+    polyline->vertex_buffer = nullptr;
+    polyline->index_buffer = nullptr;
+}
+
+Filament_Entity_ID add_polyline(const char* material_name, uint32_t capacity, bool ring_buffer)
+{
+    Environment* env = g_objm.get_active_environment();
+    if (!env) return {ENV_INVALID_UUID};
+
+    if (capacity < 2 || capacity > ENV_POLYLINE_MAX_CAPACITY) {
+        env_soft_error("A polyline needs a capacity of 2 to %u points, got %u.", ENV_POLYLINE_MAX_CAPACITY, capacity);
+        return {ENV_INVALID_UUID};
+    }
+    fmt::MaterialInstance* material = env->material_registry.getMaterialInstance(utils::CString(material_name));
+    if (!material) {
+        env_soft_error("Couldn't find the material '%s'.", material_name);
+        return {ENV_INVALID_UUID};
+    }
+
+    Polyline* polyline = new Polyline;
+    polyline->ring.capacity = capacity;
+    polyline->ring_buffer = ring_buffer;
+    polyline->points.resize(capacity);
+    if (!create_polyline_buffers(env, polyline)) {
+        env_soft_error("Failed to create the buffers of a polyline with %u points.", capacity);
+        destroy_polyline_buffers(env, polyline);
+        delete polyline;
+        return {ENV_INVALID_UUID};
+    }
+
+    polyline->entity = utils::EntityManager::get().create();
+    fmt::RenderableManager::Builder(1)
+        .boundingBox({{0, 0, 0}, {0, 0, 0}})
+        .material(0, material)
+        .geometry(0, fmt::RenderableManager::PrimitiveType::LINES,
+                  polyline->vertex_buffer, polyline->index_buffer, 0, 0)
+        .receiveShadows(false)
+        .castShadows(false)
+        .build(*env->engine, polyline->entity);
+
+    env->scene->addEntity(polyline->entity);
+    env->polylines[polyline->entity.getId()] = polyline;
+
+    Filament_Entity_ID fentity_id = g_objm.add_object({polyline->entity, env});
+    segmentation_register(env, &polyline->entity, 1, fentity_id, {ENV_INVALID_UUID});
+    return fentity_id;
+}
+
+static Polyline* get_polyline(Filament_Entity_ID id, Environment** env)
+{
+    Filament_Entity fentity = g_objm.get_object(id);
+    if (!fentity.is_valid()) return nullptr;
+
+    auto itr = fentity.associated_env->polylines.find(fentity.entity.getId());
+    if (itr == fentity.associated_env->polylines.end()) {
+        env_soft_error("The Filament-Entity with id %#llx is not a polyline.", (unsigned long long)id.id);
+        return nullptr;
+    }
+    *env = fentity.associated_env;
+    return itr->second;
+}
+
+// Only growing polylines call this, their points always start at slot 0.
+static bool grow_polyline(Environment* env, Polyline* polyline, uint32_t min_capacity)
+{
+    Polyline old_buffers;
+    old_buffers.vertex_buffer = polyline->vertex_buffer;
+    old_buffers.index_buffer = polyline->index_buffer;
+    uint32_t old_capacity = polyline->ring.capacity;
+
+    uint32_t new_capacity = std::min(grow_capacity(old_capacity, min_capacity), uint32_t(ENV_POLYLINE_MAX_CAPACITY));
+    polyline->ring.capacity = new_capacity;
+    if (!create_polyline_buffers(env, polyline)) {
+        env_soft_error("Failed to grow the polyline to %u points.", new_capacity);
+        destroy_polyline_buffers(env, polyline);
+        polyline->vertex_buffer = old_buffers.vertex_buffer;
+        polyline->index_buffer = old_buffers.index_buffer;
+        polyline->ring.capacity = old_capacity;
+        return false;
+    }
+    polyline->points.resize(new_capacity);
+    polyline_ring_grow(&polyline->ring, new_capacity);
+
+    set_renderable_geometry(env->engine, polyline->entity, fmt::RenderableManager::PrimitiveType::LINES,
+                            polyline->vertex_buffer, polyline->index_buffer);
+    destroy_polyline_buffers(env, &old_buffers);
+    polyline->range_changed = true;
+    return true;
+}
+
+bool polyline_append_points(Filament_Entity_ID id, const double3* points, uint32_t n)
+{
+    Environment* env;
+    Polyline* polyline = get_polyline(id, &env);
+    if (!polyline) return false;
+    if (n == 0) return true;
+
+    Polyline_Ring* ring = &polyline->ring;
+    if (!polyline->ring_buffer && uint64_t(ring->n_points) + n > ring->capacity) {
+        if (uint64_t(ring->n_points) + n > ENV_POLYLINE_MAX_CAPACITY) {
+            env_soft_error("A polyline can't hold more than %u points.", ENV_POLYLINE_MAX_CAPACITY);
+            return false;
+        }
+        if (!grow_polyline(env, polyline, ring->n_points + n)) return false;
+    }
+
+    // In ring buffer mode only the last 'capacity' of the new points can survive.
+    if (n > ring->capacity) {
+        points += n - ring->capacity;
+        n = ring->capacity;
+    }
+
+    uint32_t n_overwritten = 0;
+    uint32_t first_slot = polyline_ring_push(ring, n, &n_overwritten);
+    for (uint32_t i = 0; i < n; ++i) {
+        fmath::float3 p = {float(points[i].x), float(points[i].y), float(points[i].z)};
+        polyline->points[(first_slot + i) % ring->capacity] = p;
+        polyline->aabb_min = min(polyline->aabb_min, p);
+        polyline->aabb_max = max(polyline->aabb_max, p);
+    }
+    // the overwritten points may have been the extremes, the box is rebuilt before the next render
+    if (n_overwritten > 0) polyline->aabb_stale = true;
+    polyline->range_changed = true;
+    return true;
+}
+
+bool polyline_clear(Filament_Entity_ID id)
+{
+    Environment* env;
+    Polyline* polyline = get_polyline(id, &env);
+    if (!polyline) return false;
+
+    polyline_ring_clear(&polyline->ring);
+    polyline->range_changed = true;
+    polyline->aabb_min = {INFINITY, INFINITY, INFINITY};
+    polyline->aabb_max = {-INFINITY, -INFINITY, -INFINITY};
+    polyline->aabb_stale = false;
+    return true;
+}
+
+static void recompute_polyline_aabb(Polyline* polyline)
+{
+    polyline->aabb_min = {INFINITY, INFINITY, INFINITY};
+    polyline->aabb_max = {-INFINITY, -INFINITY, -INFINITY};
+    for (uint32_t i = 0; i < polyline->ring.n_points; ++i) {
+        const fmath::float3& p = polyline->points[polyline_ring_slot(polyline->ring, i)];
+        polyline->aabb_min = min(polyline->aabb_min, p);
+        polyline->aabb_max = max(polyline->aabb_max, p);
+    }
+    polyline->aabb_stale = false;
+}
+
+static void upload_points(Environment* env, Polyline* polyline, uint32_t first, uint32_t count)
+{
+    size_t size = count * sizeof(fmath::float3);
+    void* data = malloc(size);
+    if (!data) env_hard_error(ENV_ERR_MEM_ALLOC);
+    std::memcpy(data, polyline->points.data() + first, size);
+
+    polyline->vertex_buffer->setBufferAt(*env->engine, 0,
+        fmt::VertexBuffer::BufferDescriptor(data, size, free_buffer_callback),
+        uint32_t(first * sizeof(fmath::float3)));
+}
+
+void polylines_upload(Environment* env)
+{
+    fmt::RenderableManager& rm = env->engine->getRenderableManager();
+
+    for (auto& [entity_id, polyline] : env->polylines) {
+        Polyline_Dirty_Runs runs = polyline_ring_dirty_runs(polyline->ring);
+        for (uint32_t r = 0; r < runs.n_runs; ++r) {
+            upload_points(env, polyline, runs.first[r], runs.count[r]);
+        }
+        polyline->ring.n_dirty = 0;
+
+        if (polyline->range_changed) {
+            if (polyline->aabb_stale) {
+                recompute_polyline_aabb(polyline);
+            }
+            auto ri = rm.getInstance(polyline->entity);
+            uint32_t first_index, n_indices;
+            polyline_ring_index_range(polyline->ring, &first_index, &n_indices);
+            rm.setGeometryAt(ri, 0, fmt::RenderableManager::PrimitiveType::LINES,
+                             polyline->vertex_buffer, polyline->index_buffer, first_index, n_indices);
+            if (n_indices > 0) {
+                rm.setAxisAlignedBoundingBox(ri, fmt::Box().set(polyline->aabb_min, polyline->aabb_max));
+            }
+            polyline->range_changed = false;
+        }
+    }
+}
+
+void polyline_destroy(Environment* env, Polyline* polyline)
+{
+    env->scene->remove(polyline->entity);
+    env->engine->destroy(polyline->entity);
+    utils::EntityManager::get().destroy(polyline->entity);
+    destroy_polyline_buffers(env, polyline);
+    delete polyline;
+}
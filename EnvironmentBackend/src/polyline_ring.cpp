@@ -0,0 +1,67 @@
+#include <polyline_ring.hpp>
+
+#include <algorithm>
+
+void polyline_fill_indices(uint32_t* indices, uint32_t capacity)
+{
+    for (uint32_t k = 0; k < 2 * capacity; ++k) {
+        indices[2 * k + 0] = k % capacity;
+        indices[2 * k + 1] = (k + 1) % capacity;
+    }
+}
+
+uint32_t polyline_ring_push(Polyline_Ring* ring, uint32_t n, uint32_t* n_overwritten)
+{
+    uint32_t first_slot = (ring->head + ring->n_points) % ring->capacity;
+    if (ring->n_dirty == 0) {
+        ring->dirty_first = first_slot;
+    }
+
+    uint32_t n_free = ring->capacity - ring->n_points;
+    *n_overwritten = n > n_free ? n - n_free : 0;
+    ring->n_points += n - *n_overwritten;
+    ring->head = (ring->head + *n_overwritten) % ring->capacity;
+
+    ring->n_dirty = std::min(ring->n_dirty + n, ring->capacity);
+    if (ring->n_dirty == ring->capacity) {
+        ring->dirty_first = ring->head;
+    }
+    return first_slot;
+}
+
+void polyline_ring_grow(Polyline_Ring* ring, uint32_t new_capacity)
+{
+    ring->capacity = new_capacity;
+    ring->dirty_first = 0;
+    ring->n_dirty = ring->n_points;
+}
+
+void polyline_ring_clear(Polyline_Ring* ring)
+{
+    ring->head = 0;
+    ring->n_points = 0;
+    ring->n_dirty = 0;
+}
+
+Polyline_Dirty_Runs polyline_ring_dirty_runs(const Polyline_Ring& ring)
+{
+    Polyline_Dirty_Runs runs = {};
+    if (ring.n_dirty == 0) return runs;
+
+    runs.first[0] = ring.dirty_first;
+    runs.count[0] = std::min(ring.n_dirty, ring.capacity - ring.dirty_first);
+    runs.n_runs = 1;
+    if (runs.count[0] < ring.n_dirty) {
+        runs.first[1] = 0;
+        runs.count[1] = ring.n_dirty - runs.count[0];
+        runs.n_runs = 2;
+    }
+    return runs;
+}
+
+void polyline_ring_index_range(const Polyline_Ring& ring, uint32_t* first_index, uint32_t* n_indices)
+{
+    uint32_t n_segments = ring.n_points > 1 ? ring.n_points - 1 : 0;
+    *first_index = 2 * ring.head;
+    *n_indices = 2 * n_segments;
+}
@@ -0,0 +1,128 @@
+#include <primitive_mesh.hpp>
+
+#include <math.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+// Degenerate triangles (at the poles) are dropped, the others are wound counter-clockwise
+// when looking against the vertex normals.
+static void add_triangle(Mesh_Data* mesh, uint32_t a, uint32_t b, uint32_t c)
+{
+    fmath::float3 face_normal = cross(mesh->positions[b] - mesh->positions[a], mesh->positions[c] - mesh->positions[a]);
+    if (dot(face_normal, face_normal) < 1e-12f) return;
+
+    fmath::float3 vertex_normal = mesh->normals[a] + mesh->normals[b] + mesh->normals[c];
+    if (dot(face_normal, vertex_normal) < 0.0f) std::swap(b, c);
+    mesh->indices.insert(mesh->indices.end(), {a, b, c});
+}
+
+// Sweeps the profile, points (radius, y) with their normals (radial, y), once around the y axis.
+static void add_surface_of_revolution(Mesh_Data* mesh, const fmath::float2* profile, const fmath::float2* profile_normals,
+                                      uint32_t n_profile, uint32_t segments)
+{
+    uint32_t first = uint32_t(mesh->positions.size());
+    for (uint32_t i = 0; i < n_profile; ++i) {
+        for (uint32_t s = 0; s <= segments; ++s) {
+            float angle = float(2.0 * PI * s / segments);
+            float c = std::cos(angle), si = std::sin(angle);
+            mesh->positions.push_back({profile[i].x * c, profile[i].y, profile[i].x * si});
+            mesh->normals.push_back(normalize(fmath::float3{profile_normals[i].x * c, profile_normals[i].y, profile_normals[i].x * si}));
+        }
+    }
+    for (uint32_t i = 0; i + 1 < n_profile; ++i) {
+        for (uint32_t s = 0; s < segments; ++s) {
+            uint32_t a = first + i * (segments + 1) + s;
+            uint32_t b = a + 1;
+            uint32_t c = a + segments + 1;
+            uint32_t d = c + 1;
+            add_triangle(mesh, a, b, c);
+            add_triangle(mesh, b, d, c);
+        }
+    }
+}
+
+// A flat disk at height 'y', facing 'normal_y' (+1 or -1).
+static void add_disk(Mesh_Data* mesh, float y, float normal_y, uint32_t segments)
+{
+    fmath::float2 profile[2] = {{0.0f, y}, {0.5f, y}};
+    fmath::float2 normals[2] = {{0.0f, normal_y}, {0.0f, normal_y}};
+    add_surface_of_revolution(mesh, profile, normals, 2, segments);
+}
+
+// Rings of the sphere from 'first_ring' to 'last_ring', where ring 0 is the bottom pole and ring 'n_rings' the top one.
+static void add_sphere_rings(Mesh_Data* mesh, uint32_t first_ring, uint32_t last_ring, uint32_t n_rings, uint32_t segments)
+{
+    std::vector<fmath::float2> profile;
+    for (uint32_t r = first_ring; r <= last_ring; ++r) {
+        double polar = PI * r / n_rings - PI * 0.5;
+        profile.push_back({float(std::cos(polar)), float(std::sin(polar))});
+    }
+    std::vector<fmath::float2> positions(profile.size());
+    for (size_t i = 0; i < profile.size(); ++i) {
+        positions[i] = profile[i] * 0.5f;
+    }
+    add_surface_of_revolution(mesh, positions.data(), profile.data(), uint32_t(profile.size()), segments);
+}
+
+Mesh_Data build_primitive_mesh(Primitive_Geometry_Kind kind, uint32_t segments)
+{
+    Mesh_Data mesh;
+    switch (kind) {
+        case PRIMITIVE_GEOMETRY_PLANE: {
+            mesh.positions = {{-0.5f, 0, -0.5f}, {-0.5f, 0, 0.5f}, {0.5f, 0, 0.5f}, {0.5f, 0, -0.5f}};
+            mesh.normals.assign(4, {0, 1, 0});
+            add_triangle(&mesh, 0, 1, 2);
+            add_triangle(&mesh, 2, 3, 0);
+        } break;
+
+        case PRIMITIVE_GEOMETRY_BOX: {
+            // four vertices per face, so that every face has its own normal
+            for (int axis = 0; axis < 3; ++axis) {
+                for (float side : {-1.0f, 1.0f}) {
+                    fmath::float3 n = {0, 0, 0};
+                    n[axis] = side;
+                    fmath::float3 u = {0, 0, 0};
+                    u[(axis + 1) % 3] = 0.5f;
+                    fmath::float3 v = {0, 0, 0};
+                    v[(axis + 2) % 3] = 0.5f;
+
+                    uint32_t first = uint32_t(mesh.positions.size());
+                    fmath::float3 center = n * 0.5f;
+                    mesh.positions.insert(mesh.positions.end(), {center - u - v, center + u - v, center + u + v, center - u + v});
+                    mesh.normals.insert(mesh.normals.end(), 4, n);
+                    add_triangle(&mesh, first + 0, first + 1, first + 2);
+                    add_triangle(&mesh, first + 2, first + 3, first + 0);
+                }
+            }
+        } break;
+
+        case PRIMITIVE_GEOMETRY_SPHERE: {
+            uint32_t n_rings = std::max(2u, segments / 2);
+            add_sphere_rings(&mesh, 0, n_rings, n_rings, segments);
+        } break;
+
+        case PRIMITIVE_GEOMETRY_HEMISPHERE: {
+            uint32_t n_rings = 2 * std::max(1u, segments / 4);
+            add_sphere_rings(&mesh, n_rings / 2, n_rings, n_rings, segments);
+        } break;
+
+        case PRIMITIVE_GEOMETRY_CYLINDER: {
+            fmath::float2 profile[2] = {{0.5f, -0.5f}, {0.5f, 0.5f}};
+            fmath::float2 normals[2] = {{1.0f, 0.0f}, {1.0f, 0.0f}};
+            add_surface_of_revolution(&mesh, profile, normals, 2, segments);
+            add_disk(&mesh, -0.5f, -1.0f, segments);
+            add_disk(&mesh, 0.5f, 1.0f, segments);
+        } break;
+
+        case PRIMITIVE_GEOMETRY_CONE: {
+            // the slant normal is perpendicular to the side (-0.5, 1) of the profile
+            fmath::float2 slant_normal = normalize(fmath::float2{1.0f, 0.5f});
+            fmath::float2 profile[2] = {{0.5f, -0.5f}, {0.0f, 0.5f}};
+            fmath::float2 normals[2] = {slant_normal, slant_normal};
+            add_surface_of_revolution(&mesh, profile, normals, 2, segments);
+            add_disk(&mesh, -0.5f, -1.0f, segments);
+        } break;
+    }
+    return mesh;
+}
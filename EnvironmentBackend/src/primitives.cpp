@@ -0,0 +1,248 @@
+#include "../environments.hpp"
+#include <primitives.hpp>
+
+#include <environment.hpp>
+#include <engine_context.hpp>
+#include <object_manager.hpp>
+#include <renderable_buffers.hpp>
+#include <logging.hpp>
+
+#include <filament/Box.h>
+#include <filament/Engine.h>
+#include <filament/Scene.h>
+#include <filament/RenderableManager.h>
+#include <filament/TransformManager.h>
+#include <filament/VertexBuffer.h>
+#include <filament/IndexBuffer.h>
+#include <utils/EntityManager.h>
+#include <math/norm.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+static uint32_t primitive_geometry_key(Primitive_Geometry_Kind kind, uint32_t segments)
+{
+    // the plane and the box look the same at any tessellation
+    if (kind == PRIMITIVE_GEOMETRY_PLANE || kind == PRIMITIVE_GEOMETRY_BOX) segments = 0;
+    return (uint32_t(kind) << 16) | segments;
+}
+
+static Primitive_Geometry* create_primitive_geometry(fmt::Engine* engine, Primitive_Geometry_Kind kind, uint32_t segments)
+{
+    Mesh_Data mesh = build_primitive_mesh(kind, segments);
+    uint32_t n_vertices = uint32_t(mesh.positions.size());
+    uint32_t n_indices = uint32_t(mesh.indices.size());
+
+    Primitive_Geometry* geometry = new Primitive_Geometry;
+    geometry->n_indices = n_indices;
+    geometry->aabb_min = mesh.positions[0];
+    geometry->aabb_max = mesh.positions[0];
+    for (fmath::float3 p : mesh.positions) {
+        geometry->aabb_min = min(geometry->aabb_min, p);
+        geometry->aabb_max = max(geometry->aabb_max, p);
+    }
+
+    geometry->vertex_buffer = fmt::VertexBuffer::Builder()
+        .vertexCount(n_vertices)
+        .bufferCount(2)
+        .attribute(fmt::VertexAttribute::POSITION, 0, fmt::VertexBuffer::AttributeType::FLOAT3)
+        .attribute(fmt::VertexAttribute::TANGENTS, 1, fmt::VertexBuffer::AttributeType::SHORT4)
+        .normalized(fmt::VertexAttribute::TANGENTS)
+        .build(*engine);
+
+    geometry->index_buffer = fmt::IndexBuffer::Builder()
+        .indexCount(n_indices)
+        .bufferType(fmt::IndexBuffer::IndexType::UINT)
+        .build(*engine);
+
+    if (!geometry->vertex_buffer || !geometry->index_buffer) {
+        if (geometry->vertex_buffer) engine->destroy(geometry->vertex_buffer);
+        if (geometry->index_buffer) engine->destroy(geometry->index_buffer);
+        delete geometry;
+        return nullptr;
+    }
+
+    size_t positions_size = n_vertices * sizeof(fmath::float3);
+    void* positions = malloc(positions_size);
+    size_t tangents_size = n_vertices * sizeof(fmath::short4);
+    fmath::short4* tangents = (fmath::short4*)malloc(tangents_size);
+    size_t indices_size = n_indices * sizeof(uint32_t);
+    void* indices = malloc(indices_size);
+    if (!positions || !tangents || !indices) env_hard_error(ENV_ERR_MEM_ALLOC);
+
+    std::memcpy(positions, mesh.positions.data(), positions_size);
+    for (uint32_t i = 0; i < n_vertices; ++i) {
+        tangents[i] = tangent_frame_from_normal(mesh.normals[i]);
+    }
+    std::memcpy(indices, mesh.indices.data(), indices_size);
+
+    geometry->vertex_buffer->setBufferAt(*engine, 0, fmt::VertexBuffer::BufferDescriptor(positions, positions_size, free_buffer_callback));
+    geometry->vertex_buffer->setBufferAt(*engine, 1, fmt::VertexBuffer::BufferDescriptor(tangents, tangents_size, free_buffer_callback));
+    geometry->index_buffer->setBuffer(*engine, fmt::IndexBuffer::BufferDescriptor(indices, indices_size, free_buffer_callback));
+    return geometry;
+}
+
+static Primitive_Geometry* get_primitive_geometry(Engine_Context* ctx, Primitive_Geometry_Kind kind, uint32_t segments)
+{
+    uint32_t key = primitive_geometry_key(kind, segments);
+    auto itr = ctx->primitive_geometries.find(key);
+    if (itr != ctx->primitive_geometries.end()) return itr->second;
+
+    Primitive_Geometry* geometry = create_primitive_geometry(ctx->engine, kind, segments);
+    if (geometry) {
+        ctx->primitive_geometries[key] = geometry;
+    }
+    return geometry;
+}
+
+void primitive_geometries_destroy(Engine_Context* ctx)
+{
+    for (auto& [key, geometry] : ctx->primitive_geometries) {
+        ctx->engine->destroy(geometry->vertex_buffer);
+        ctx->engine->destroy(geometry->index_buffer);
+        delete geometry;
+    }
+    ctx->primitive_geometries.clear();
+}
+
+struct Primitive_Part {
+    Primitive_Geometry_Kind kind;
+    fmath::double3 scale;
+    fmath::double3 offset; // of the part center, relative to the root
+    bool upside_down = false;
+};
+
+// Splits a shape of the given size into scaled unit geometries, the shape is centered at the origin.
+static uint32_t primitive_parts(Primitive_Shape shape, fmath::double3 size, Primitive_Part parts[3])
+{
+    switch (shape) {
+        case PRIMITIVE_PLANE:    parts[0] = {PRIMITIVE_GEOMETRY_PLANE, {size.x, 1.0, size.z}, {0, 0, 0}}; return 1;
+        case PRIMITIVE_BOX:      parts[0] = {PRIMITIVE_GEOMETRY_BOX, size, {0, 0, 0}}; return 1;
+        case PRIMITIVE_SPHERE:   parts[0] = {PRIMITIVE_GEOMETRY_SPHERE, size, {0, 0, 0}}; return 1;
+        case PRIMITIVE_CYLINDER: parts[0] = {PRIMITIVE_GEOMETRY_CYLINDER, size, {0, 0, 0}}; return 1;
+
+        case PRIMITIVE_CAPSULE: {
+            // size.x is the diameter, the caps are scaled uniformly by it and the cylinder takes what is left of the length
+            double diameter = std::min(size.x, size.y);
+            double body_length = size.y - diameter;
+            fmath::double3 cap_scale = {diameter, diameter, diameter};
+            parts[0] = {PRIMITIVE_GEOMETRY_CYLINDER, {diameter, body_length, diameter}, {0, 0, 0}};
+            parts[1] = {PRIMITIVE_GEOMETRY_HEMISPHERE, cap_scale, {0, 0.5 * body_length, 0}};
+            parts[2] = {PRIMITIVE_GEOMETRY_HEMISPHERE, cap_scale, {0, -0.5 * body_length, 0}, true};
+            return body_length > 0.0 ? 3 : 2;
+        }
+
+        case PRIMITIVE_ARROW: {
+            // from y = -size.y / 2 to the tip at y = size.y / 2, the head is size.x wide (size.z is ignored)
+            double head_length = std::min(size.y, 1.5 * size.x);
+            double shaft_length = size.y - head_length;
+            double shaft_diameter = 0.4 * size.x;
+            parts[0] = {PRIMITIVE_GEOMETRY_CONE, {size.x, head_length, size.x}, {0, 0.5 * size.y - 0.5 * head_length, 0}};
+            parts[1] = {PRIMITIVE_GEOMETRY_CYLINDER, {shaft_diameter, shaft_length, shaft_diameter}, {0, -0.5 * size.y + 0.5 * shaft_length, 0}};
+            return shaft_length > 0.0 ? 2 : 1;
+        }
+    }
+    return 0;
+}
+
+static const char* primitive_shape_name(Primitive_Shape shape)
+{
+    switch (shape) {
+        case PRIMITIVE_PLANE:    return "plane";
+        case PRIMITIVE_BOX:      return "box";
+        case PRIMITIVE_SPHERE:   return "sphere";
+        case PRIMITIVE_CYLINDER: return "cylinder";
+        case PRIMITIVE_CAPSULE:  return "capsule";
+        case PRIMITIVE_ARROW:    return "arrow";
+    }
+    return "unknown primitive";
+}
+
+Filament_Entity_ID add_primitive(Primitive_Shape shape, double3 center, double3 size, const char* material_name,
+                                 Quaternion rotation, uint32_t tessellation)
+{
+    Environment* env = g_objm.get_active_environment();
+    if (!env) return {ENV_INVALID_UUID};
+
+    Primitive_Part parts[3];
+    uint32_t n_parts = primitive_parts(shape, d3_to_fd3(size), parts);
+    if (n_parts == 0) {
+        env_soft_error("Unknown primitive shape %u.", (unsigned)shape);
+        return {ENV_INVALID_UUID};
+    }
+    if (size.x < 0.0 || size.y < 0.0 || size.z < 0.0) {
+        env_soft_error("The size of a %s must not be negative.", primitive_shape_name(shape));
+        return {ENV_INVALID_UUID};
+    }
+
+    if (tessellation == 0) tessellation = ENV_PRIMITIVE_DEFAULT_TESSELLATION;
+    if (tessellation < 3 || tessellation > ENV_PRIMITIVE_MAX_TESSELLATION) {
+        env_soft_error("The tessellation of a %s has to be in [3, %u], got %u.",
+                       primitive_shape_name(shape), ENV_PRIMITIVE_MAX_TESSELLATION, tessellation);
+        return {ENV_INVALID_UUID};
+    }
+
+    fmt::MaterialInstance* material = env->material_registry.getMaterialInstance(utils::CString(material_name));
+    if (!material) {
+        env_soft_error("Couldn't find the material '%s'.", material_name);
+        return {ENV_INVALID_UUID};
+    }
+
+    Primitive_Geometry* geometries[3];
+    for (uint32_t i = 0; i < n_parts; ++i) {
+        geometries[i] = get_primitive_geometry(env->ctx, parts[i].kind, tessellation);
+        if (!geometries[i]) {
+            env_soft_error("Failed to create the geometry of a %s.", primitive_shape_name(shape));
+            return {ENV_INVALID_UUID};
+        }
+    }
+
+    Primitive* primitive = new Primitive;
+    fmt::TransformManager& trans_m = env->engine->getTransformManager();
+    primitive->root = utils::EntityManager::get().create();
+    trans_m.create(primitive->root, {}, pose_to_mat4(center, rotation));
+
+    for (uint32_t i = 0; i < n_parts; ++i) {
+        const Primitive_Part& part = parts[i];
+        const Primitive_Geometry* geometry = geometries[i];
+
+        utils::Entity entity = utils::EntityManager::get().create();
+        fmt::RenderableManager::Builder(1)
+            .boundingBox(fmt::Box().set(geometry->aabb_min, geometry->aabb_max))
+            .material(0, material)
+            .geometry(0, fmt::RenderableManager::PrimitiveType::TRIANGLES,
+                      geometry->vertex_buffer, geometry->index_buffer, 0, geometry->n_indices)
+            .receiveShadows(true)
+            .castShadows(shape != PRIMITIVE_PLANE)
+            .build(*env->engine, entity);
+        fmath::mat4 local = fmath::mat4::translation(part.offset);
+        if (part.upside_down) local = local * fmath::mat4::rotation(PI, fmath::double3{1, 0, 0});
+        trans_m.create(entity, trans_m.getInstance(primitive->root), local * fmath::mat4::scaling(part.scale));
+        primitive->parts.push_back(entity);
+    }
+
+    std::vector<utils::Entity> entities = {primitive->root};
+    entities.insert(entities.end(), primitive->parts.begin(), primitive->parts.end());
+    env->scene->addEntities(entities.data(), entities.size());
+    env->primitives[primitive->root.getId()] = primitive;
+
+    Filament_Entity_ID fentity_id = g_objm.add_object({primitive->root, env});
+    segmentation_register(env, primitive->parts.data(), primitive->parts.size(), fentity_id, {ENV_INVALID_UUID});
+    return fentity_id;
+}
+
+// The geometry is shared, only the entities belong to the primitive.
+void primitive_destroy(Environment* env, Primitive* primitive)
+{
+    for (utils::Entity entity : primitive->parts) {
+        env->scene->remove(entity);
+        env->engine->destroy(entity);
+        utils::EntityManager::get().destroy(entity);
+    }
+    env->scene->remove(primitive->root);
+    env->engine->destroy(primitive->root);
+    utils::EntityManager::get().destroy(primitive->root);
+    delete primitive;
+}
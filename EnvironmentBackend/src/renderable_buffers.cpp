@@ -0,0 +1,47 @@
+#include <renderable_buffers.hpp>
+
+#include <logging.hpp>
+
+#include <filament/Engine.h>
+#include <filament/IndexBuffer.h>
+#include <filament/RenderableManager.h>
+
+#include <algorithm>
+#include <cstdlib>
+
+void free_buffer_callback(void* buffer, size_t, void*)
+{
+    free(buffer);
+}
+
+uint32_t pack_color(float3 color)
+{
+    auto to_u8 = [](float c) { return uint32_t(std::clamp(c, 0.0f, 1.0f) * 255.0f + 0.5f); };
+    return to_u8(color.x) | (to_u8(color.y) << 8) | (to_u8(color.z) << 16) | (255u << 24);
+}
+
+uint32_t grow_capacity(uint32_t capacity, uint32_t min_capacity)
+{
+    uint32_t new_capacity = std::max(capacity, 1u);
+    while (new_capacity < min_capacity) {
+        new_capacity = new_capacity > UINT32_MAX / 2 ? min_capacity : 2 * new_capacity;
+    }
+    return new_capacity;
+}
+
+void set_sequential_indices(fmt::Engine* engine, fmt::IndexBuffer* index_buffer, uint32_t n)
+{
+    uint32_t* indices = (uint32_t*)malloc(n * sizeof(uint32_t));
+    if (!indices) env_hard_error(ENV_ERR_MEM_ALLOC);
+    for (uint32_t i = 0; i < n; ++i) {
+        indices[i] = i;
+    }
+    index_buffer->setBuffer(*engine, fmt::IndexBuffer::BufferDescriptor(indices, n * sizeof(uint32_t), free_buffer_callback));
+}
+
+void set_renderable_geometry(fmt::Engine* engine, utils::Entity entity, fmt::backend::PrimitiveType type,
+                             fmt::VertexBuffer* vertex_buffer, fmt::IndexBuffer* index_buffer)
+{
+    fmt::RenderableManager& rm = engine->getRenderableManager();
+    rm.setGeometryAt(rm.getInstance(entity), 0, type, vertex_buffer, index_buffer, 0, 0);
+}
@@ -0,0 +1,162 @@
+#include "../environments.hpp"
+#include <segmentation.hpp>
+
+#include <environment.hpp>
+#include <engine_context.hpp>
+#include <object_manager.hpp>
+#include <logging.hpp>
+
+#include <filament/Engine.h>
+#include <filament/Scene.h>
+#include <filament/Skybox.h>
+#include <filament/Material.h>
+#include <filament/MaterialInstance.h>
+#include <filament/RenderableManager.h>
+
+#include <cstring>
+
+uint32_t segmentation_register(Environment* env, const utils::Entity* entities, size_t n_entities,
+                               Filament_Entity_ID filament_entity_id, glTF_Instance_ID gltf_instance_id)
+{
+    Segmentation_Registry& seg = env->segmentation;
+    uint32_t label_idx;
+    if (!seg.free_labels.empty()) {
+        // the mask material already has the color of this id
+        label_idx = seg.free_labels.back();
+        seg.free_labels.pop_back();
+    }
+    else {
+        label_idx = uint32_t(seg.labels.size());
+        if (label_idx + 1 > ENV_SEGMENTATION_MAX_ID) {
+            env_warning("Ran out of segmentation mask ids, the object will not show up in the mask.");
+            return 0;
+        }
+        seg.labels.emplace_back();
+    }
+    uint32_t mask_id = label_idx + 1;
+    Segmentation_Label& label = seg.labels[label_idx];
+
+    fmt::RenderableManager& rm = env->engine->getRenderableManager();
+
+    label.filament_entity_id = filament_entity_id;
+    label.gltf_instance_id = gltf_instance_id;
+    for (size_t i = 0; i < n_entities; ++i) {
+        auto ri = rm.getInstance(entities[i]);
+        if (!ri) continue; // only renderables show up in the mask
+        rm.setLayerMask(ri, ENV_SEGMENTATION_LAYER, ENV_SEGMENTATION_LAYER);
+        label.renderables.push_back(entities[i]);
+    }
+
+    if (!label.mask_material) {
+        // The mask views render without post-processing into an RGBA8 target, so the linear
+        // color values k / 255 end up as exactly k in the image.
+        float color[3];
+        segmentation_id_color(mask_id, color);
+        label.mask_material = env->ctx->base_unlit_material->createInstance();
+        label.mask_material->setParameter("baseColor", fmath::float3{color[0], color[1], color[2]});
+        label.mask_material->setParameter("emissive", fmath::float4{0.0f, 0.0f, 0.0f, 0.0f});
+    }
+    return mask_id;
+}
+
+// Called before the renderables of the object are destroyed, its mask id is given to the next new object.
+void segmentation_unregister(Environment* env, Filament_Entity_ID filament_entity_id, glTF_Instance_ID gltf_instance_id)
+{
+    Segmentation_Registry& seg = env->segmentation;
+    for (uint32_t label_idx = 0; label_idx < seg.labels.size(); ++label_idx) {
+        Segmentation_Label& label = seg.labels[label_idx];
+        // free labels have neither id, so they never match a valid one
+        if (!(label.filament_entity_id == filament_entity_id) || !(label.gltf_instance_id == gltf_instance_id)) continue;
+
+        label.filament_entity_id = {ENV_INVALID_UUID};
+        label.gltf_instance_id = {ENV_INVALID_UUID};
+        label.renderables.clear();
+        seg.free_labels.push_back(label_idx);
+        return;
+    }
+}
+
+void segmentation_begin_mask_pass(Environment* env)
+{
+    Segmentation_Registry& seg = env->segmentation;
+    fmt::RenderableManager& rm = env->engine->getRenderableManager();
+
+    seg.swapped_materials.clear();
+    for (Segmentation_Label& label : seg.labels) {
+        for (utils::Entity entity : label.renderables) {
+            auto ri = rm.getInstance(entity);
+            if (!ri) continue;
+            size_t n_primitives = rm.getPrimitiveCount(ri);
+            for (size_t p = 0; p < n_primitives; ++p) {
+                seg.swapped_materials.push_back(rm.getMaterialInstanceAt(ri, p));
+                rm.setMaterialInstanceAt(ri, p, label.mask_material);
+            }
+        }
+    }
+
+    if (!seg.mask_skybox) {
+        seg.mask_skybox = fmt::Skybox::Builder()
+            .color({0.0f, 0.0f, 0.0f, 0.0f})
+            .build(*env->engine);
+        // the mask views only see ENV_SEGMENTATION_LAYER, the background would be left uncleared otherwise
+        seg.mask_skybox->setLayerMask(0xFF, ENV_SEGMENTATION_LAYER);
+    }
+    seg.swapped_skybox = env->scene->getSkybox();
+    env->scene->setSkybox(seg.mask_skybox);
+}
+
+// Restores everything in exactly the order it was swapped in 'segmentation_begin_mask_pass'.
+void segmentation_end_mask_pass(Environment* env)
+{
+    Segmentation_Registry& seg = env->segmentation;
+    fmt::RenderableManager& rm = env->engine->getRenderableManager();
+
+    size_t swapped_idx = 0;
+    for (Segmentation_Label& label : seg.labels) {
+        for (utils::Entity entity : label.renderables) {
+            auto ri = rm.getInstance(entity);
+            if (!ri) continue;
+            size_t n_primitives = rm.getPrimitiveCount(ri);
+            for (size_t p = 0; p < n_primitives; ++p) {
+                rm.setMaterialInstanceAt(ri, p, seg.swapped_materials[swapped_idx++]);
+            }
+        }
+    }
+    seg.swapped_materials.clear();
+
+    env->scene->setSkybox(seg.swapped_skybox);
+    seg.swapped_skybox = nullptr;
+}
+
+void segmentation_destroy(Environment* env)
+{
+    Segmentation_Registry& seg = env->segmentation;
+    for (Segmentation_Label& label : seg.labels) {
+        env->engine->destroy(label.mask_material);
+    }
+    seg.labels.clear();
+    seg.free_labels.clear();
+
+    if (seg.mask_skybox) {
+        env->engine->destroy(seg.mask_skybox);
+        seg.mask_skybox = nullptr;
+    }
+}
+
+ENV_API bool get_segmentation_object(Environment_ID env_id, uint32_t mask_id, Filament_Entity_ID* filament_entity_id, glTF_Instance_ID* gltf_instance_id)
+{
+    Environment* env = g_objm.get_object(env_id);
+    if (!env) return false;
+
+    if (mask_id == 0 || mask_id > env->segmentation.labels.size()) {
+        *filament_entity_id = {ENV_INVALID_UUID};
+        *gltf_instance_id = {ENV_INVALID_UUID};
+        return false;
+    }
+
+    // the label of a destroyed object has neither id
+    const Segmentation_Label& label = env->segmentation.labels[mask_id - 1];
+    *filament_entity_id = label.filament_entity_id;
+    *gltf_instance_id = label.gltf_instance_id;
+    return !(label.filament_entity_id == ENV_INVALID_UUID) || !(label.gltf_instance_id == ENV_INVALID_UUID);
+}
@@ -0,0 +1,125 @@
+#include <shm_export.hpp>
+
+#include <logging.hpp>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+
+static size_t align_up(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static Shm_Slot_Header* get_slot(Shm_Export* shm, uint32_t slot_idx)
+{
+    uint8_t* slots = (uint8_t*)shm->mapping + align_up(sizeof(Shm_Ring_Header), alignof(Shm_Slot_Header));
+    return (Shm_Slot_Header*)(slots + slot_idx * shm->header->slot_stride);
+}
+
+static uint64_t get_monotonic_time_ns()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000ull + uint64_t(ts.tv_nsec);
+}
+
+Shm_Export* shm_export_create(const char* name, uint32_t n_slots, size_t slot_capacity)
+{
+    // POSIX wants exactly one leading slash and no others
+    std::string shm_name = name[0] == '/' ? name : std::string("/") + name;
+    if (shm_name.size() < 2 || shm_name.find('/', 1) != std::string::npos) {
+        env_soft_error("Invalid shared memory name '%s', it must not contain '/'.", name);
+        return nullptr;
+    }
+
+    size_t data_offset = align_up(sizeof(Shm_Slot_Header), 64);
+    size_t slot_stride = align_up(data_offset + slot_capacity, 64);
+    size_t mapping_size = align_up(sizeof(Shm_Ring_Header), alignof(Shm_Slot_Header)) + n_slots * slot_stride;
+
+    // Never resize an existing object, readers which still have it mapped would get SIGBUS. The old name is
+    // removed instead, they keep their mapping of the old object until they reopen the name.
+    if (shm_unlink(shm_name.c_str()) != 0 && errno != ENOENT) {
+        env_soft_error("Failed to remove the old shared memory object '%s': %s", shm_name.c_str(), strerror(errno));
+        return nullptr;
+    }
+    int fd = shm_open(shm_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        env_soft_error("Failed to open the shared memory object '%s': %s", shm_name.c_str(), strerror(errno));
+        return nullptr;
+    }
+    if (ftruncate(fd, off_t(mapping_size)) != 0) {
+        env_soft_error("Failed to resize the shared memory object '%s' to %zu bytes: %s", shm_name.c_str(), mapping_size, strerror(errno));
+        close(fd);
+        shm_unlink(shm_name.c_str());
+        return nullptr;
+    }
+    void* mapping = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        env_soft_error("Failed to map the shared memory object '%s': %s", shm_name.c_str(), strerror(errno));
+        close(fd);
+        shm_unlink(shm_name.c_str());
+        return nullptr;
+    }
+
+    Shm_Export* shm = new Shm_Export;
+    shm->name = shm_name;
+    shm->fd = fd;
+    shm->mapping = mapping;
+    shm->mapping_size = mapping_size;
+    shm->header = (Shm_Ring_Header*)mapping;
+
+    // the object is new, so all slot headers are zero (seqlock even, nothing published)
+    shm->header->version = ENV_SHM_VERSION;
+    shm->header->n_slots = n_slots;
+    shm->header->data_offset = uint32_t(data_offset);
+    shm->header->slot_stride = slot_stride;
+    shm->header->slot_capacity = slot_capacity;
+    __atomic_store_n(&shm->header->latest_slot, ENV_SHM_NO_SLOT, __ATOMIC_RELAXED);
+    // the magic goes last, readers that see it see a complete header
+    __atomic_store_n(&shm->header->magic, ENV_SHM_MAGIC, __ATOMIC_RELEASE);
+    return shm;
+}
+
+// Readers that still have the object mapped keep their mapping, only the name is removed.
+void shm_export_destroy(Shm_Export* shm)
+{
+    if (!shm) return;
+    munmap(shm->mapping, shm->mapping_size);
+    close(shm->fd);
+    shm_unlink(shm->name.c_str());
+    delete shm;
+}
+
+void* shm_export_begin_write(Shm_Export* shm, uint32_t slot_idx, uint64_t frame_index, uint32_t width, uint32_t height,
+                             uint32_t pixel_data_format, uint32_t pixel_data_type, size_t size)
+{
+    if (slot_idx >= shm->header->n_slots || size > shm->header->slot_capacity) return nullptr;
+
+    Shm_Slot_Header* slot = get_slot(shm, slot_idx);
+    uint64_t seq = __atomic_load_n(&slot->seqlock, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->seqlock, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE); // the odd seqlock must be visible before any of the data changes
+
+    slot->frame_index = frame_index;
+    slot->timestamp_ns = get_monotonic_time_ns();
+    slot->size = size;
+    slot->width = width;
+    slot->height = height;
+    slot->pixel_data_format = pixel_data_format;
+    slot->pixel_data_type = pixel_data_type;
+    return (uint8_t*)slot + shm->header->data_offset;
+}
+
+void shm_export_end_write(Shm_Export* shm, uint32_t slot_idx)
+{
+    Shm_Slot_Header* slot = get_slot(shm, slot_idx);
+    uint64_t seq = __atomic_load_n(&slot->seqlock, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->seqlock, seq + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&shm->header->latest_slot, uint64_t(slot_idx), __ATOMIC_RELEASE);
+}
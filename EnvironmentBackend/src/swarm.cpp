@@ -0,0 +1,323 @@
+#include "../environments.hpp"
+#include <swarm.hpp>
+
+#include <environment.hpp>
+#include <engine_context.hpp>
+#include <object_manager.hpp>
+#include <renderable_buffers.hpp>
+#include <logging.hpp>
+
+#include <filament/Box.h>
+#include <filament/Engine.h>
+#include <filament/Scene.h>
+#include <filament/Material.h>
+#include <filament/MaterialInstance.h>
+#include <filament/RenderableManager.h>
+#include <filament/TransformManager.h>
+#include <filament/VertexBuffer.h>
+#include <filament/IndexBuffer.h>
+#include <filament/InstanceBuffer.h>
+#include <utils/EntityManager.h>
+#include <math/mat3.h>
+#include <math/norm.h>
+
+#include <cgltf.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+static fmt::MaterialInstance* create_swarm_material(Environment* env, const cgltf_material* gltf_material)
+{
+    fmath::float3 base_color = {0.8f, 0.8f, 0.8f};
+    float metallic = 0.0f;
+    float roughness = 0.5f;
+    if (gltf_material && gltf_material->has_pbr_metallic_roughness) {
+        const cgltf_pbr_metallic_roughness& pbr = gltf_material->pbr_metallic_roughness;
+        base_color = {pbr.base_color_factor[0], pbr.base_color_factor[1], pbr.base_color_factor[2]};
+        metallic = pbr.metallic_factor;
+        roughness = pbr.roughness_factor;
+    }
+
+    fmt::MaterialInstance* mat_i = env->ctx->base_lit_material->createInstance();
+    mat_i->setParameter("baseColor", fmt::RgbType::LINEAR, base_color); // glTF color factors are linear
+    mat_i->setParameter("roughness", roughness);
+    mat_i->setParameter("metallic", metallic);
+    mat_i->setParameter("reflectance", 0.5f);
+    mat_i->setParameter("sheenColor", fmath::float3{0.0f});
+    mat_i->setParameter("clearCoat", 0.0f);
+    mat_i->setParameter("clearCoatRoughness", 0.0f);
+    return mat_i;
+}
+
+static bool create_swarm_mesh(Environment* env, const cgltf_node* node, const cgltf_primitive* primitive, Swarm_Mesh* mesh)
+{
+    const cgltf_accessor* positions = nullptr;
+    const cgltf_accessor* normals = nullptr;
+    for (cgltf_size a = 0; a < primitive->attributes_count; ++a) {
+        if (primitive->attributes[a].type == cgltf_attribute_type_position) positions = primitive->attributes[a].data;
+        if (primitive->attributes[a].type == cgltf_attribute_type_normal) normals = primitive->attributes[a].data;
+    }
+    if (primitive->type != cgltf_primitive_type_triangles || !positions || !normals) {
+        env_warning("Skipping a glTF primitive of the swarm, only triangles with normals are supported.");
+        return false;
+    }
+
+    fmath::mat4f world;
+    cgltf_node_transform_world(node, &world[0][0]);
+    fmath::mat3f normal_matrix = transpose(inverse(world.upperLeft()));
+
+    uint32_t n_vertices = uint32_t(positions->count);
+    fmath::float3* vertex_positions = (fmath::float3*)malloc(n_vertices * sizeof(fmath::float3));
+    fmath::short4* vertex_tangents = (fmath::short4*)malloc(n_vertices * sizeof(fmath::short4));
+    if (!vertex_positions || !vertex_tangents) env_hard_error(ENV_ERR_MEM_ALLOC);
+
+    mesh->aabb_min = {INFINITY, INFINITY, INFINITY};
+    mesh->aabb_max = {-INFINITY, -INFINITY, -INFINITY};
+    for (uint32_t v = 0; v < n_vertices; ++v) {
+        fmath::float3 p, n;
+        cgltf_accessor_read_float(positions, v, &p[0], 3);
+        cgltf_accessor_read_float(normals, v, &n[0], 3);
+        p = (world * fmath::float4{p, 1.0f}).xyz;
+        n = normalize(normal_matrix * n);
+        vertex_positions[v] = p;
+        vertex_tangents[v] = tangent_frame_from_normal(n);
+        mesh->aabb_min = min(mesh->aabb_min, p);
+        mesh->aabb_max = max(mesh->aabb_max, p);
+    }
+
+    mesh->n_indices = primitive->indices ? uint32_t(primitive->indices->count) : n_vertices;
+    uint32_t* indices = (uint32_t*)malloc(mesh->n_indices * sizeof(uint32_t));
+    if (!indices) env_hard_error(ENV_ERR_MEM_ALLOC);
+    for (uint32_t i = 0; i < mesh->n_indices; ++i) {
+        indices[i] = primitive->indices ? uint32_t(cgltf_accessor_read_index(primitive->indices, i)) : i;
+    }
+
+    mesh->vertex_buffer = fmt::VertexBuffer::Builder()
+        .vertexCount(n_vertices)
+        .bufferCount(2)
+        .attribute(fmt::VertexAttribute::POSITION, 0, fmt::VertexBuffer::AttributeType::FLOAT3)
+        .attribute(fmt::VertexAttribute::TANGENTS, 1, fmt::VertexBuffer::AttributeType::SHORT4)
+        .normalized(fmt::VertexAttribute::TANGENTS)
+        .build(*env->engine);
+    mesh->vertex_buffer->setBufferAt(*env->engine, 0, fmt::VertexBuffer::BufferDescriptor(
+        vertex_positions, n_vertices * sizeof(fmath::float3), free_buffer_callback));
+    mesh->vertex_buffer->setBufferAt(*env->engine, 1, fmt::VertexBuffer::BufferDescriptor(
+        vertex_tangents, n_vertices * sizeof(fmath::short4), free_buffer_callback));
+
+    mesh->index_buffer = fmt::IndexBuffer::Builder()
+        .indexCount(mesh->n_indices)
+        .bufferType(fmt::IndexBuffer::IndexType::UINT)
+        .build(*env->engine);
+    mesh->index_buffer->setBuffer(*env->engine, fmt::IndexBuffer::BufferDescriptor(
+        indices, mesh->n_indices * sizeof(uint32_t), free_buffer_callback));
+
+    mesh->material = create_swarm_material(env, primitive->material);
+    return true;
+}
+
+// Warns once per material about everything the swarm materials can't show, they only use the pbr factors.
+static void warn_about_dropped_material_features(const cgltf_material* material)
+{
+    const cgltf_pbr_metallic_roughness& pbr = material->pbr_metallic_roughness;
+    bool has_textures = pbr.base_color_texture.texture || pbr.metallic_roughness_texture.texture
+        || material->normal_texture.texture || material->occlusion_texture.texture || material->emissive_texture.texture;
+    bool has_unsupported_features = material->has_pbr_specular_glossiness || material->has_clearcoat
+        || material->has_transmission || material->has_volume || material->has_sheen || material->has_specular
+        || material->unlit || material->alpha_mode != cgltf_alpha_mode_opaque
+        || material->emissive_factor[0] > 0.0f || material->emissive_factor[1] > 0.0f || material->emissive_factor[2] > 0.0f;
+
+    const char* name = material->name ? material->name : "unnamed";
+    if (has_textures) {
+        env_warning("The textures of the glTF material '%s' are dropped, swarms only use the color factors.", name);
+    }
+    if (has_unsupported_features) {
+        env_warning("The glTF material '%s' uses features swarms don't support (emission, transparency, unlit or extensions), they are dropped.", name);
+    }
+}
+
+static void add_swarm_node_meshes(Environment* env, const cgltf_node* node, Swarm* swarm, std::vector<const cgltf_material*>* checked_materials)
+{
+    if (node->mesh) {
+        for (cgltf_size p = 0; p < node->mesh->primitives_count; ++p) {
+            const cgltf_primitive* primitive = &node->mesh->primitives[p];
+            const cgltf_material* material = primitive->material;
+            if (material && std::find(checked_materials->begin(), checked_materials->end(), material) == checked_materials->end()) {
+                warn_about_dropped_material_features(material);
+                checked_materials->push_back(material);
+            }
+
+            Swarm_Mesh mesh;
+            if (create_swarm_mesh(env, node, primitive, &mesh)) {
+                swarm->meshes.push_back(mesh);
+            }
+        }
+    }
+    for (cgltf_size c = 0; c < node->children_count; ++c) {
+        add_swarm_node_meshes(env, node->children[c], swarm, checked_materials);
+    }
+}
+
+/*
+ * The meshes are read with cgltf (which gltfio is built on), because the renderables gltfio creates
+ * can't be given an InstanceBuffer. Only the nodes of the default scene are baked. Textures are not
+ * supported, the materials use the glTF factors and warn about everything else they drop.
+ */
+Filament_Entity_ID add_swarm(const char* gltf_path, uint32_t n_instances)
+{
+    Environment* env = g_objm.get_active_environment();
+    if (!env) return {ENV_INVALID_UUID};
+
+    if (n_instances == 0) {
+        env_soft_error("A swarm needs at least one instance.");
+        return {ENV_INVALID_UUID};
+    }
+
+    cgltf_options options = {};
+    cgltf_data* data = nullptr;
+    if (cgltf_parse_file(&options, gltf_path, &data) != cgltf_result_success
+        || cgltf_load_buffers(&options, data, gltf_path) != cgltf_result_success) {
+        env_soft_error("Unable to load the glTF file '%s'", gltf_path);
+        cgltf_free(data);
+        return {ENV_INVALID_UUID};
+    }
+
+    Swarm* swarm = new Swarm;
+    swarm->n_instances = n_instances;
+    std::vector<const cgltf_material*> checked_materials;
+    // only what the default scene shows, like gltfio, files without scenes contribute all their root nodes
+    const cgltf_scene* scene = data->scene ? data->scene : (data->scenes_count > 0 ? &data->scenes[0] : nullptr);
+    if (scene) {
+        for (cgltf_size n = 0; n < scene->nodes_count; ++n) {
+            add_swarm_node_meshes(env, scene->nodes[n], swarm, &checked_materials);
+        }
+    }
+    else {
+        for (cgltf_size n = 0; n < data->nodes_count; ++n) {
+            if (!data->nodes[n].parent) add_swarm_node_meshes(env, &data->nodes[n], swarm, &checked_materials);
+        }
+    }
+    cgltf_free(data);
+
+    if (swarm->meshes.empty()) {
+        env_soft_error("The glTF file '%s' has no meshes, which can be drawn as a swarm.", gltf_path);
+        delete swarm;
+        return {ENV_INVALID_UUID};
+    }
+
+    fmt::TransformManager& trans_m = env->engine->getTransformManager();
+    swarm->root = utils::EntityManager::get().create();
+    trans_m.create(swarm->root);
+
+    // all instances start at the origin of the swarm
+    swarm->instance_transforms.assign(n_instances, fmath::mat4f{});
+
+    for (uint32_t first = 0; first < n_instances; first += ENV_SWARM_CHUNK_SIZE) {
+        uint32_t n_chunk = std::min(uint32_t(ENV_SWARM_CHUNK_SIZE), n_instances - first);
+        for (uint32_t mesh_idx = 0; mesh_idx < swarm->meshes.size(); ++mesh_idx) {
+            const Swarm_Mesh& mesh = swarm->meshes[mesh_idx];
+            Swarm_Renderable renderable;
+            renderable.mesh_idx = mesh_idx;
+            renderable.first_instance = first;
+            renderable.n_instances = n_chunk;
+            renderable.instance_buffer = fmt::InstanceBuffer::Builder(n_chunk).build(*env->engine);
+            renderable.instance_buffer->setLocalTransforms(swarm->instance_transforms.data() + first, n_chunk);
+
+            renderable.entity = utils::EntityManager::get().create();
+            fmt::RenderableManager::Builder(1)
+                .boundingBox(fmt::Box().set(mesh.aabb_min, mesh.aabb_max))
+                .material(0, mesh.material)
+                .geometry(0, fmt::RenderableManager::PrimitiveType::TRIANGLES, mesh.vertex_buffer, mesh.index_buffer, 0, mesh.n_indices)
+                .instances(n_chunk, renderable.instance_buffer)
+                .receiveShadows(true)
+                .castShadows(true)
+                .build(*env->engine, renderable.entity);
+            trans_m.create(renderable.entity, trans_m.getInstance(swarm->root));
+
+            swarm->renderables.push_back(renderable);
+        }
+    }
+
+    std::vector<utils::Entity> entities = {swarm->root};
+    for (const Swarm_Renderable& renderable : swarm->renderables) {
+        entities.push_back(renderable.entity);
+    }
+    env->scene->addEntities(entities.data(), entities.size());
+    env->swarms[swarm->root.getId()] = swarm;
+
+    Filament_Entity_ID fentity_id = g_objm.add_object({swarm->root, env});
+    segmentation_register(env, entities.data(), entities.size(), fentity_id, {ENV_INVALID_UUID});
+    return fentity_id;
+}
+
+// filament culls with the bounding box of the renderable, so it has to enclose every instance of the chunk
+static fmt::Box swarm_renderable_bounds(const Swarm* swarm, const Swarm_Renderable& renderable)
+{
+    const Swarm_Mesh& mesh = swarm->meshes[renderable.mesh_idx];
+    fmt::Box mesh_box = fmt::Box().set(mesh.aabb_min, mesh.aabb_max);
+
+    fmath::float3 aabb_min = {INFINITY, INFINITY, INFINITY};
+    fmath::float3 aabb_max = {-INFINITY, -INFINITY, -INFINITY};
+    for (uint32_t i = 0; i < renderable.n_instances; ++i) {
+        fmt::Box box = rigidTransform(mesh_box, swarm->instance_transforms[renderable.first_instance + i]);
+        aabb_min = min(aabb_min, box.getMin());
+        aabb_max = max(aabb_max, box.getMax());
+    }
+    return fmt::Box().set(aabb_min, aabb_max);
+}
+
+bool set_swarm_transforms(Filament_Entity_ID swarm_id, const double3* positions, const Quaternion* orientations, uint32_t first_instance, uint32_t n)
+{
+    Filament_Entity fentity = g_objm.get_object(swarm_id);
+    if (!fentity.is_valid()) return false;
+
+    auto itr = fentity.associated_env->swarms.find(fentity.entity.getId());
+    if (itr == fentity.associated_env->swarms.end()) {
+        env_soft_error("The Filament-Entity with id %#llx is not a swarm.", (unsigned long long)swarm_id.id);
+        return false;
+    }
+    Swarm* swarm = itr->second;
+
+    if (first_instance > swarm->n_instances || n > swarm->n_instances - first_instance) {
+        env_soft_error("The instances [%u, %u) are out of range, the swarm has %u instances.",
+                       first_instance, first_instance + n, swarm->n_instances);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < n; ++i) {
+        swarm->instance_transforms[first_instance + i] = fmath::mat4f(pose_to_mat4(positions[i], orientations[i]));
+    }
+
+    // only the chunks overlapping the updated range are uploaded
+    fmt::RenderableManager& rm = fentity.associated_env->engine->getRenderableManager();
+    uint32_t last_instance = first_instance + n;
+    for (Swarm_Renderable& renderable : swarm->renderables) {
+        uint32_t begin = std::max(first_instance, renderable.first_instance);
+        uint32_t end = std::min(last_instance, renderable.first_instance + renderable.n_instances);
+        if (begin >= end) continue;
+        renderable.instance_buffer->setLocalTransforms(swarm->instance_transforms.data() + begin, end - begin,
+                                                       begin - renderable.first_instance);
+        rm.setAxisAlignedBoundingBox(rm.getInstance(renderable.entity), swarm_renderable_bounds(swarm, renderable));
+    }
+    return true;
+}
+
+void swarm_destroy(Environment* env, Swarm* swarm)
+{
+    for (Swarm_Renderable& renderable : swarm->renderables) {
+        env->scene->remove(renderable.entity);
+        env->engine->destroy(renderable.entity);
+        env->engine->destroy(renderable.instance_buffer);
+        utils::EntityManager::get().destroy(renderable.entity);
+    }
+    for (Swarm_Mesh& mesh : swarm->meshes) {
+        env->engine->destroy(mesh.vertex_buffer);
+        env->engine->destroy(mesh.index_buffer);
+        env->engine->destroy(mesh.material);
+    }
+    env->scene->remove(swarm->root);
+    env->engine->destroy(swarm->root);
+    utils::EntityManager::get().destroy(swarm->root);
+    delete swarm;
+}
@@ -0,0 +1,143 @@
+#include <texture_provider.hpp>
+
+#include <filament/Engine.h>
+#include <filament/Texture.h>
+#include <gltfio/TextureProvider.h>
+#include <utils/JobSystem.h>
+
+#include <stb_image.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace futils = utils;
+
+// Written by its decode job, read on the polling thread once 'decoded' is set.
+struct Pending_Texture {
+    fmt::Texture* texture = nullptr;
+    std::vector<uint8_t> source; // the ResourceLoader does not keep the encoded bytes around for us
+    uint8_t* pixels = nullptr;   // nullptr if decoding failed
+    std::atomic<bool> decoded{false};
+};
+
+class Parallel_Texture_Provider final : public fgltfio::TextureProvider {
+public:
+    explicit Parallel_Texture_Provider(fmt::Engine* engine)
+        : m_engine(engine), m_job_system(engine->getJobSystem()), m_decode_root_job(m_job_system.createJob()) {}
+
+    ~Parallel_Texture_Provider() override
+    {
+        cancelDecoding();
+        m_job_system.runAndWait(m_decode_root_job);
+    }
+
+    Texture* pushTexture(const uint8_t* data, size_t byte_count, const char* mime_type, FlagBits flags) override
+    {
+        int width = 0, height = 0, n_channels = 0;
+        if (!stbi_info_from_memory(data, int(byte_count), &width, &height, &n_channels)) {
+            m_push_message = std::string("Unable to parse the ") + mime_type + " texture: " + stbi_failure_reason();
+            return nullptr;
+        }
+
+        Pending_Texture* pending = new Pending_Texture;
+        pending->texture = Texture::Builder()
+            .width(uint32_t(width))
+            .height(uint32_t(height))
+            .levels(0xff)
+            .format(flags & FlagBits(TextureFlags::sRGB) ? Texture::InternalFormat::SRGB8_A8 : Texture::InternalFormat::RGBA8)
+            .usage(Texture::Usage::DEFAULT | Texture::Usage::GEN_MIPMAPPABLE)
+            .build(*m_engine);
+        pending->source.assign(data, data + byte_count);
+        m_decoding.push_back(pending);
+
+        futils::JobSystem::Job* job = futils::jobs::createJob(m_job_system, m_decode_root_job, [this, pending] {
+            int w, h, c;
+            pending->pixels = stbi_load_from_memory(pending->source.data(), int(pending->source.size()), &w, &h, &c, 4);
+            pending->decoded.store(true, std::memory_order_release);
+            m_n_decoded.fetch_add(1, std::memory_order_relaxed);
+        });
+        m_job_system.run(job);
+
+        m_n_pushed++;
+        return pending->texture;
+    }
+
+    Texture* popTexture() override
+    {
+        if (m_n_popped == m_finished.size()) return nullptr;
+        return m_finished[m_n_popped++];
+    }
+
+    // Uploads everything decoded so far, in any order.
+    void updateQueue() override
+    {
+        for (size_t i = 0; i < m_decoding.size();) {
+            Pending_Texture* pending = m_decoding[i];
+            if (!pending->decoded.load(std::memory_order_acquire)) {
+                i++;
+                continue;
+            }
+
+            if (pending->pixels) {
+                uint32_t width = uint32_t(pending->texture->getWidth());
+                uint32_t height = uint32_t(pending->texture->getHeight());
+                Texture::PixelBufferDescriptor buffer(
+                    pending->pixels, size_t(width) * height * 4, Texture::Format::RGBA, Texture::Type::UBYTE,
+                    [](void* pixels, size_t, void*) { stbi_image_free(pixels); });
+                pending->texture->setImage(*m_engine, 0, std::move(buffer));
+                pending->texture->generateMipmaps(*m_engine);
+            }
+            else {
+                // stays bound without content, like the other gltfio providers do it
+                m_pop_message = "Unable to decode a texture.";
+            }
+            m_finished.push_back(pending->texture);
+
+            delete pending;
+            m_decoding[i] = m_decoding.back();
+            m_decoding.pop_back();
+        }
+    }
+
+    void waitForCompletion() override
+    {
+        m_job_system.runAndWait(m_decode_root_job);
+        m_decode_root_job = m_job_system.createJob();
+    }
+
+    // Decoding can't be interrupted, the jobs are waited for and their images thrown away.
+    void cancelDecoding() override
+    {
+        waitForCompletion();
+        for (Pending_Texture* pending : m_decoding) {
+            stbi_image_free(pending->pixels);
+            delete pending;
+        }
+        m_decoding.clear();
+    }
+
+    const char* getPushMessage() const override { return m_push_message.c_str(); }
+    const char* getPopMessage() const override { return m_pop_message.c_str(); }
+    size_t getPushedCount() const override { return m_n_pushed; }
+    size_t getPoppedCount() const override { return m_n_popped; }
+    size_t getDecodedCount() const override { return m_n_decoded.load(std::memory_order_relaxed); }
+
+private:
+    fmt::Engine* m_engine;
+    futils::JobSystem& m_job_system;
+    futils::JobSystem::Job* m_decode_root_job; // parent of all decode jobs, so they can be waited for at once
+
+    std::vector<Pending_Texture*> m_decoding;
+    std::vector<Texture*> m_finished; // uploaded, handed out by popTexture in this order
+    size_t m_n_pushed = 0;
+    size_t m_n_popped = 0;
+    std::atomic<size_t> m_n_decoded{0};
+    std::string m_push_message;
+    std::string m_pop_message;
+};
+
+fgltfio::TextureProvider* create_parallel_texture_provider(fmt::Engine* engine)
+{
+    return new Parallel_Texture_Provider(engine);
+}
@@ -8,6 +8,7 @@
 #include <environment.hpp>
 #include <frame.hpp>
 #include <camera.hpp>
+#include <engine_context.hpp>
 #include <logging.hpp>
 #include <object_manager.hpp>
 
@@ -67,6 +68,10 @@ ENV_API Window_ID create_window(Camera_ID camera_id, int target_fps, const char*
 {
     Camera* camera = g_objm.get_object(camera_id);
     if (!camera) return {ENV_INVALID_UUID};
+    if (get_engine_context()->headless) {
+        env_soft_error("Windows are unavailable on the headless render platform, see 'set_render_platform'.");
+        return {ENV_INVALID_UUID};
+    }
 
     Window* window = new Window;
     window->camera = camera;
@@ -84,6 +89,7 @@ ENV_API Window_ID create_window(Camera_ID camera_id, int target_fps, const char*
     {
         window->sdl_window_id = SDL_GetWindowID(window->sdl_window);
         window->frame = create_frame(window->camera->env, window->camera->env->engine->createSwapChain(get_native_window(window->sdl_window)));
+        window->frame->show_debug_draw = true;
 
         Window_ID window_id = g_objm.add_object(window);
         g_objm.window_activate(window_id);
@@ -230,17 +236,17 @@ ENV_API bool window_update()
     // Consuming SDL events
 
     SDL_Event event;
-    const tsl::robin_map<Window_ID, Window*, UUID_Hasher>& windows = g_objm.get_windows();
+    const Slot_Map<Window*, OBJ_TAG_WINDOW>& windows = g_objm.get_windows();
     std::vector<Window_ID> windows_to_destroy;
 
     while (SDL_PollEvent(&event) != 0)
     {
         // Every window gets the chance to process the event.
-        for (auto itr = windows.begin(); itr != windows.end(); itr++) {
+        for (uint32_t slot_idx : windows.live) {
             bool destroy_this_window = false;
-            window_process_event(itr.value(), event, destroy_this_window);
+            window_process_event(windows.slots[slot_idx].value, event, destroy_this_window);
             if (destroy_this_window) {
-                windows_to_destroy.push_back(itr.key());
+                windows_to_destroy.push_back({windows.handle_of(slot_idx)});
             }
         }
     }
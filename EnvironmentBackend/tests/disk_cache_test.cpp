@@ -0,0 +1,72 @@
+#include <disk_cache.hpp>
+
+#include "test_common.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+/*
+ * Checks hash_bytes, which keys the disk cache: it must be deterministic, independent of the alignment
+ * of the data, and change with every single bit, the size and the seed.
+ */
+
+static void test_known_values()
+{
+    // FNV-1a offset basis, nothing hashed and the size zero folded in
+    CHECK(hash_bytes(nullptr, 0) == 0xcbf29ce484222325ull);
+    CHECK(hash_bytes("abc", 3) == hash_bytes("abc", 3));
+    CHECK(hash_bytes("abc", 3) != hash_bytes("abd", 3));
+    CHECK(hash_bytes("abc", 3, 1) != hash_bytes("abc", 3, 2));
+}
+
+static void test_every_bit_matters()
+{
+    for (size_t size = 1; size <= 40; ++size) {
+        std::vector<uint8_t> data(size);
+        for (size_t i = 0; i < size; ++i) data[i] = uint8_t(i * 37 + 11);
+        uint64_t reference = hash_bytes(data.data(), size);
+
+        for (size_t i = 0; i < size; ++i) {
+            for (int bit = 0; bit < 8; ++bit) {
+                data[i] ^= uint8_t(1 << bit);
+                CHECK(hash_bytes(data.data(), size) != reference);
+                data[i] ^= uint8_t(1 << bit);
+            }
+        }
+    }
+}
+
+static void test_size_matters()
+{
+    // all zero inputs only differ in their size
+    std::vector<uint8_t> zeros(64, 0);
+    for (size_t a = 0; a < zeros.size(); ++a) {
+        for (size_t b = a + 1; b <= zeros.size(); ++b) {
+            CHECK(hash_bytes(zeros.data(), a) != hash_bytes(zeros.data(), b));
+        }
+    }
+}
+
+static void test_alignment()
+{
+    const char* text = "The quick brown fox jumps over the lazy dog";
+    size_t size = strlen(text);
+    uint64_t reference = hash_bytes(text, size);
+
+    std::vector<uint8_t> buffer(size + 8);
+    for (size_t offset = 0; offset < 8; ++offset) {
+        memcpy(buffer.data() + offset, text, size);
+        CHECK(hash_bytes(buffer.data() + offset, size) == reference);
+    }
+}
+
+int main()
+{
+    test_known_values();
+    test_every_bit_matters();
+    test_size_matters();
+    test_alignment();
+
+    return finish_tests("disk cache");
+}
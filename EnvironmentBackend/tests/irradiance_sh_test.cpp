@@ -0,0 +1,132 @@
+#include <irradiance_sh.hpp>
+
+#include "test_common.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+/*
+ * Checks the cubemap face table against the face selection rules of the OpenGL specification and the
+ * spherical harmonics projection against analytic irradiance, in filament's pre-scaled form
+ * (irradiance / pi = sum of sh[i] * polynomial[i] of the normal).
+ */
+
+// OpenGL 4.6, section 8.13 "Cube Map Texture Selection", table 8.19
+static void select_cubemap_face(fmath::double3 r, uint32_t* face, double* s, double* t)
+{
+    double ax = std::fabs(r.x), ay = std::fabs(r.y), az = std::fabs(r.z);
+    double sc, tc, ma;
+    if (ax >= ay && ax >= az) {
+        *face = r.x > 0 ? 0 : 1;
+        sc = r.x > 0 ? -r.z : r.z;
+        tc = -r.y;
+        ma = ax;
+    }
+    else if (ay >= az) {
+        *face = r.y > 0 ? 2 : 3;
+        sc = r.x;
+        tc = r.y > 0 ? r.z : -r.z;
+        ma = ay;
+    }
+    else {
+        *face = r.z > 0 ? 4 : 5;
+        sc = r.z > 0 ? r.x : -r.x;
+        tc = -r.y;
+        ma = az;
+    }
+    *s = sc / ma;
+    *t = tc / ma;
+}
+
+static void test_face_table()
+{
+    const uint32_t size = 16;
+    for (uint32_t face = 0; face < 6; ++face) {
+        for (uint32_t y = 0; y < size; ++y) {
+            for (uint32_t x = 0; x < size; ++x) {
+                double s = 2.0 * (x + 0.5) / size - 1.0;
+                double t = 2.0 * (y + 0.5) / size - 1.0;
+                uint32_t selected_face;
+                double selected_s, selected_t;
+                select_cubemap_face(cubemap_direction(face, s, t), &selected_face, &selected_s, &selected_t);
+                CHECK(selected_face == face);
+                CHECK_NEAR(selected_s, s, 1e-12);
+                CHECK_NEAR(selected_t, t, 1e-12);
+            }
+        }
+    }
+}
+
+template <typename Radiance>
+static void fill_cubemap(std::vector<fmath::float4>* pixels, uint32_t size, Radiance radiance)
+{
+    pixels->resize(size_t(6) * size * size);
+    for (uint32_t face = 0; face < 6; ++face) {
+        for (uint32_t y = 0; y < size; ++y) {
+            for (uint32_t x = 0; x < size; ++x) {
+                double s = 2.0 * (x + 0.5) / size - 1.0;
+                double t = 2.0 * (y + 0.5) / size - 1.0;
+                fmath::double3 dir = cubemap_direction(face, s, t);
+                dir /= std::sqrt(dot(dir, dir));
+                float value = float(radiance(dir));
+                (*pixels)[(size_t(face) * size + y) * size + x] = fmath::float4(value, value, value, 1.0f);
+            }
+        }
+    }
+}
+
+// Projects the radiance and compares all 9 coefficients (of the red channel) against the expected ones.
+template <typename Radiance>
+static void check_projection(const char* name, Radiance radiance, const double expected[9])
+{
+    const uint32_t size = 64;
+    std::vector<fmath::float4> pixels;
+    fill_cubemap(&pixels, size, radiance);
+    fmath::float3 sh[9];
+    compute_irradiance_sh(pixels.data(), size, sh);
+    for (uint32_t i = 0; i < 9; ++i) {
+        if (std::fabs(sh[i].x - expected[i]) > 2e-3) {
+            printf("FAILED %s: sh[%u] = %f, expected %f\n", name, i, sh[i].x, expected[i]);
+            n_failed++;
+        }
+    }
+}
+
+static void test_projection()
+{
+    // uniform radiance 1 gives the irradiance pi everywhere
+    const double uniform[9] = {1, 0, 0, 0, 0, 0, 0, 0, 0};
+    check_projection("uniform", [](fmath::double3) { return 1.0; }, uniform);
+
+    // linear radiance is convolved with 2 pi / 3, sh[1..3] are the y, z and x terms
+    const double linear_y[9] = {0, 2.0 / 3.0, 0, 0, 0, 0, 0, 0, 0};
+    check_projection("linear y", [](fmath::double3 d) { return d.y; }, linear_y);
+    const double linear_z[9] = {0, 0, 2.0 / 3.0, 0, 0, 0, 0, 0, 0};
+    check_projection("linear z", [](fmath::double3 d) { return d.z; }, linear_z);
+    const double linear_x[9] = {0, 0, 0, 2.0 / 3.0, 0, 0, 0, 0, 0};
+    check_projection("linear x", [](fmath::double3 d) { return d.x; }, linear_x);
+
+    // quadratic radiance is convolved with pi / 4
+    const double quadratic_xy[9] = {0, 0, 0, 0, 0.25, 0, 0, 0, 0};
+    check_projection("quadratic xy", [](fmath::double3 d) { return d.x * d.y; }, quadratic_xy);
+
+    // light from above only, irradiance / pi = 1/2 + n.y / 2 + ... (exact to the first band)
+    const uint32_t size = 64;
+    std::vector<fmath::float4> pixels;
+    fill_cubemap(&pixels, size, [](fmath::double3 d) { return d.y > 0.0 ? 1.0 : 0.0; });
+    fmath::float3 sh[9];
+    compute_irradiance_sh(pixels.data(), size, sh);
+    CHECK_NEAR(sh[0].x, 0.5, 2e-3);
+    CHECK_NEAR(sh[1].x, 0.5, 2e-3);
+    CHECK_NEAR(sh[0].x + sh[1].x, 1.0, 2e-3); // facing the sky
+    CHECK_NEAR(sh[0].x - sh[1].x, 0.0, 2e-3); // facing the ground
+}
+
+int main()
+{
+    test_face_table();
+    test_projection();
+
+    return finish_tests("irradiance sh");
+}
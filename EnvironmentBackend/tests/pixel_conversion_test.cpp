@@ -0,0 +1,130 @@
+#include <pixel_conversion.hpp>
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+/*
+ * Compares the vectorized conversion kernels picked for this cpu against a plain scalar reference.
+ * The widths are odd or just around the simd widths, so the vector loops and the scalar tails both run.
+ */
+
+static uint32_t random_state = 12345;
+
+static uint8_t random_byte()
+{
+    random_state = random_state * 1664525u + 1013904223u;
+    return uint8_t(random_state >> 24);
+}
+
+struct Reference {
+    uint32_t width;
+    uint32_t height;
+    std::vector<uint8_t> rgba8;
+    std::vector<uint8_t> gray8;
+    std::vector<float> chw_float32;
+};
+
+static Reference convert_pixels_reference(const Pixel_Conversion_Settings& settings, const uint8_t* rgba8, uint32_t width, uint32_t height)
+{
+    Reference ref = {};
+    uint32_t factor = settings.downsample_factor;
+    ref.width = width / factor;
+    ref.height = height / factor;
+    size_t n = size_t(ref.width) * ref.height;
+    ref.rgba8.resize(4 * n);
+    ref.gray8.resize(n);
+    ref.chw_float32.resize(3 * n);
+
+    for (uint32_t y = 0; y < ref.height; ++y) {
+        uint32_t src_y = (settings.flip_vertical ? ref.height - 1 - y : y) * factor;
+        for (uint32_t x = 0; x < ref.width; ++x) {
+            size_t i = size_t(y) * ref.width + x;
+            for (uint32_t c = 0; c < 4; ++c) {
+                uint32_t sum = 0;
+                for (uint32_t dy = 0; dy < factor; ++dy) {
+                    for (uint32_t dx = 0; dx < factor; ++dx) {
+                        sum += rgba8[4 * (size_t(src_y + dy) * width + x * factor + dx) + c];
+                    }
+                }
+                ref.rgba8[4 * i + c] = uint8_t((sum + factor * factor / 2) / (factor * factor));
+            }
+            uint32_t r = ref.rgba8[4 * i + 0];
+            uint32_t g = ref.rgba8[4 * i + 1];
+            uint32_t b = ref.rgba8[4 * i + 2];
+            ref.gray8[i] = uint8_t((77 * r + 150 * g + 29 * b + 128) >> 8);
+            uint32_t rgb[3] = {r, g, b};
+            for (int c = 0; c < 3; ++c) {
+                ref.chw_float32[c * n + i] = (float(rgb[c]) / 255.0f - settings.mean[c]) / settings.std[c];
+            }
+        }
+    }
+    return ref;
+}
+
+static bool test_conversion(uint32_t width, uint32_t height, uint32_t factor, bool flip)
+{
+    std::vector<uint8_t> image(4 * size_t(width) * height);
+    for (uint8_t& v : image) v = random_byte();
+
+    Pixel_Conversion conversion;
+    conversion.settings.outputs = PIXEL_OUTPUT_RGBA8 | PIXEL_OUTPUT_GRAY8 | PIXEL_OUTPUT_CHW_FLOAT32;
+    conversion.settings.downsample_factor = factor;
+    conversion.settings.flip_vertical = flip;
+    conversion.settings.mean[0] = 0.485f; conversion.settings.mean[1] = 0.456f; conversion.settings.mean[2] = 0.406f;
+    conversion.settings.std[0] = 0.229f;  conversion.settings.std[1] = 0.224f;  conversion.settings.std[2] = 0.225f;
+
+    convert_pixels(&conversion, image.data(), width, height);
+    Reference ref = convert_pixels_reference(conversion.settings, image.data(), width, height);
+
+    if (conversion.width != ref.width || conversion.height != ref.height) {
+        printf("FAILED %ux%u factor %u: size %ux%u, expected %ux%u\n", width, height, factor,
+               conversion.width, conversion.height, ref.width, ref.height);
+        return false;
+    }
+    for (size_t i = 0; i < ref.rgba8.size(); ++i) {
+        if (conversion.rgba8[i] != ref.rgba8[i]) {
+            printf("FAILED %ux%u factor %u flip %d: rgba8[%zu] = %u, expected %u\n", width, height, factor, flip,
+                   i, conversion.rgba8[i], ref.rgba8[i]);
+            return false;
+        }
+    }
+    for (size_t i = 0; i < ref.gray8.size(); ++i) {
+        if (conversion.gray8[i] != ref.gray8[i]) {
+            printf("FAILED %ux%u factor %u flip %d: gray8[%zu] = %u, expected %u\n", width, height, factor, flip,
+                   i, conversion.gray8[i], ref.gray8[i]);
+            return false;
+        }
+    }
+    for (size_t i = 0; i < ref.chw_float32.size(); ++i) {
+        if (std::fabs(conversion.chw_float32[i] - ref.chw_float32[i]) > 1e-5f) {
+            printf("FAILED %ux%u factor %u flip %d: chw_float32[%zu] = %f, expected %f\n", width, height, factor, flip,
+                   i, conversion.chw_float32[i], ref.chw_float32[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    const uint32_t widths[] = {1, 2, 3, 5, 7, 8, 9, 15, 16, 17, 31, 33, 63, 65, 127};
+    const uint32_t heights[] = {1, 3, 8, 9};
+
+    int n_failed = 0;
+    int n_tests = 0;
+    for (uint32_t width : widths) {
+        for (uint32_t height : heights) {
+            for (uint32_t factor = 1; factor <= 4; ++factor) {
+                if (width < factor || height < factor) continue;
+                for (int flip = 0; flip < 2; ++flip) {
+                    n_tests++;
+                    if (!test_conversion(width, height, factor, flip)) n_failed++;
+                }
+            }
+        }
+    }
+
+    printf("pixel conversion: %d of %d tests passed\n", n_tests - n_failed, n_tests);
+    return n_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,245 @@
+#include <polyline_ring.hpp>
+
+#include "test_common.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <vector>
+
+/*
+ * Checks the slot bookkeeping of the polylines against a plain list of the points. A simulated polyline
+ * keeps the cpu slots and a "gpu" copy, which is only updated through the dirty runs, both in ring
+ * buffer mode (overwriting the oldest points) and in growing mode.
+ */
+
+struct Test_Polyline {
+    Polyline_Ring ring;
+    bool ring_buffer = false;
+    std::vector<int> slots;    // cpu copy of the points
+    std::vector<int> gpu;      // what the vertex buffer holds
+    std::vector<uint32_t> indices;
+    std::deque<int> reference; // all live points, oldest first
+    int next_value = 1;
+};
+
+static void create(Test_Polyline* polyline, uint32_t capacity, bool ring_buffer)
+{
+    polyline->ring = {};
+    polyline->ring.capacity = capacity;
+    polyline->ring_buffer = ring_buffer;
+    polyline->slots.assign(capacity, 0);
+    polyline->gpu.assign(capacity, -1);
+    polyline->indices.resize(polyline_index_count(capacity));
+    polyline_fill_indices(polyline->indices.data(), capacity);
+    polyline->reference.clear();
+}
+
+// Mirrors polyline_append_points.
+static void append(Test_Polyline* polyline, uint32_t n)
+{
+    Polyline_Ring* ring = &polyline->ring;
+    std::vector<int> points(n);
+    for (uint32_t i = 0; i < n; ++i) points[i] = polyline->next_value++;
+
+    if (!polyline->ring_buffer && ring->n_points + n > ring->capacity) {
+        uint32_t new_capacity = ring->capacity;
+        while (new_capacity < ring->n_points + n) new_capacity *= 2;
+        // new buffers, the old vertex buffer content is gone
+        polyline->gpu.assign(new_capacity, -1);
+        polyline->indices.resize(polyline_index_count(new_capacity));
+        polyline_fill_indices(polyline->indices.data(), new_capacity);
+        polyline->slots.resize(new_capacity);
+        polyline_ring_grow(ring, new_capacity);
+    }
+
+    uint32_t offset = 0;
+    if (n > ring->capacity) {
+        offset = n - ring->capacity;
+        n = ring->capacity;
+    }
+    uint32_t n_overwritten = 0;
+    uint32_t first_slot = polyline_ring_push(ring, n, &n_overwritten);
+    for (uint32_t i = 0; i < n; ++i) {
+        polyline->slots[(first_slot + i) % ring->capacity] = points[offset + i];
+    }
+
+    uint32_t n_before = uint32_t(polyline->reference.size());
+    for (int p : points) polyline->reference.push_back(p);
+    while (polyline->reference.size() > ring->capacity) polyline->reference.pop_front();
+    uint32_t n_dropped = n_before + uint32_t(points.size()) - uint32_t(polyline->reference.size());
+    // the points dropped from the new batch itself never got a slot
+    CHECK(n_overwritten == n_dropped - offset);
+}
+
+// Mirrors polylines_upload.
+static void upload(Test_Polyline* polyline)
+{
+    Polyline_Dirty_Runs runs = polyline_ring_dirty_runs(polyline->ring);
+    CHECK(runs.n_runs <= 2);
+    uint32_t n_uploaded = 0;
+    for (uint32_t r = 0; r < runs.n_runs; ++r) {
+        CHECK(runs.count[r] > 0);
+        CHECK(runs.first[r] + runs.count[r] <= polyline->ring.capacity);
+        for (uint32_t i = 0; i < runs.count[r]; ++i) {
+            polyline->gpu[runs.first[r] + i] = polyline->slots[runs.first[r] + i];
+        }
+        n_uploaded += runs.count[r];
+    }
+    CHECK(n_uploaded == polyline->ring.n_dirty);
+    polyline->ring.n_dirty = 0;
+}
+
+// What the gpu draws has to be exactly the segments between consecutive reference points.
+static bool draws_reference(const Test_Polyline& polyline)
+{
+    uint32_t first_index, n_indices;
+    polyline_ring_index_range(polyline.ring, &first_index, &n_indices);
+    size_t n_points = polyline.reference.size();
+    if (polyline.ring.n_points != n_points) return false;
+    if (n_indices != (n_points > 1 ? 2 * (n_points - 1) : 0)) return false;
+    if (first_index + n_indices > polyline.indices.size()) return false;
+
+    for (uint32_t s = 0; s < n_indices / 2; ++s) {
+        int a = polyline.gpu[polyline.indices[first_index + 2 * s + 0]];
+        int b = polyline.gpu[polyline.indices[first_index + 2 * s + 1]];
+        if (a != polyline.reference[s] || b != polyline.reference[s + 1]) return false;
+    }
+    for (uint32_t i = 0; i < n_points; ++i) {
+        if (polyline.slots[polyline_ring_slot(polyline.ring, i)] != polyline.reference[i]) return false;
+    }
+    return true;
+}
+
+static void test_wrap_around()
+{
+    Test_Polyline polyline;
+    create(&polyline, 5, true);
+
+    append(&polyline, 3);
+    upload(&polyline);
+    CHECK(draws_reference(polyline));
+    CHECK(polyline.ring.head == 0);
+
+    // fills the ring and overwrites the two oldest, the dirty range wraps around the end
+    append(&polyline, 4);
+    Polyline_Dirty_Runs runs = polyline_ring_dirty_runs(polyline.ring);
+    CHECK(runs.n_runs == 2);
+    CHECK(runs.first[0] == 3 && runs.count[0] == 2);
+    CHECK(runs.first[1] == 0 && runs.count[1] == 2);
+    CHECK(polyline.ring.head == 2);
+    upload(&polyline);
+    CHECK(draws_reference(polyline));
+
+    // more points than the ring holds, only the newest survive and everything is dirty
+    append(&polyline, 12);
+    CHECK(polyline.ring.n_dirty == 5);
+    upload(&polyline);
+    CHECK(draws_reference(polyline));
+
+    // several appends between two uploads
+    append(&polyline, 1);
+    append(&polyline, 2);
+    CHECK(polyline.ring.n_dirty == 3);
+    upload(&polyline);
+    CHECK(draws_reference(polyline));
+}
+
+static void test_growth()
+{
+    Test_Polyline polyline;
+    create(&polyline, 2, false);
+
+    append(&polyline, 1);
+    upload(&polyline);
+    CHECK(draws_reference(polyline));
+
+    append(&polyline, 4);
+    CHECK(polyline.ring.capacity == 8);
+    CHECK(polyline.ring.head == 0);
+    // the new buffers need all points
+    CHECK(polyline.ring.dirty_first == 0 && polyline.ring.n_dirty == 5);
+    upload(&polyline);
+    CHECK(draws_reference(polyline));
+
+    append(&polyline, 3);
+    CHECK(polyline.ring.capacity == 8);
+    CHECK(polyline.ring.dirty_first == 5 && polyline.ring.n_dirty == 3);
+    upload(&polyline);
+    CHECK(draws_reference(polyline));
+
+    append(&polyline, 100);
+    CHECK(polyline.ring.capacity == 128);
+    CHECK(polyline.reference.size() == 108);
+    upload(&polyline);
+    CHECK(draws_reference(polyline));
+}
+
+static void test_clear()
+{
+    Test_Polyline polyline;
+    create(&polyline, 4, true);
+    append(&polyline, 6);
+    polyline_ring_clear(&polyline.ring);
+    polyline.reference.clear();
+    CHECK(polyline_ring_dirty_runs(polyline.ring).n_runs == 0);
+    CHECK(draws_reference(polyline));
+
+    append(&polyline, 2);
+    CHECK(polyline.ring.head == 0 && polyline.ring.dirty_first == 0);
+    upload(&polyline);
+    CHECK(draws_reference(polyline));
+}
+
+static void test_random_appends(bool ring_buffer)
+{
+    srand(1234);
+    for (int round = 0; round < 50; ++round) {
+        Test_Polyline polyline;
+        create(&polyline, 2 + uint32_t(rand() % 20), ring_buffer);
+        for (int step = 0; step < 200; ++step) {
+            int action = rand() % 10;
+            if (action < 6) {
+                append(&polyline, 1 + uint32_t(rand() % 30));
+            }
+            else if (action < 9) {
+                upload(&polyline);
+                if (!draws_reference(polyline)) {
+                    printf("FAILED: round %d step %d (ring buffer %d) draws the wrong segments\n", round, step, int(ring_buffer));
+                    n_failed++;
+                    return;
+                }
+            }
+            else {
+                polyline_ring_clear(&polyline.ring);
+                polyline.reference.clear();
+            }
+        }
+    }
+}
+
+static void test_index_limits()
+{
+    CHECK(uint64_t(polyline_index_count(ENV_POLYLINE_MAX_CAPACITY)) == 4ull * ENV_POLYLINE_MAX_CAPACITY);
+    CHECK(12ull * ENV_POLYLINE_MAX_CAPACITY <= UINT32_MAX);
+
+    // the largest index range of a full ring stays inside the index buffer
+    Polyline_Ring ring;
+    ring.capacity = ENV_POLYLINE_MAX_CAPACITY;
+    ring.head = ring.capacity - 1;
+    ring.n_points = ring.capacity;
+    uint32_t first_index, n_indices;
+    polyline_ring_index_range(ring, &first_index, &n_indices);
+    CHECK(uint64_t(first_index) + n_indices <= polyline_index_count(ring.capacity));
+}
+
+int main()
+{
+    test_wrap_around();
+    test_growth();
+    test_clear();
+    test_random_appends(true);
+    test_random_appends(false);
+    test_index_limits();
+    return finish_tests("polyline ring");
+}
@@ -0,0 +1,102 @@
+#include <primitive_mesh.hpp>
+
+#include "test_common.hpp"
+
+#include <cmath>
+#include <cstdio>
+
+/*
+ * Checks the unit meshes of the primitives: valid indices, unit normals, the extents and, through
+ * the divergence theorem, that the closed kinds are watertight and wound outwards.
+ */
+
+struct Expected_Mesh {
+    Primitive_Geometry_Kind kind;
+    const char* name;
+    fmath::float3 aabb_min;
+    fmath::float3 aabb_max;
+    double volume; // of the ideal shape, 0 for the open kinds
+};
+
+static const double PI_D = 3.141592653589793;
+
+static const Expected_Mesh expected_meshes[] = {
+    {PRIMITIVE_GEOMETRY_PLANE,      "plane",      {-0.5f, 0.0f, -0.5f},  {0.5f, 0.0f, 0.5f}, 0.0},
+    {PRIMITIVE_GEOMETRY_BOX,        "box",        {-0.5f, -0.5f, -0.5f}, {0.5f, 0.5f, 0.5f}, 1.0},
+    {PRIMITIVE_GEOMETRY_SPHERE,     "sphere",     {-0.5f, -0.5f, -0.5f}, {0.5f, 0.5f, 0.5f}, PI_D / 6.0},
+    {PRIMITIVE_GEOMETRY_HEMISPHERE, "hemisphere", {-0.5f, 0.0f, -0.5f},  {0.5f, 0.5f, 0.5f}, 0.0},
+    {PRIMITIVE_GEOMETRY_CYLINDER,   "cylinder",   {-0.5f, -0.5f, -0.5f}, {0.5f, 0.5f, 0.5f}, PI_D / 4.0},
+    {PRIMITIVE_GEOMETRY_CONE,       "cone",       {-0.5f, -0.5f, -0.5f}, {0.5f, 0.5f, 0.5f}, PI_D / 12.0},
+};
+
+static bool near(float a, float b, float tolerance) { return std::fabs(a - b) <= tolerance; }
+
+static void check_mesh(const Expected_Mesh& expected, uint32_t segments)
+{
+    Mesh_Data mesh = build_primitive_mesh(expected.kind, segments);
+    size_t n_vertices = mesh.positions.size();
+    int n_failed_before = n_failed;
+
+    CHECK(n_vertices > 0);
+    CHECK(mesh.normals.size() == n_vertices);
+    CHECK(!mesh.indices.empty() && mesh.indices.size() % 3 == 0);
+    for (uint32_t index : mesh.indices) {
+        CHECK(index < n_vertices);
+    }
+
+    fmath::float3 aabb_min = mesh.positions[0];
+    fmath::float3 aabb_max = mesh.positions[0];
+    for (size_t i = 0; i < n_vertices; ++i) {
+        const fmath::float3& p = mesh.positions[i];
+        for (int axis = 0; axis < 3; ++axis) {
+            aabb_min[axis] = std::fmin(aabb_min[axis], p[axis]);
+            aabb_max[axis] = std::fmax(aabb_max[axis], p[axis]);
+        }
+        CHECK(near(length(mesh.normals[i]), 1.0f, 1e-5f));
+    }
+    // with a multiple of 4 segments there are vertices on the x and z axes, otherwise the mesh stays inside
+    bool touches_aabb = segments % 4 == 0;
+    for (int axis = 0; axis < 3; ++axis) {
+        if (touches_aabb) {
+            CHECK(near(aabb_min[axis], expected.aabb_min[axis], 1e-5f));
+            CHECK(near(aabb_max[axis], expected.aabb_max[axis], 1e-5f));
+        }
+        else {
+            CHECK(aabb_min[axis] >= expected.aabb_min[axis] - 1e-5f);
+            CHECK(aabb_max[axis] <= expected.aabb_max[axis] + 1e-5f);
+        }
+    }
+
+    double volume = 0.0;
+    for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+        const fmath::float3& a = mesh.positions[mesh.indices[i + 0]];
+        const fmath::float3& b = mesh.positions[mesh.indices[i + 1]];
+        const fmath::float3& c = mesh.positions[mesh.indices[i + 2]];
+        fmath::float3 face_normal = cross(b - a, c - a);
+        fmath::float3 vertex_normal = mesh.normals[mesh.indices[i + 0]] + mesh.normals[mesh.indices[i + 1]] + mesh.normals[mesh.indices[i + 2]];
+        CHECK(dot(face_normal, vertex_normal) > 0.0f);
+        volume += dot(a, cross(b, c)) / 6.0;
+    }
+    if (expected.volume > 0.0) {
+        // a positive volume means closed and wound outwards, the tessellation only ever cuts the round shapes down
+        CHECK(volume > 0.0);
+        CHECK(volume <= expected.volume * 1.0001);
+        if (segments >= 32) CHECK(volume >= expected.volume * (segments >= 256 ? 0.999 : 0.98));
+    }
+
+    if (n_failed != n_failed_before) {
+        printf("  in the %s with %u segments (volume %f, expected %f)\n", expected.name, segments, volume, expected.volume);
+    }
+}
+
+int main()
+{
+    const uint32_t tessellations[] = {3, 4, 7, 8, 32, 64, 256};
+    for (const Expected_Mesh& expected : expected_meshes) {
+        for (uint32_t segments : tessellations) {
+            check_mesh(expected, segments);
+        }
+    }
+
+    return finish_tests("primitive mesh");
+}
@@ -0,0 +1,101 @@
+#include <segmentation_id.hpp>
+
+#include "test_common.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+/*
+ * Checks the mask id encoding: the color an id is drawn with must come back as the same id once the
+ * gpu has stored it as RGBA8, over the whole 24 bit range, and an untouched black pixel decodes to 0.
+ */
+
+// What the RGBA8 render target stores for a linear color channel (no post-processing in the mask pass).
+static uint8_t quantize_unorm8(float value)
+{
+    return uint8_t(std::lround(value * 255.0f));
+}
+
+static uint32_t draw_and_read_back(uint32_t mask_id)
+{
+    float color[3];
+    segmentation_id_color(mask_id, color);
+    uint8_t px[4] = {quantize_unorm8(color[0]), quantize_unorm8(color[1]), quantize_unorm8(color[2]), 255};
+    return segmentation_decode_pixel(px);
+}
+
+static void test_channels_exact()
+{
+    // k / 255 has to survive the float round trip for every channel value
+    for (uint32_t k = 0; k <= 0xFF; ++k) {
+        float color[3];
+        segmentation_id_color(k | (k << 8) | (k << 16), color);
+        CHECK(quantize_unorm8(color[0]) == k);
+        CHECK(quantize_unorm8(color[1]) == k);
+        CHECK(quantize_unorm8(color[2]) == k);
+        CHECK(std::fabs(color[0] * 255.0f - float(k)) < 1e-3f);
+    }
+}
+
+static void test_round_trip()
+{
+    CHECK(draw_and_read_back(1) == 1);
+    CHECK(draw_and_read_back(0xFF) == 0xFF);
+    CHECK(draw_and_read_back(0x100) == 0x100);
+    CHECK(draw_and_read_back(0xFFFF) == 0xFFFF);
+    CHECK(draw_and_read_back(0x10000) == 0x10000);
+    CHECK(draw_and_read_back(ENV_SEGMENTATION_MAX_ID) == ENV_SEGMENTATION_MAX_ID);
+
+    // a spread of ids over the whole range
+    for (uint32_t mask_id = 1; mask_id <= ENV_SEGMENTATION_MAX_ID; mask_id += 997) {
+        if (draw_and_read_back(mask_id) != mask_id) {
+            printf("FAILED: mask id %u does not survive the round trip\n", mask_id);
+            n_failed++;
+            break;
+        }
+    }
+}
+
+static void test_background_and_alpha()
+{
+    // the black skybox of the mask pass
+    uint8_t background[4] = {0, 0, 0, 255};
+    CHECK(segmentation_decode_pixel(background) == 0);
+
+    // alpha is not part of the id
+    uint8_t px[4] = {0x12, 0x34, 0x56, 0x00};
+    CHECK(segmentation_decode_pixel(px) == 0x563412);
+    px[3] = 0xAB;
+    CHECK(segmentation_decode_pixel(px) == 0x563412);
+}
+
+static void test_decode_mask_in_place()
+{
+    const uint32_t width = 5, height = 3;
+    std::vector<uint32_t> expected(width * height);
+    std::vector<uint8_t> rgba(4 * width * height);
+    for (uint32_t i = 0; i < width * height; ++i) {
+        uint32_t mask_id = (i % 4 == 0) ? 0 : (i * 0x010203u) & ENV_SEGMENTATION_MAX_ID;
+        expected[i] = mask_id;
+        rgba[4 * i + 0] = uint8_t(mask_id >> 0);
+        rgba[4 * i + 1] = uint8_t(mask_id >> 8);
+        rgba[4 * i + 2] = uint8_t(mask_id >> 16);
+        rgba[4 * i + 3] = 255;
+    }
+
+    segmentation_decode_mask(rgba.data(), width, height);
+    const uint32_t* mask_ids = (const uint32_t*)rgba.data();
+    for (uint32_t i = 0; i < width * height; ++i) {
+        CHECK(mask_ids[i] == expected[i]);
+    }
+}
+
+int main()
+{
+    test_channels_exact();
+    test_round_trip();
+    test_background_and_alpha();
+    test_decode_mask_in_place();
+    return finish_tests("segmentation id");
+}
@@ -0,0 +1,205 @@
+#include <shm_export.hpp>
+
+#include "test_common.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+/*
+ * Checks the shared memory ring from the side of a reader in another process: the object is opened by
+ * name and only the layout documented in environments.hpp is used to find the slots and their pixels.
+ */
+
+struct Reader_Mapping {
+    void* data = nullptr;
+    size_t size = 0;
+};
+
+static Reader_Mapping map_as_reader(const std::string& name)
+{
+    Reader_Mapping mapping;
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) return mapping;
+    struct stat st;
+    if (fstat(fd, &st) == 0) {
+        void* data = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        if (data != MAP_FAILED) {
+            mapping.data = data;
+            mapping.size = size_t(st.st_size);
+        }
+    }
+    close(fd);
+    return mapping;
+}
+
+static void unmap_reader(Reader_Mapping* mapping)
+{
+    if (mapping->data) munmap(mapping->data, mapping->size);
+    *mapping = {};
+}
+
+static const Shm_Ring_Header* reader_header(const Reader_Mapping& mapping)
+{
+    return (const Shm_Ring_Header*)mapping.data;
+}
+
+static const Shm_Slot_Header* reader_slot(const Reader_Mapping& mapping, uint32_t slot_idx)
+{
+    return (const Shm_Slot_Header*)((const uint8_t*)mapping.data + 64 + slot_idx * reader_header(mapping)->slot_stride);
+}
+
+static std::string test_name()
+{
+    return "/env_shm_export_test_" + std::to_string(getpid());
+}
+
+static void test_header_layout()
+{
+    CHECK(sizeof(Shm_Ring_Header) <= 64);
+    CHECK(alignof(Shm_Slot_Header) == 64);
+
+    std::string name = test_name();
+    // the leading slash is optional
+    Shm_Export* shm = shm_export_create(name.c_str() + 1, 3, 1000);
+    CHECK(shm != nullptr);
+    if (!shm) return;
+
+    Reader_Mapping mapping = map_as_reader(name);
+    CHECK(mapping.data != nullptr);
+    if (mapping.data) {
+        const Shm_Ring_Header* header = reader_header(mapping);
+        CHECK(header->magic == ENV_SHM_MAGIC);
+        CHECK(header->version == ENV_SHM_VERSION);
+        CHECK(header->n_slots == 3);
+        CHECK(header->slot_capacity == 1000);
+        CHECK(header->latest_slot == ENV_SHM_NO_SLOT);
+        CHECK(header->data_offset >= sizeof(Shm_Slot_Header));
+        CHECK(header->data_offset % 64 == 0);
+        CHECK(header->slot_stride % 64 == 0);
+        CHECK(header->slot_stride >= header->data_offset + header->slot_capacity);
+        CHECK(mapping.size >= 64 + header->n_slots * header->slot_stride);
+        for (uint32_t i = 0; i < header->n_slots; ++i) {
+            CHECK(reader_slot(mapping, i)->seqlock == 0);
+        }
+    }
+    unmap_reader(&mapping);
+    shm_export_destroy(shm);
+
+    // the name is gone after destroying the export
+    CHECK(shm_open(name.c_str(), O_RDONLY, 0) < 0);
+}
+
+static void test_invalid_names()
+{
+    CHECK(shm_export_create("/", 2, 64) == nullptr);
+    CHECK(shm_export_create("a/b", 2, 64) == nullptr);
+    CHECK(shm_export_create("/a/b", 2, 64) == nullptr);
+}
+
+static void test_write_sequence()
+{
+    std::string name = test_name();
+    Shm_Export* shm = shm_export_create(name.c_str(), 2, 256);
+    CHECK(shm != nullptr);
+    if (!shm) return;
+    Reader_Mapping mapping = map_as_reader(name);
+    CHECK(mapping.data != nullptr);
+    if (!mapping.data) {
+        shm_export_destroy(shm);
+        return;
+    }
+    const Shm_Ring_Header* header = reader_header(mapping);
+
+    // too large for the slot, or a slot that doesn't exist
+    CHECK(shm_export_begin_write(shm, 0, 1, 16, 16, 0, 0, 257) == nullptr);
+    CHECK(shm_export_begin_write(shm, 2, 1, 8, 8, 0, 0, 64) == nullptr);
+    CHECK(reader_slot(mapping, 0)->seqlock == 0);
+
+    for (uint64_t frame_index = 1; frame_index <= 5; ++frame_index) {
+        uint32_t slot_idx = uint32_t(frame_index % 2);
+        const Shm_Slot_Header* slot = reader_slot(mapping, slot_idx);
+        uint64_t seq_before = slot->seqlock;
+        CHECK(seq_before % 2 == 0);
+
+        uint8_t* pixels = (uint8_t*)shm_export_begin_write(shm, slot_idx, frame_index, 8, 4, 7, 9, 128);
+        CHECK(pixels != nullptr);
+        if (!pixels) break;
+        // a reader sees the slot as being written
+        CHECK(slot->seqlock == seq_before + 1);
+        CHECK((const uint8_t*)pixels == (const uint8_t*)shm->mapping + ((const uint8_t*)slot - (const uint8_t*)mapping.data) + header->data_offset);
+        memset(pixels, int(frame_index), 128);
+        shm_export_end_write(shm, slot_idx);
+
+        CHECK(slot->seqlock == seq_before + 2);
+        CHECK(header->latest_slot == slot_idx);
+        CHECK(slot->frame_index == frame_index);
+        CHECK(slot->size == 128);
+        CHECK(slot->width == 8);
+        CHECK(slot->height == 4);
+        CHECK(slot->pixel_data_format == 7);
+        CHECK(slot->pixel_data_type == 9);
+        CHECK(slot->timestamp_ns != 0);
+        const uint8_t* read_pixels = (const uint8_t*)slot + header->data_offset;
+        CHECK(read_pixels[0] == uint8_t(frame_index) && read_pixels[127] == uint8_t(frame_index));
+    }
+
+    // the other slot still holds the previous frame
+    CHECK(reader_slot(mapping, 0)->frame_index == 4);
+
+    unmap_reader(&mapping);
+    shm_export_destroy(shm);
+}
+
+static void test_recreate_under_reader()
+{
+    std::string name = test_name();
+    Shm_Export* shm = shm_export_create(name.c_str(), 2, 4096);
+    CHECK(shm != nullptr);
+    if (!shm) return;
+    uint8_t* pixels = (uint8_t*)shm_export_begin_write(shm, 1, 42, 32, 32, 0, 0, 4096);
+    if (pixels) memset(pixels, 0xAB, 4096);
+    shm_export_end_write(shm, 1);
+
+    Reader_Mapping old_mapping = map_as_reader(name);
+    CHECK(old_mapping.data != nullptr);
+
+    // a smaller ring under the same name must not shrink the object the reader still has mapped
+    shm_export_destroy(shm);
+    shm = shm_export_create(name.c_str(), 1, 64);
+    CHECK(shm != nullptr);
+
+    if (old_mapping.data) {
+        // would be SIGBUS if the old object had been truncated
+        const Shm_Slot_Header* slot = reader_slot(old_mapping, 1);
+        const uint8_t* old_pixels = (const uint8_t*)slot + reader_header(old_mapping)->data_offset;
+        CHECK(slot->frame_index == 42);
+        CHECK(old_pixels[0] == 0xAB && old_pixels[4095] == 0xAB);
+    }
+
+    Reader_Mapping new_mapping = map_as_reader(name);
+    CHECK(new_mapping.data != nullptr);
+    if (new_mapping.data) {
+        CHECK(reader_header(new_mapping)->n_slots == 1);
+        CHECK(reader_header(new_mapping)->slot_capacity == 64);
+        CHECK(reader_header(new_mapping)->latest_slot == ENV_SHM_NO_SLOT);
+    }
+
+    unmap_reader(&new_mapping);
+    unmap_reader(&old_mapping);
+    shm_export_destroy(shm);
+}
+
+int main()
+{
+    test_header_layout();
+    test_invalid_names();
+    test_write_sequence();
+    test_recreate_under_reader();
+    return finish_tests("shm export");
+}
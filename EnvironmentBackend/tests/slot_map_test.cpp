@@ -0,0 +1,149 @@
+#include <slot_map.hpp>
+
+#include "test_common.hpp"
+
+#include <cstdio>
+
+/*
+ * Checks the generational slot map behind the object handles: lookups, stale handle detection,
+ * slot reuse, the dense live list and the retirement of slots whose generation runs out.
+ */
+
+typedef Slot_Map<int, 3> Test_Map;
+
+static bool live_list_consistent(const Test_Map& map)
+{
+    size_t n_alive = 0;
+    for (const Test_Map::Slot& slot : map.slots) {
+        if (slot.alive) n_alive++;
+    }
+    if (n_alive != map.live.size()) return false;
+    for (uint32_t i = 0; i < map.live.size(); ++i) {
+        const Test_Map::Slot& slot = map.slots[map.live[i]];
+        if (!slot.alive || slot.live_idx != i) return false;
+    }
+    return true;
+}
+
+static void test_handles()
+{
+    uint64_t handle = make_handle(200, ENV_HANDLE_MAX_GENERATION, 0xFFFFFFFF);
+    CHECK(handle_tag(handle) == 200);
+    CHECK(handle_generation(handle) == ENV_HANDLE_MAX_GENERATION);
+    CHECK(handle_slot_idx(handle) == 0xFFFFFFFF);
+    CHECK(make_handle(1, 1, 0) != 0);
+}
+
+static void test_insert_find_erase()
+{
+    Test_Map map;
+    uint64_t a = map.insert(10, 0);
+    uint64_t b = map.insert(20, 1);
+    uint64_t c = map.insert(30, 2);
+    CHECK(map.size() == 3);
+    CHECK(handle_tag(a) == 3);
+    CHECK(map.find(a) && *map.find(a) == 10);
+    CHECK(map.find(b) && *map.find(b) == 20);
+    CHECK(map.find(c) && *map.find(c) == 30);
+
+    // wrong tag and out of range slots
+    CHECK(map.find(make_handle(4, handle_generation(a), handle_slot_idx(a))) == nullptr);
+    CHECK(map.find(make_handle(3, 1, 100)) == nullptr);
+    CHECK(map.find(0) == nullptr);
+
+    CHECK(map.erase(a));
+    CHECK(!map.erase(a));
+    CHECK(map.find(a) == nullptr);
+    CHECK(map.find(b) && *map.find(b) == 20);
+    CHECK(map.find(c) && *map.find(c) == 30);
+    CHECK(map.size() == 2);
+    CHECK(live_list_consistent(map));
+
+    // the freed slot is reused with a new generation, the old handle stays stale
+    uint64_t d = map.insert(40, 3);
+    CHECK(handle_slot_idx(d) == handle_slot_idx(a));
+    CHECK(handle_generation(d) == handle_generation(a) + 1);
+    CHECK(map.find(a) == nullptr);
+    CHECK(map.find(d) && *map.find(d) == 40);
+    CHECK(live_list_consistent(map));
+}
+
+static void test_clear()
+{
+    Test_Map map;
+    uint64_t handles[64];
+    for (int i = 0; i < 64; ++i) {
+        handles[i] = map.insert(i, i);
+    }
+    for (int i = 0; i < 64; i += 3) {
+        CHECK(map.erase(handles[i]));
+    }
+    CHECK(live_list_consistent(map));
+
+    map.clear();
+    CHECK(map.empty());
+    CHECK(live_list_consistent(map));
+    for (int i = 0; i < 64; ++i) {
+        CHECK(map.find(handles[i]) == nullptr);
+    }
+
+    uint64_t h = map.insert(7, 0);
+    CHECK(map.find(h) && *map.find(h) == 7);
+    CHECK(map.slots.size() == 64);
+}
+
+static void test_live_list_under_churn()
+{
+    Test_Map map;
+    std::vector<uint64_t> handles;
+    uint32_t random_state = 1;
+    for (int i = 0; i < 10000; ++i) {
+        random_state = random_state * 1664525u + 1013904223u;
+        if (handles.empty() || (random_state >> 16) % 3 != 0) {
+            handles.push_back(map.insert(i, i));
+        }
+        else {
+            size_t k = (random_state >> 8) % handles.size();
+            CHECK(map.erase(handles[k]));
+            handles[k] = handles.back();
+            handles.pop_back();
+        }
+    }
+    CHECK(map.size() == handles.size());
+    CHECK(live_list_consistent(map));
+    for (uint64_t h : handles) {
+        CHECK(map.find(h) != nullptr);
+    }
+}
+
+static void test_generation_retirement()
+{
+    Test_Map map;
+    uint64_t h = map.insert(1, 0);
+    uint32_t slot_idx = handle_slot_idx(h);
+    map.erase(h);
+
+    // skip to the last generation instead of cycling through 2^24 of them
+    map.slots[slot_idx].generation = ENV_HANDLE_MAX_GENERATION;
+    uint64_t last = map.insert(2, 1);
+    CHECK(handle_slot_idx(last) == slot_idx);
+    CHECK(handle_generation(last) == ENV_HANDLE_MAX_GENERATION);
+    CHECK(map.erase(last));
+
+    // the slot is retired, new objects get a fresh slot
+    uint64_t next = map.insert(3, 2);
+    CHECK(handle_slot_idx(next) != slot_idx);
+    CHECK(map.find(last) == nullptr);
+    CHECK(map.free_slots.empty());
+}
+
+int main()
+{
+    test_handles();
+    test_insert_find_erase();
+    test_clear();
+    test_live_list_under_churn();
+    test_generation_retirement();
+
+    return finish_tests("slot map");
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+
+/*
+ * The checks shared by the unit tests, every test is a single translation unit with its own main().
+ * Failed checks are printed and counted, the test keeps going so one run shows all failures.
+ */
+
+static int n_failed = 0;
+
+#define CHECK(condition)                                                  \
+    do {                                                                  \
+        if (!(condition)) {                                               \
+            printf("FAILED %s:%d: %s\n", __FILE__, __LINE__, #condition); \
+            n_failed++;                                                   \
+        }                                                                 \
+    } while (false)
+
+#define CHECK_NEAR(value, expected, tolerance)                                                          \
+    do {                                                                                                \
+        double v_ = (value), e_ = (expected);                                                           \
+        if (!(std::fabs(v_ - e_) <= (tolerance))) {                                                     \
+            printf("FAILED %s:%d: %s = %f, expected %f\n", __FILE__, __LINE__, #value, v_, e_);          \
+            n_failed++;                                                                                 \
+        }                                                                                               \
+    } while (false)
+
+// The exit code of the test.
+static int finish_tests(const char* test_name)
+{
+    if (n_failed == 0) printf("%s: all tests passed\n", test_name);
+    return n_failed == 0 ? 0 : 1;
+}
@@ -23,6 +23,34 @@ const INVALID_UUID = 0
 
 destroy_everything()::Bool = @ccall libenv.destroy_everything()::Bool
 
+#
+# Disk Cache
+#
+# Expensive results (prefiltered skyboxes, ...) are reused across runs, by default from ~/.cache/tinydronessim.
+#
+
+"Move the disk cache, an empty path disables it."
+function set_cache_directory(path::CStaticString{N})::Bool where N
+    @ccall libenv.set_cache_directory(path::Cstring)::Bool
+end
+
+@enum glTF_Material_Mode::UInt32 begin
+    GLTF_MATERIALS_JIT = 0        # generated per material configuration, material packages are kept in the disk cache
+    GLTF_MATERIALS_UBERSHADER = 1 # precompiled ubershaders, no generation at all, but slower shaders
+end
+
+"How glTF materials are built, only takes effect before the first environment is created."
+set_gltf_material_mode(mode::glTF_Material_Mode)::Bool = @ccall libenv.set_gltf_material_mode(mode::glTF_Material_Mode)::Bool
+
+@enum Render_Platform::UInt32 begin
+    RENDER_PLATFORM_AUTO = 0     # headless when neither DISPLAY nor WAYLAND_DISPLAY is set
+    RENDER_PLATFORM_WINDOWED = 1 # GLX, needs a display
+    RENDER_PLATFORM_HEADLESS = 2 # EGL headless, windows are unavailable
+end
+
+"Which OpenGL platform the engine runs on, only takes effect before the first environment is created."
+set_render_platform(platform::Render_Platform)::Bool = @ccall libenv.set_render_platform(platform::Render_Platform)::Bool
+
 #
 # Environment Handling
 #
@@ -36,9 +64,13 @@ destroy(env::Environment_ID)::Bool = @ccall libenv.destroy_environment(env::Envi
 "Change the 'active environment' to different environment."
 environment_activate(env::Environment_ID)::Bool = @ccall libenv.environment_activate(env::Environment_ID)::Bool
 
+"Count the drawn and culled renderables of every camera render in this environment, see 'get_culling_stats'."
+environment_set_culling_stats(env::Environment_ID, enabled::Bool)::Bool = @ccall libenv.environment_set_culling_stats(env::Environment_ID, enabled::Bool)::Bool
+
 #
 # Adding an Image Based Lighting skybox to the scene.
 # Most image formats are supported, though you should use HDR images.
+# The prefiltered cubemaps are cached on disk, later runs with the same image skip the prefiltering.
 #
 function add_ibl_skybox(file_path::CStaticString{N})::Bool where N
     @ccall libenv.add_ibl_skybox(file_path::Cstring)::Bool
@@ -72,23 +104,101 @@ function add_unlit_material(material_name::CStaticString{N} = cstatic"DefaultMat
                                      emmisive::Float32_4)::Bool
 end
 
-"Importing .gltf or .glb files. Animations are not played automatically!"
+"Importing .gltf or .glb files. Animations are not played automatically, see `play_animation`. Unchanged files are instanced from a cache."
 function add_gltf_asset_and_create_instance(filepath::CStaticString{N})::glTF_Instance_ID where N
     @ccall libenv.add_gltf_asset_and_create_instance(filepath::Cstring)::glTF_Instance_ID
 end
 
+"Like `add_gltf_asset_and_create_instance`, but the textures are decoded in the background while rendering."
+function add_gltf_asset_and_create_instance_async(filepath::CStaticString{N})::glTF_Instance_ID where N
+    @ccall libenv.add_gltf_asset_and_create_instance_async(filepath::Cstring)::glTF_Instance_ID
+end
+
+"Loading progress in [0, 1] of the textures of an instance, -1 for invalid instances."
+gltf_load_progress(gltf_instance::glTF_Instance_ID)::Float32 = @ccall libenv.gltf_load_progress(gltf_instance::glTF_Instance_ID)::Float32
+
+"Drop a file from the glTF cache, its asset is freed once no instance of it is left."
+function evict_gltf_asset(filepath::CStaticString{N})::Bool where N
+    @ccall libenv.evict_gltf_asset(filepath::Cstring)::Bool
+end
+
+clear_gltf_asset_cache()::Bool = @ccall libenv.clear_gltf_asset_cache()::Bool
+
 "Get the associated filament entity, which can be used for changing pos/orientation among other things."
 get_filament_entity(gltf_instance::glTF_Instance_ID)::Filament_Entity_ID = @ccall libenv.get_gltf_instance_filament_entity(gltf_instance::glTF_Instance_ID)::Filament_Entity_ID
 
 "Create another instance using the parent gltf asset from this instance."
 create_gltf_instance_sibling(gltf_instance::glTF_Instance_ID)::glTF_Instance_ID = @ccall libenv.create_gltf_instance_sibling(gltf_instance::glTF_Instance_ID)::glTF_Instance_ID
 
+#
+# glTF animations, the animation indices are zero based.
+# Playing animations and spin channels only move with `advance_animations`, by simulation time, never by rendering.
+#
+
+get_animation_count(gltf_instance::glTF_Instance_ID)::UInt32 = @ccall libenv.get_gltf_animation_count(gltf_instance::glTF_Instance_ID)::UInt32
+
+"Index of the animation called 'name', -1 if there is none."
+function get_animation_index(gltf_instance::glTF_Instance_ID, name::CStaticString{N})::Int32 where N
+    @ccall libenv.get_gltf_animation_index(gltf_instance::glTF_Instance_ID, name::Cstring)::Int32
+end
+
+get_animation_duration(gltf_instance::glTF_Instance_ID, animation_index)::Float64 = @ccall libenv.get_gltf_animation_duration(gltf_instance::glTF_Instance_ID, animation_index::UInt32)::Float64
+play_animation(gltf_instance::glTF_Instance_ID, animation_index; loop = true)::Bool = @ccall libenv.play_gltf_animation(gltf_instance::glTF_Instance_ID, animation_index::UInt32, loop::Bool)::Bool
+stop_animation(gltf_instance::glTF_Instance_ID, animation_index)::Bool = @ccall libenv.stop_gltf_animation(gltf_instance::glTF_Instance_ID, animation_index::UInt32)::Bool
+set_animation_speed(gltf_instance::glTF_Instance_ID, animation_index, speed)::Bool = @ccall libenv.set_gltf_animation_speed(gltf_instance::glTF_Instance_ID, animation_index::UInt32, speed::Float64)::Bool
+set_animation_time(gltf_instance::glTF_Instance_ID, animation_index, time_s)::Bool = @ccall libenv.set_gltf_animation_time(gltf_instance::glTF_Instance_ID, animation_index::UInt32, time_s::Float64)::Bool
+
+"Advance all playing animations and spin channels of the environment by 'dt_s' seconds of simulation time."
+advance_animations(env::Environment_ID, dt_s)::Bool = @ccall libenv.advance_gltf_animations(env::Environment_ID, dt_s::Float64)::Bool
+
+"Spin the node 'node_name' around 'axis' (in the node's frame), returns the zero based channel index or -1."
+function add_spin_channel(gltf_instance::glTF_Instance_ID, node_name::CStaticString{N}, axis::Float32_3)::Int32 where N
+    @ccall libenv.add_gltf_spin_channel(gltf_instance::glTF_Instance_ID, node_name::Cstring, axis::Float32_3)::Int32
+end
+
+"Set the spin rates (rad/s) of many instances at once, column i of 'rates' holds the channel rates of instance i."
+function set_spin_rates(gltf_instances::Vector{glTF_Instance_ID}, rates::Matrix{Float32})::Bool
+    @assert size(rates, 2) == length(gltf_instances)
+    @ccall libenv.set_gltf_spin_rates(gltf_instances::Ptr{glTF_Instance_ID}, length(gltf_instances)::UInt32, rates::Ptr{Float32}, size(rates, 1)::UInt32)::Bool
+end
+
+"Set (or with 0, reset) the angle of a spin channel, relative to the rest pose of its node."
+set_spin_angle(gltf_instance::glTF_Instance_ID, channel_index, angle_rad)::Bool = @ccall libenv.set_gltf_spin_angle(gltf_instance::glTF_Instance_ID, channel_index::UInt32, angle_rad::Float64)::Bool
+
+"Draws many copies of an (untextured) glTF asset with gpu instancing, returns the root entity of the swarm."
+function add_swarm(gltf_path::CStaticString{N}, n_instances)::Filament_Entity_ID where N
+    @ccall libenv.add_swarm(gltf_path::Cstring, n_instances::UInt32)::Filament_Entity_ID
+end
+
+"Sets the transforms (relative to the swarm root) of the instances starting at 'first_instance' (zero based)."
+function set_swarm_transforms(swarm::Filament_Entity_ID, positions::Vector{Float64_3}, orientations::Vector{Quaternion}; first_instance = 0)::Bool
+    n = length(positions)
+    @assert length(orientations) == n
+    @ccall libenv.set_swarm_transforms(swarm::Filament_Entity_ID, positions::Ptr{Float64_3}, orientations::Ptr{Quaternion}, first_instance::UInt32, n::UInt32)::Bool
+end
+
 "Importing .filamesh mesh files. They can be generated with a tool from Google-Filament"
 function add_filamesh_from_file(path::CStaticString{N})::Filament_Entity_ID where N
     @ccall libenv.add_filamesh_from_file(path::Cstring)::Filament_Entity_ID
 end
 
 # Adding basic objects.
+
+@enum Primitive_Shape::UInt32 begin
+    PRIMITIVE_PLANE = 0    # size.x by size.z, facing +y
+    PRIMITIVE_BOX = 1      # edge lengths
+    PRIMITIVE_SPHERE = 2   # diameters
+    PRIMITIVE_CYLINDER = 3 # diameters in x and z, height in y
+    PRIMITIVE_CAPSULE = 4  # diameter size.x, total length size.y
+    PRIMITIVE_ARROW = 5    # head diameter size.x, total length size.y, points along +y
+end
+
+"Adds a primitive, all primitives of one shape share their geometry. 'tessellation = 0' uses the default."
+function add_primitive(shape::Primitive_Shape, center, size, material_name::CStaticString{N};
+                       rotation::Quaternion = identity_quaternion(), tessellation = 0)::Filament_Entity_ID where N
+    @ccall libenv.add_primitive(shape::UInt32, center::Float64_3, size::Float64_3, material_name::Cstring, rotation::Quaternion, tessellation::UInt32)::Filament_Entity_ID
+end
+
 function add_plane(center, length_x, length_z, material_name::CStaticString{N}; rotation::Quaternion = identity_quaternion())::Filament_Entity_ID where N
     @ccall libenv.add_plane(center::Float64_3, length_x::Float64, length_z::Float64, material_name::Cstring, rotation::Quaternion)::Filament_Entity_ID
 end
@@ -97,22 +207,124 @@ function add_line(begin_point, end_point, material_name::CStaticString{N})::Fila
     @ccall libenv.add_line(begin_point::Float64_3, end_point::Float64_3, material_name::Cstring)::Filament_Entity_ID
 end
 
+"A line strip rendered as one entity. With 'ring_buffer' only the last 'capacity' points are kept, otherwise it grows."
+function add_polyline(material_name::CStaticString{N}, capacity; ring_buffer::Bool = false)::Filament_Entity_ID where N
+    @ccall libenv.add_polyline(material_name::Cstring, capacity::UInt32, ring_buffer::Bool)::Filament_Entity_ID
+end
+
+function polyline_append_points(polyline::Filament_Entity_ID, points::Vector{Float64_3})::Bool
+    @ccall libenv.polyline_append_points(polyline::Filament_Entity_ID, points::Ptr{Float64_3}, length(points)::UInt32)::Bool
+end
+polyline_append_point(polyline::Filament_Entity_ID, point)::Bool = polyline_append_points(polyline, [Float64_3(point)])
+polyline_clear(polyline::Filament_Entity_ID)::Bool = @ccall libenv.polyline_clear(polyline::Filament_Entity_ID)::Bool
+
+"Points drawn as one entity, e.g. for lidar returns. The capacity grows as needed."
+function add_pointcloud(capacity; default_color = Float32_3(1.0, 1.0, 1.0))::Filament_Entity_ID
+    @ccall libenv.add_pointcloud(capacity::UInt32, default_color::Float32_3)::Filament_Entity_ID
+end
+
+"Replaces all points of the cloud, 'rgba' holds one RGBA8 color per point (or nothing for the default color)."
+function pointcloud_update(pointcloud::Filament_Entity_ID, points::Vector{Float32_3}, rgba::Union{Vector{UInt32}, Nothing} = nothing)::Bool
+    @assert isnothing(rgba) || length(rgba) == length(points)
+    rgba_ptr = isnothing(rgba) ? Ptr{UInt32}(C_NULL) : pointer(rgba)
+    GC.@preserve rgba @ccall libenv.pointcloud_update(pointcloud::Filament_Entity_ID, points::Ptr{Float32_3}, rgba_ptr::Ptr{UInt32}, length(points)::UInt32)::Bool
+end
+
+#
+# Immediate-mode debug drawing into the active environment.
+# The lines only show up in the next render of a window and have to be drawn again every frame.
+#
+
+debug_line(a, b; color = Float32_3(1.0, 1.0, 1.0))::Bool = @ccall libenv.debug_line(a::Float64_3, b::Float64_3, color::Float32_3)::Bool
+debug_arrow(origin, vector; color = Float32_3(1.0, 1.0, 1.0))::Bool = @ccall libenv.debug_arrow(origin::Float64_3, vector::Float64_3, color::Float32_3)::Bool
+"Draws the x (red), y (green) and z (blue) axes of a coordinate frame."
+debug_axes(position, orientation::Quaternion; length = 1.0)::Bool = @ccall libenv.debug_axes(position::Float64_3, orientation::Quaternion, length::Float64)::Bool
+debug_sphere_wire(center, radius; color = Float32_3(1.0, 1.0, 1.0))::Bool = @ccall libenv.debug_sphere_wire(center::Float64_3, radius::Float64, color::Float32_3)::Bool
+function debug_box_wire(center, half_extents; orientation::Quaternion = identity_quaternion(), color = Float32_3(1.0, 1.0, 1.0))::Bool
+    @ccall libenv.debug_box_wire(center::Float64_3, half_extents::Float64_3, orientation::Quaternion, color::Float32_3)::Bool
+end
+
+"Debug drawing only shows up in windows, enable it for other frames here."
+set_frame_debug_draw(frame::Frame_ID, visible::Bool)::Bool = @ccall libenv.set_frame_debug_draw(frame::Frame_ID, visible::Bool)::Bool
+
 exists(filament_entity::Filament_Entity_ID)::Bool = @ccall libenv.filament_entity_exists(filament_entity::Filament_Entity_ID)::Bool
 exists(gltf_instance::glTF_Instance_ID)::Bool = @ccall libenv.gltf_instance_exists(gltf_instance::glTF_Instance_ID)::Bool
+"Removes the entity from the scene and releases its buffers, the id is invalid afterwards."
+destroy(filament_entity::Filament_Entity_ID)::Bool = @ccall libenv.destroy_filament_entity(filament_entity::Filament_Entity_ID)::Bool
+"Removes the instance from the scene, the glTF asset is released together with its last instance."
+destroy(gltf_instance::glTF_Instance_ID)::Bool = @ccall libenv.destroy_gltf_instance(gltf_instance::glTF_Instance_ID)::Bool
     
 # 
 # Frame Handling
 #
-# The Frame is what the image gets rendered into. It is mainly a wrapper around Filaments SwapChain.
+# The Frame is what the image gets rendered into. It is mainly a wrapper around Filaments SwapChain or RenderTarget.
 #
 
 create_frame(env::Environment_ID, width, height)::Frame_ID = @ccall libenv.create_frame(env::Environment_ID, width::UInt32, height::UInt32)::Frame_ID
+"Offscreen frames render into textures, they need no window. The camera rendering into it takes on its size."
+create_offscreen_frame(env::Environment_ID, width, height)::Frame_ID = @ccall libenv.create_offscreen_frame(env::Environment_ID, width::UInt32, height::UInt32)::Frame_ID
+resize_offscreen_frame(frame::Frame_ID, width, height)::Bool = @ccall libenv.resize_offscreen_frame(frame::Frame_ID, width::UInt32, height::UInt32)::Bool
 exists(frame::Frame_ID)::Bool = @ccall libenv.frame_exists(frame::Frame_ID)::Bool
 destroy(frame::Frame_ID)::Bool = @ccall libenv.destroy_frame(frame::Frame_ID)::Bool
 
 get_pixel_data(frame::Frame_ID, pixel_data::Ptr{Ptr{Cvoid}}, width::Ptr{UInt32}, height::Ptr{UInt32})::Bool = @ccall libenv.get_pixel_data(frame::Frame_ID, pixel_data::Ptr{Ptr{Cvoid}}, width::Ptr{UInt32}, height::Ptr{UInt32})::Bool
+"Hands out the newest completed image with its frame index and render timestamp, it stays valid until it is released."
+acquire_latest_pixel_frame(frame::Frame_ID, pixel_data::Ptr{Ptr{Cvoid}}, width::Ptr{UInt32}, height::Ptr{UInt32}, frame_index::Ptr{UInt64}, render_time_ms::Ptr{Float64})::Bool = @ccall libenv.acquire_latest_pixel_frame(frame::Frame_ID, pixel_data::Ptr{Ptr{Cvoid}}, width::Ptr{UInt32}, height::Ptr{UInt32}, frame_index::Ptr{UInt64}, render_time_ms::Ptr{Float64})::Bool
+release_pixel_frame(frame::Frame_ID)::Bool = @ccall libenv.release_pixel_frame(frame::Frame_ID)::Bool
 disable_pixel_capture(frame::Frame_ID)::Bool = @ccall libenv.disable_pixel_capture(frame::Frame_ID)::Bool
 
+@enum Pixel_Conversion_Output::UInt32 begin
+    PIXEL_OUTPUT_RGBA8 = 1
+    PIXEL_OUTPUT_GRAY8 = 2
+    PIXEL_OUTPUT_CHW_FLOAT32 = 4
+end
+
+@kwdef struct Pixel_Conversion_Settings
+    outputs::UInt32 = UInt32(PIXEL_OUTPUT_CHW_FLOAT32)
+    downsample_factor::UInt32 = 1
+    flip_vertical::UInt8 = 1
+    mean::NTuple{3, Float32} = (0.0f0, 0.0f0, 0.0f0)
+    std::NTuple{3, Float32} = (1.0f0, 1.0f0, 1.0f0)
+end
+
+"Converts every acquired RGBA8 pixel frame into the requested outputs, CHW is normalized with (value / 255 - mean) / std."
+function enable_pixel_conversion(frame::Frame_ID, settings::Pixel_Conversion_Settings)::Bool
+    @ccall libenv.enable_pixel_conversion(frame::Frame_ID, Ref(settings)::Ptr{Pixel_Conversion_Settings})::Bool
+end
+get_converted_pixel_data(frame::Frame_ID, output::Pixel_Conversion_Output, data::Ptr{Ptr{Cvoid}}, width::Ptr{UInt32}, height::Ptr{UInt32})::Bool = @ccall libenv.get_converted_pixel_data(frame::Frame_ID, output::UInt32, data::Ptr{Ptr{Cvoid}}, width::Ptr{UInt32}, height::Ptr{UInt32})::Bool
+disable_pixel_conversion(frame::Frame_ID)::Bool = @ccall libenv.disable_pixel_conversion(frame::Frame_ID)::Bool
+
+"Publishes the captured pixels in the shared memory object '/dev/shm/<name>', see environments.hpp for the layout."
+function enable_shared_memory_export(frame::Frame_ID, name::CStaticString{N}, max_width, max_height)::Bool where N
+    @ccall libenv.enable_shared_memory_export(frame::Frame_ID, name::Cstring, max_width::UInt32, max_height::UInt32)::Bool
+end
+disable_shared_memory_export(frame::Frame_ID)::Bool = @ccall libenv.disable_shared_memory_export(frame::Frame_ID)::Bool
+
+@enum Depth_Format::UInt8 begin
+    DEPTH_FLOAT32_METERS = 1
+    DEPTH_UINT16_MILLIMETERS = 2
+end
+
+"Capture metric linear depth, only offscreen frames on desktop OpenGL support this."
+enable_depth_capture(frame::Frame_ID, depth_format::Depth_Format)::Bool = @ccall libenv.enable_depth_capture(frame::Frame_ID, depth_format::UInt8)::Bool
+acquire_latest_depth_frame(frame::Frame_ID, depth_data::Ptr{Ptr{Cvoid}}, width::Ptr{UInt32}, height::Ptr{UInt32}, frame_index::Ptr{UInt64}, render_time_ms::Ptr{Float64})::Bool = @ccall libenv.acquire_latest_depth_frame(frame::Frame_ID, depth_data::Ptr{Ptr{Cvoid}}, width::Ptr{UInt32}, height::Ptr{UInt32}, frame_index::Ptr{UInt64}, render_time_ms::Ptr{Float64})::Bool
+release_depth_frame(frame::Frame_ID)::Bool = @ccall libenv.release_depth_frame(frame::Frame_ID)::Bool
+disable_depth_capture(frame::Frame_ID)::Bool = @ccall libenv.disable_depth_capture(frame::Frame_ID)::Bool
+
+"Capture a mask with one UInt32 object id per pixel, only offscreen frames support this."
+enable_segmentation_capture(frame::Frame_ID)::Bool = @ccall libenv.enable_segmentation_capture(frame::Frame_ID)::Bool
+acquire_latest_segmentation_frame(frame::Frame_ID, mask_data::Ptr{Ptr{Cvoid}}, width::Ptr{UInt32}, height::Ptr{UInt32}, frame_index::Ptr{UInt64}, render_time_ms::Ptr{Float64})::Bool = @ccall libenv.acquire_latest_segmentation_frame(frame::Frame_ID, mask_data::Ptr{Ptr{Cvoid}}, width::Ptr{UInt32}, height::Ptr{UInt32}, frame_index::Ptr{UInt64}, render_time_ms::Ptr{Float64})::Bool
+release_segmentation_frame(frame::Frame_ID)::Bool = @ccall libenv.release_segmentation_frame(frame::Frame_ID)::Bool
+disable_segmentation_capture(frame::Frame_ID)::Bool = @ccall libenv.disable_segmentation_capture(frame::Frame_ID)::Bool
+
+"Map a mask id back to the object, returns (filament_entity, gltf_instance), one of them is invalid."
+function get_segmentation_object(env::Environment_ID, mask_id)::Tuple{Filament_Entity_ID, glTF_Instance_ID}
+    filament_entity = Ref(Filament_Entity_ID())
+    gltf_instance = Ref(glTF_Instance_ID())
+    @ccall libenv.get_segmentation_object(env::Environment_ID, mask_id::UInt32, filament_entity::Ptr{Filament_Entity_ID}, gltf_instance::Ptr{glTF_Instance_ID})::Bool
+    return (filament_entity[], gltf_instance[])
+end
+
 # 
 # Camera Handling
 #
@@ -145,8 +357,18 @@ get_camera_fov_vertical(camera::Camera_ID)::Float64 = @ccall libenv.get_camera_f
 get_camera_up_vector(camera::Camera_ID)::Float64_3 = @ccall libenv.get_camera_up_vector(camera::Camera_ID)::Float64_3
 get_camera_forward_vector(camera::Camera_ID)::Float64_3 = @ccall libenv.get_camera_forward_vector(camera::Camera_ID)::Float64_3
 render_frame(camera::Camera_ID, frame::Frame_ID)::Bool = @ccall libenv.render_frame(camera::Camera_ID, frame::Frame_ID)::Bool
+"Render cameras[i] into frames[i] for all i, sharing one renderer and frame submission per target frame."
+render_views(cameras::Vector{Camera_ID}, frames::Vector{Frame_ID})::Bool = @ccall libenv.render_views(cameras::Ptr{Camera_ID}, frames::Ptr{Frame_ID}, min(length(cameras), length(frames))::UInt32)::Bool
 get_filament_entity(camera_id::Camera_ID)::Filament_Entity_ID = @ccall libenv.get_camera_filament_entity(camera_id::Camera_ID)::Filament_Entity_ID
 
+"Returns (n_drawn, n_culled) renderables of the last render of the camera, or nothing for an invalid camera."
+function get_culling_stats(camera_id::Camera_ID)::Union{Tuple{UInt32, UInt32}, Nothing}
+    n_drawn = Ref{UInt32}(0)
+    n_culled = Ref{UInt32}(0)
+    ok = @ccall libenv.get_camera_culling_stats(camera_id::Camera_ID, n_drawn::Ref{UInt32}, n_culled::Ref{UInt32})::Bool
+    return ok ? (n_drawn[], n_culled[]) : nothing
+end
+
 #
 # Window Handling
 #
@@ -226,6 +448,13 @@ set_position(filament_entity::Filament_Entity_ID, pos)::Bool = @ccall libenv.set
 set_orientation(filament_entity::Filament_Entity_ID, orientation::Quaternion)::Bool = @ccall libenv.set_orientation(filament_entity::Filament_Entity_ID, orientation::Quaternion)::Bool
 set_position_and_orientation(filament_entity::Filament_Entity_ID, pos, orientation::Quaternion)::Bool = @ccall libenv.set_position_and_orientation(filament_entity::Filament_Entity_ID, pos::Float64_3, orientation::Quaternion)::Bool
 
+"Sets the position and orientation of many entities in one call, invalid entities are skipped."
+function set_transforms(filament_entities::Vector{Filament_Entity_ID}, positions::Vector{Float64_3}, orientations::Vector{Quaternion})::Bool
+    n = length(filament_entities)
+    @assert length(positions) == n && length(orientations) == n
+    @ccall libenv.set_transforms(filament_entities::Ptr{Filament_Entity_ID}, positions::Ptr{Float64_3}, orientations::Ptr{Quaternion}, n::UInt32)::Bool
+end
+
 #
 # User Controllable Camera
 #